@@ -0,0 +1,867 @@
+#include "Box.h"
+#include "DominoLayout.h"
+#include "SimdContactSolver.h"
+#include "World.h"
+
+#include <LinearMath/btQuaternion.h>
+#include <LinearMath/btQuickprof.h>
+#include <LinearMath/btTransform.h>
+#include <LinearMath/btVector3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Headless physics benchmark.
+// Builds a World made of parallel rows of dominoes standing on a static
+// ground box, tips the first domino of every row and measures the cost of
+// World::stepSimulation without any window, GL context or renderer.
+// The pair update time is the part of the step spent by the broadphase:
+// updating the AABBs, where the sweep and prune variants find their pairs,
+// and computing the overlapping pairs. "-b all" runs every broadphase in turn,
+// the simple one is quadratic in the number of dominoes.
+// "-r file" records the run, "-p file" plays a recording of the same number
+// of dominoes back instead of simulating it, which measures the decoding of
+// the log and the sync of the objects alone.
+//
+// "-i min,max,budget" adapts the solver iterations between min and max, with
+// an optional step budget in milliseconds.
+// "-e on" streams the contact events, drained after every step.
+// "-g columns,rows,overlap" splits the ground into regions stepped in
+// parallel by the threads, with an optional overlap.
+// "-o file" profiles the stages of every step into a CSV file and prints
+// their average, counting the active bodies and islands costs a little.
+// "-c dominoes" despawns that many dominoes and spawns them again standing,
+// in rows behind the others, once every second of simulation. The swaps are
+// timed apart from the steps.
+// "-k on" benchmarks the contact solver kernels instead: the dominoes are
+// stepped by Bullet alone, then the contacts of the last step are solved
+// again and again from the same state, with the most iterations of "-i", by
+// btSequentialImpulseConstraintSolver and by SimdContactSolver with each of
+// its kernels. The iterations are timed apart from the setup, in contact and
+// friction rows per second, and the velocities are compared to the ones of
+// btSequentialImpulseConstraintSolver.
+// "-v on" checks the world instead of benchmarking it, and fails when a check
+// does: dominoes frozen on the ground have to fall once thawed after the
+// ground is taken away, whatever rebuilt the world in between, and the
+// dominoes stepped by each broadphase of "-b" have to end where they do on a
+// single thread on the "-t" threads, two at least. 1000 dominoes unless some
+// are given.
+//
+// Usage: domino_bench [-t threads]
+//                     [-s sequential|islands|batches|dantzig|pgs|simd]
+//                     [-i min,max[,budget]] [-b dbvt|sap|sap32|simple|all]
+//                     [-g columns,rows[,overlap]] [-f settleTime]
+//                     [-e on|off] [-o profileFile] [-c dominoes]
+//                     [-r recordFile | -p playFile] [-k on|off]
+//                     [-v on|off] [steps] [dominoes...]
+
+struct SolverIterations {
+  int min = Engine::DEFAULT_SOLVER_ITERATIONS;
+  int max = Engine::DEFAULT_SOLVER_ITERATIONS;
+  double budget = 0.0;
+};
+
+struct Regions {
+  int columns = 1;
+  int rows = 1;
+  btScalar overlap = RegionGrid::DEFAULT_OVERLAP;
+};
+
+struct BenchmarkResult {
+  BroadphaseType broadphase = BroadphaseType::bpDbvt;
+  int threads = 1;
+  int dominoes = 0;
+  int steps = 0;
+  double setupTime = 0.0;
+  double totalTime = 0.0;
+  double maxStepTime = 0.0;
+  double pairsTime = 0.0;
+  double averageActive = 0.0;
+  double averageIterations = 0.0;
+  int finalActive = 0;
+  int finalFrozen = 0;
+  unsigned int recordedFrames = 0;
+  std::size_t recordingSize = 0;
+  int regions = 1;
+  int ghosts = 0;
+  unsigned int handOffs = 0;
+  bool contactEvents = false;
+  long long contactsBegun = 0;
+  long long contactsEnded = 0;
+  unsigned int droppedEvents = 0;
+  StepProfile profile;
+  bool profiled = false;
+  int churnDominoes = 0;
+  int churnSwaps = 0;
+  double churnTime = 0.0;
+};
+
+// A way to rebuild the world, applied once the dominoes froze.
+struct Rebuild {
+  const char *name;
+  Regions regions;
+  std::function<void(World &)> apply;
+};
+
+struct KernelResult {
+  std::string kernel;
+  int dominoes = 0;
+  int solves = 0;
+  int iterations = 0;
+  long long rows = 0;
+  double iterationsTime = 0.0;
+  double solveTime = 0.0;
+  // Largest difference from the velocities of the reference solver.
+  btScalar linearError = 0;
+  btScalar angularError = 0;
+};
+
+// Times the iterations of Solver apart from its setup, and counts the contact
+// and friction rows they solve.
+template <typename Solver> class TimedSolver : public Solver {
+public:
+  template <typename... Arguments>
+  explicit TimedSolver(Arguments... arguments) : Solver(arguments...) {}
+
+private:
+  double m_iterationsTime = 0.0;
+  long long m_rows = 0;
+
+public:
+  inline double getIterationsTime() const { return m_iterationsTime; }
+  inline long long getRows() const { return m_rows; }
+
+protected:
+  virtual btScalar solveGroupCacheFriendlyIterations(
+      btCollisionObject **bodies, int bodiesNumber,
+      btPersistentManifold **manifolds, int manifoldsNumber,
+      btTypedConstraint **constraints, int constraintsNumber,
+      const btContactSolverInfo &solverInfo,
+      btIDebugDraw *debugDrawer) override {
+    m_rows += static_cast<long long>(
+                  this->m_tmpSolverContactConstraintPool.size() +
+                  this->m_tmpSolverContactFrictionConstraintPool.size()) *
+              solverInfo.m_numIterations;
+    auto begin = std::chrono::steady_clock::now();
+    btScalar result = Solver::solveGroupCacheFriendlyIterations(
+        bodies, bodiesNumber, manifolds, manifoldsNumber, constraints,
+        constraintsNumber, solverInfo, debugDrawer);
+    m_iterationsTime += std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - begin)
+                            .count();
+    return result;
+  }
+};
+
+// Support functions.
+// -----------------------------------------------------------------------------
+void addDominoRows(World &world, int dominoes, int churnDominoes);
+void getGroundSides(int dominoes, int churnDominoes, btScalar &length,
+                    btScalar &width);
+Object *createGround(btScalar length, btScalar width);
+void createDominoRows(int dominoes, btScalar z, std::vector<Object *> &objects);
+int getRowsNumber(int dominoes);
+bool parseSolver(const std::string &name, SolverType &solver);
+bool parseIterations(const std::string &value, SolverIterations &iterations);
+bool parseRegions(const std::string &value, Regions &regions);
+bool parseBroadphases(const std::string &name,
+                      std::vector<BroadphaseType> &broadphases);
+const char *getBroadphaseName(BroadphaseType broadphase);
+BenchmarkResult runBenchmark(int dominoes, int steps, int threads,
+                             SolverType solver, SolverIterations iterations,
+                             BroadphaseType broadphase, Regions regions,
+                             float settleTime, bool contactEvents,
+                             const std::string &profileFile,
+                             int churnDominoes, const std::string &recordFile,
+                             const std::string &playFile);
+std::vector<KernelResult> runKernelBenchmark(int dominoes, int steps,
+                                             int solverIterations);
+bool checkFrozenRebuild(const Rebuild &rebuild);
+std::vector<btTransform> getFinalTransforms(int dominoes, int steps,
+                                            int threads, SolverType solver,
+                                            BroadphaseType broadphase,
+                                            float settleTime);
+bool checkThreads(int dominoes, int steps, int threads, SolverType solver,
+                  BroadphaseType broadphase, float settleTime);
+void printHeader();
+void printResult(const BenchmarkResult &result);
+void printKernelHeader();
+void printKernelResult(const KernelResult &result);
+
+const int DEFAULT_STEPS = 500;
+const std::vector<int> DEFAULT_DOMINOES = {1000, 10000, 100000};
+const int DOMINOES_PER_ROW = 500;
+const btScalar DOMINO_DISTANCE = 1.0;
+const btScalar ROW_DISTANCE = 2.0;
+const btScalar DOMINO_MASS = 20.0;
+const btVector3 DOMINO_SIDES(0.25, 2.0, 0.5);
+const btScalar KERNEL_TIME_STEP = 1.0 / 70;
+const int KERNEL_SOLVES = 20;
+const int CHECK_DOMINOES = 20;
+const float CHECK_SETTLE_TIME = 0.1f;
+const int CHECK_MAX_SETTLE_STEPS = 3000;
+const int CHECK_THREADS_DOMINOES = 1000;
+
+// -----------------------------------------------------------------------------
+int main(int argc, char **argv) {
+  int threads = 1;
+  SolverType solver = SolverType::stSequential;
+  SolverIterations iterations;
+  std::vector<BroadphaseType> broadphases = {BroadphaseType::bpDbvt};
+  Regions regions;
+  float settleTime = World::DEFAULT_SETTLE_TIME;
+  bool contactEvents = false;
+  std::string profileFile;
+  int churnDominoes = 0;
+  std::string recordFile;
+  std::string playFile;
+  bool kernels = false;
+  bool checks = false;
+  int steps = DEFAULT_STEPS;
+  std::vector<int> dominoes;
+  bool validArguments = true;
+
+  int argument = 1;
+  for (; argument + 1 < argc && argv[argument][0] == '-'; argument += 2) {
+    const std::string option = argv[argument];
+    const std::string value = argv[argument + 1];
+    if (option == "-t")
+      threads = std::atoi(value.c_str());
+    else if (option == "-s")
+      validArguments &= parseSolver(value, solver);
+    else if (option == "-i")
+      validArguments &= parseIterations(value, iterations);
+    else if (option == "-b")
+      validArguments &= parseBroadphases(value, broadphases);
+    else if (option == "-g")
+      validArguments &= parseRegions(value, regions);
+    else if (option == "-f")
+      settleTime = static_cast<float>(std::atof(value.c_str()));
+    else if (option == "-e" && (value == "on" || value == "off"))
+      contactEvents = value == "on";
+    else if (option == "-o")
+      profileFile = value;
+    else if (option == "-c")
+      churnDominoes = std::atoi(value.c_str());
+    else if (option == "-r")
+      recordFile = value;
+    else if (option == "-p")
+      playFile = value;
+    else if (option == "-k" && (value == "on" || value == "off"))
+      kernels = value == "on";
+    else if (option == "-v" && (value == "on" || value == "off"))
+      checks = value == "on";
+    else
+      validArguments = false;
+  }
+  if (argc > argument)
+    steps = std::atoi(argv[argument++]);
+  for (; argument < argc; ++argument)
+    dominoes.push_back(std::atoi(argv[argument]));
+  if (dominoes.empty())
+    dominoes = checks ? std::vector<int>{CHECK_THREADS_DOMINOES}
+                      : DEFAULT_DOMINOES;
+
+  // A recording keeps the same dominoes throughout.
+  if (!validArguments || (!recordFile.empty() && !playFile.empty()) ||
+      (churnDominoes != 0 && (!recordFile.empty() || !playFile.empty())) ||
+      threads <= 0 || steps <= 0 || settleTime < 0 || churnDominoes < 0 ||
+      std::any_of(dominoes.begin(), dominoes.end(),
+                  [](int number) { return number <= 0; })) {
+    std::cerr << "Usage: " << argv[0]
+              << " [-t threads] "
+                 "[-s sequential|islands|batches|dantzig|pgs|simd] "
+                 "[-i min,max[,budget]] [-b dbvt|sap|sap32|simple|all] "
+                 "[-g columns,rows[,overlap]] [-f settleTime] [-e on|off] "
+                 "[-o profileFile] [-c dominoes] "
+                 "[-r recordFile | -p playFile] [-k on|off] [-v on|off] "
+                 "[steps] [dominoes...]\n";
+    return 1;
+  }
+
+  if (checks) {
+    Regions grid;
+    grid.columns = 2;
+    const std::vector<Rebuild> rebuilds = {
+        {"solver", Regions(),
+         [](World &world) { world.setPhysicsSolver(SolverType::stIslands); }},
+        {"broadphase", Regions(),
+         [](World &world) {
+           world.setPhysicsBroadphase(BroadphaseType::bpAxisSweep);
+         }},
+        {"threads", Regions(),
+         [](World &world) { world.setPhysicsThreadsNumber(2); }},
+        {"regions", Regions(),
+         [grid](World &world) {
+           world.setRegions(grid.columns, grid.rows, grid.overlap);
+         }},
+        {"region solver", grid,
+         [](World &world) { world.setPhysicsSolver(SolverType::stIslands); }},
+        {"single region", grid,
+         [](World &world) { world.setRegions(1, 1, 0); }}};
+    bool passed = true;
+    for (const auto &rebuild : rebuilds)
+      passed &= checkFrozenRebuild(rebuild);
+    for (auto number : dominoes) {
+      for (auto broadphase : broadphases)
+        passed &= checkThreads(number, steps, std::max(threads, 2), solver,
+                               broadphase, settleTime);
+    }
+    return passed ? 0 : 1;
+  }
+
+  if (kernels) {
+    printKernelHeader();
+    for (auto number : dominoes) {
+      for (const auto &result :
+           runKernelBenchmark(number, steps, iterations.max))
+        printKernelResult(result);
+    }
+    return 0;
+  }
+
+  printHeader();
+  for (auto number : dominoes) {
+    for (auto broadphase : broadphases)
+      printResult(runBenchmark(number, steps, threads, solver, iterations,
+                               broadphase, regions, settleTime,
+                               contactEvents, profileFile, churnDominoes,
+                               recordFile, playFile));
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// The churning dominoes stand in rows of their own behind the others.
+void addDominoRows(World &world, int dominoes, int churnDominoes) {
+  btScalar length;
+  btScalar width;
+  getGroundSides(dominoes, churnDominoes, length, width);
+  world.setWorldBounds(btVector3(-20, -10, -20),
+                       btVector3(length + 20, 10, width + 20));
+  world.addObject(createGround(length, width));
+
+  std::vector<Object *> objects;
+  createDominoRows(dominoes, 0, objects);
+  world.addObjects(objects);
+}
+
+// -----------------------------------------------------------------------------
+// Extent of the rows of dominoes.
+void getGroundSides(int dominoes, int churnDominoes, btScalar &length,
+                    btScalar &width) {
+  const int rows = getRowsNumber(dominoes) + getRowsNumber(churnDominoes);
+  const int rowLength =
+      std::min(std::max(dominoes, churnDominoes), DOMINOES_PER_ROW);
+  length = rowLength * DOMINO_DISTANCE;
+  width = rows * ROW_DISTANCE;
+}
+
+// -----------------------------------------------------------------------------
+// The ground, with some room for the dominoes falling off its border.
+Object *createGround(btScalar length, btScalar width) {
+  BoxBuilder boxBuilder;
+  return boxBuilder
+      .setTransform(btTransform(btQuaternion::getIdentity(),
+                                btVector3(length / 2, -1.0, width / 2)))
+      .setMass(0)
+      .setSides(btVector3(length + 20, 2.0, width + 20))
+      .create();
+}
+
+// -----------------------------------------------------------------------------
+// Rows along x from z on, the first domino of every row leaning so that the
+// whole row falls, the last row holding what is left.
+void createDominoRows(int dominoes, btScalar z,
+                      std::vector<Object *> &objects) {
+  DominoLayout layout(DOMINO_SIDES, DOMINO_DISTANCE);
+  layout.reserve(dominoes);
+  const int fullRows = dominoes / DOMINOES_PER_ROW;
+  if (fullRows > 0)
+    layout.traceGrid(btVector3(0, 0, z), DOMINOES_PER_ROW, fullRows,
+                     ROW_DISTANCE);
+  const int remainder = dominoes % DOMINOES_PER_ROW;
+  if (remainder > 0)
+    layout.traceLine(
+        btVector3(0, 0, z + fullRows * ROW_DISTANCE),
+        btVector3((remainder - 1) * DOMINO_DISTANCE, 0,
+                  z + fullRows * ROW_DISTANCE));
+
+  BoxBuilder boxBuilder;
+  layout.createDominoes(boxBuilder.setMass(DOMINO_MASS), objects);
+}
+
+// -----------------------------------------------------------------------------
+int getRowsNumber(int dominoes) {
+  return (dominoes + DOMINOES_PER_ROW - 1) / DOMINOES_PER_ROW;
+}
+
+// -----------------------------------------------------------------------------
+bool parseSolver(const std::string &name, SolverType &solver) {
+  if (name == "sequential")
+    solver = SolverType::stSequential;
+  else if (name == "islands")
+    solver = SolverType::stIslands;
+  else if (name == "batches")
+    solver = SolverType::stBatches;
+  else if (name == "dantzig")
+    solver = SolverType::stDantzig;
+  else if (name == "pgs")
+    solver = SolverType::stProjectedGaussSeidel;
+  else if (name == "simd")
+    solver = SolverType::stSimd;
+  else
+    return false;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+bool parseIterations(const std::string &value, SolverIterations &iterations) {
+  char separator = 0;
+  std::istringstream stream(value);
+  if (!(stream >> iterations.min >> separator >> iterations.max) ||
+      separator != ',')
+    return false;
+  if (stream >> separator >> iterations.budget && separator == ',')
+    iterations.budget /= 1000;
+  return iterations.min > 0 && iterations.max >= iterations.min &&
+         iterations.budget >= 0;
+}
+
+// -----------------------------------------------------------------------------
+bool parseRegions(const std::string &value, Regions &regions) {
+  char separator = 0;
+  std::istringstream stream(value);
+  if (!(stream >> regions.columns >> separator >> regions.rows) ||
+      separator != ',')
+    return false;
+  if (stream >> separator && separator == ',')
+    stream >> regions.overlap;
+  return regions.columns > 0 && regions.rows > 0 && regions.overlap >= 0;
+}
+
+// -----------------------------------------------------------------------------
+bool parseBroadphases(const std::string &name,
+                      std::vector<BroadphaseType> &broadphases) {
+  const std::vector<BroadphaseType> allBroadphases = {
+      BroadphaseType::bpDbvt, BroadphaseType::bpAxisSweep,
+      BroadphaseType::bpAxisSweep32, BroadphaseType::bpSimple};
+
+  if (name == "all") {
+    broadphases = allBroadphases;
+    return true;
+  }
+  for (auto broadphase : allBroadphases) {
+    if (name == getBroadphaseName(broadphase)) {
+      broadphases = {broadphase};
+      return true;
+    }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+const char *getBroadphaseName(BroadphaseType broadphase) {
+  switch (broadphase) {
+  case BroadphaseType::bpDbvt:
+    break;
+  case BroadphaseType::bpAxisSweep:
+    return "sap";
+  case BroadphaseType::bpAxisSweep32:
+    return "sap32";
+  case BroadphaseType::bpSimple:
+    return "simple";
+  }
+  return "dbvt";
+}
+
+// -----------------------------------------------------------------------------
+BenchmarkResult runBenchmark(int dominoes, int steps, int threads,
+                             SolverType solver, SolverIterations iterations,
+                             BroadphaseType broadphase, Regions regions,
+                             float settleTime, bool contactEvents,
+                             const std::string &profileFile,
+                             int churnDominoes, const std::string &recordFile,
+                             const std::string &playFile) {
+  using Clock = std::chrono::steady_clock;
+  using Seconds = std::chrono::duration<double>;
+
+  BenchmarkResult result;
+  result.dominoes = dominoes;
+  result.steps = steps;
+
+  World world;
+  world.setGravity(btVector3(0.0, -9.81, 0.0));
+  world.setPhysicsSolver(solver);
+  world.setSolverIterations(iterations.min, iterations.max, iterations.budget);
+  world.setPhysicsBroadphase(broadphase);
+  world.setPhysicsThreadsNumber(threads);
+  result.threads = world.getPhysicsThreadsNumber();
+  world.setRegions(regions.columns, regions.rows, regions.overlap);
+  result.regions = regions.columns * regions.rows;
+  world.setSettleTime(settleTime);
+  world.setContactEvents(contactEvents);
+  result.contactEvents = contactEvents;
+  // Several runs go to the same file, the last one stays.
+  if (!profileFile.empty())
+    world.setProfiling(true, profileFile);
+  result.churnDominoes = churnDominoes;
+
+  auto setupBegin = Clock::now();
+  addDominoRows(world, dominoes, churnDominoes);
+  result.setupTime = Seconds(Clock::now() - setupBegin).count();
+  // The 16 bit sweep and prune gives way to the 32 bit one on large scenes.
+  result.broadphase = world.getPhysicsBroadphase();
+  if (!recordFile.empty())
+    world.startRecording(recordFile);
+  if (!playFile.empty())
+    world.startPlayback(playFile);
+
+  const btScalar churnZ = getRowsNumber(dominoes) * ROW_DISTANCE;
+  const int churnSteps = static_cast<int>(world.getStepsPerSecond());
+  std::vector<Object *> churnObjects;
+  long long activeSum = 0;
+  long long iterationsSum = 0;
+  for (int step = 0; step < steps; ++step) {
+    if (churnDominoes > 0 && step % churnSteps == 0) {
+      auto churnBegin = Clock::now();
+      world.removeObjects(churnObjects);
+      churnObjects.clear();
+      createDominoRows(churnDominoes, churnZ, churnObjects);
+      world.addObjects(churnObjects);
+      result.churnTime += Seconds(Clock::now() - churnBegin).count();
+      ++result.churnSwaps;
+    }
+
+    auto stepBegin = Clock::now();
+    world.stepSimulation();
+    double stepTime = Seconds(Clock::now() - stepBegin).count();
+
+    result.totalTime += stepTime;
+    result.maxStepTime = std::max(result.maxStepTime, stepTime);
+
+    CProfileIterator *iterator = CProfileManager::Get_Iterator();
+    result.pairsTime +=
+        PhysicsProfiler::getSampleTime(iterator, "updateAabbs") +
+        PhysicsProfiler::getSampleTime(iterator, "calculateOverlappingPairs");
+    CProfileManager::Release_Iterator(iterator);
+    activeSum += world.getActiveObjectsNumber();
+    iterationsSum += world.getSolverIterations();
+
+    ContactEvent event;
+    while (world.popContactEvent(event)) {
+      if (event.type == ContactEvent::Type::ceBegin)
+        ++result.contactsBegun;
+      else
+        ++result.contactsEnded;
+    }
+  }
+
+  result.averageActive = static_cast<double>(activeSum) / steps;
+  result.averageIterations = static_cast<double>(iterationsSum) / steps;
+  result.finalActive = world.getActiveObjectsNumber();
+  result.finalFrozen = world.getFrozenObjectsNumber();
+  if (world.getRecorder() != nullptr) {
+    result.recordedFrames = world.getRecorder()->getFramesNumber();
+    result.recordingSize = world.getRecorder()->getSize();
+  }
+  if (world.getRegions() != nullptr) {
+    result.ghosts = world.getRegions()->getGhostsNumber();
+    result.handOffs = world.getRegions()->getHandOffsNumber();
+  }
+  if (world.getContactEvents() != nullptr)
+    result.droppedEvents = world.getContactEvents()->getDroppedEventsNumber();
+  result.profiled = world.takeStepProfile(result.profile);
+  return result;
+}
+
+// -----------------------------------------------------------------------------
+// Every solve starts from the velocities and the warm starting impulses the
+// steps left, the reference solver goes first.
+std::vector<KernelResult> runKernelBenchmark(int dominoes, int steps,
+                                             int solverIterations) {
+  using Clock = std::chrono::steady_clock;
+  using Seconds = std::chrono::duration<double>;
+
+  btDefaultCollisionConfiguration configuration;
+  btCollisionDispatcher dispatcher(&configuration);
+  btDbvtBroadphase broadphase;
+  btSequentialImpulseConstraintSolver stepSolver;
+  btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &stepSolver,
+                                &configuration);
+  world.setGravity(btVector3(0.0, -9.81, 0.0));
+
+  btScalar length;
+  btScalar width;
+  getGroundSides(dominoes, 0, length, width);
+  std::vector<Object *> objects = {createGround(length, width)};
+  createDominoRows(dominoes, 0, objects);
+  for (auto object : objects)
+    world.addRigidBody(object->getRigidBody());
+  for (int step = 0; step < steps; ++step)
+    world.stepSimulation(KERNEL_TIME_STEP, 0);
+
+  std::vector<btCollisionObject *> bodies;
+  std::vector<btVector3> velocities;
+  for (auto object : objects) {
+    btRigidBody *body = object->getRigidBody();
+    if (body->isStaticObject())
+      continue;
+    bodies.push_back(body);
+    velocities.push_back(body->getLinearVelocity());
+    velocities.push_back(body->getAngularVelocity());
+  }
+  std::vector<btPersistentManifold *> manifolds;
+  std::vector<btScalar> impulses;
+  for (int index = 0; index < dispatcher.getNumManifolds(); ++index) {
+    btPersistentManifold *manifold =
+        dispatcher.getManifoldByIndexInternal(index);
+    manifolds.push_back(manifold);
+    for (int point = 0; point < manifold->getNumContacts(); ++point) {
+      const btManifoldPoint &contact = manifold->getContactPoint(point);
+      impulses.push_back(contact.m_appliedImpulse);
+      impulses.push_back(contact.m_appliedImpulseLateral1);
+      impulses.push_back(contact.m_appliedImpulseLateral2);
+    }
+  }
+  auto restore = [&]() {
+    for (std::size_t index = 0; index < bodies.size(); ++index) {
+      btRigidBody *body = btRigidBody::upcast(bodies[index]);
+      body->setLinearVelocity(velocities[2 * index]);
+      body->setAngularVelocity(velocities[2 * index + 1]);
+    }
+    std::size_t impulse = 0;
+    for (auto manifold : manifolds) {
+      for (int point = 0; point < manifold->getNumContacts(); ++point) {
+        btManifoldPoint &contact = manifold->getContactPoint(point);
+        contact.m_appliedImpulse = impulses[impulse++];
+        contact.m_appliedImpulseLateral1 = impulses[impulse++];
+        contact.m_appliedImpulseLateral2 = impulses[impulse++];
+      }
+    }
+  };
+
+  btContactSolverInfo solverInfo = world.getSolverInfo();
+  solverInfo.m_numIterations = solverIterations;
+  std::vector<btVector3> referenceVelocities;
+  std::vector<KernelResult> results;
+  auto runKernel = [&](const std::string &kernel, auto &solver) {
+    KernelResult result;
+    result.kernel = kernel;
+    result.dominoes = dominoes;
+    result.solves = KERNEL_SOLVES;
+    result.iterations = solverIterations;
+    for (int solve = 0; solve < KERNEL_SOLVES; ++solve) {
+      restore();
+      auto solveBegin = Clock::now();
+      solver.solveGroup(bodies.data(), bodies.size(), manifolds.data(),
+                        manifolds.size(), nullptr, 0, solverInfo, nullptr,
+                        &dispatcher);
+      result.solveTime += Seconds(Clock::now() - solveBegin).count();
+    }
+    result.rows = solver.getRows();
+    result.iterationsTime = solver.getIterationsTime();
+
+    for (std::size_t index = 0; index < bodies.size(); ++index) {
+      btRigidBody *body = btRigidBody::upcast(bodies[index]);
+      if (referenceVelocities.size() < velocities.size()) {
+        referenceVelocities.push_back(body->getLinearVelocity());
+        referenceVelocities.push_back(body->getAngularVelocity());
+        continue;
+      }
+      result.linearError = std::max(
+          result.linearError,
+          (body->getLinearVelocity() - referenceVelocities[2 * index])
+              .length());
+      result.angularError = std::max(
+          result.angularError,
+          (body->getAngularVelocity() - referenceVelocities[2 * index + 1])
+              .length());
+    }
+    results.push_back(result);
+  };
+
+  TimedSolver<btSequentialImpulseConstraintSolver> referenceSolver;
+  runKernel("bullet", referenceSolver);
+  TimedSolver<SimdContactSolver> scalarSolver(
+      SimdContactSolver::Kernel::kScalar);
+  runKernel("scalar", scalarSolver);
+  if (SimdContactSolver::hasSimdKernel()) {
+    TimedSolver<SimdContactSolver> simdSolver(
+        SimdContactSolver::Kernel::kSimd);
+    runKernel(SimdContactSolver::getSimdName(), simdSolver);
+  }
+
+  for (auto object : objects) {
+    world.removeRigidBody(object->getRigidBody());
+    delete object;
+  }
+  return results;
+}
+
+// -----------------------------------------------------------------------------
+// The snapshot taken before the dominoes froze thaws them, standing where
+// they started.
+bool checkFrozenRebuild(const Rebuild &rebuild) {
+  World world;
+  world.setGravity(btVector3(0.0, -9.81, 0.0));
+  world.setRegions(rebuild.regions.columns, rebuild.regions.rows,
+                   rebuild.regions.overlap);
+  world.setSettleTime(CHECK_SETTLE_TIME);
+  addDominoRows(world, CHECK_DOMINOES, 0);
+  Object *ground = world.getObjects().front();
+  world.snapshot();
+
+  for (int step = 0; step < CHECK_MAX_SETTLE_STEPS &&
+                     world.getFrozenObjectsNumber() < CHECK_DOMINOES;
+       ++step)
+    world.stepSimulation();
+  const bool frozen = world.getFrozenObjectsNumber() == CHECK_DOMINOES;
+
+  rebuild.apply(world);
+  world.removeObjects({ground});
+  world.restore();
+  for (int step = 0; step < world.getStepsPerSecond(); ++step)
+    world.stepSimulation();
+
+  // A second of free fall is almost 5 m.
+  int fallen = 0;
+  for (auto object : world.getObjects()) {
+    if (object->getRigidBody()->getWorldTransform().getOrigin().y() < -2)
+      ++fallen;
+  }
+  const bool passed = frozen && fallen == CHECK_DOMINOES;
+  std::cout << "frozen dominoes after a " << rebuild.name << " rebuild: "
+            << (frozen ? "" : "not all frozen, ") << fallen << " of "
+            << CHECK_DOMINOES << " fell, " << (passed ? "ok" : "FAILED")
+            << std::endl;
+  return passed;
+}
+
+// -----------------------------------------------------------------------------
+std::vector<btTransform> getFinalTransforms(int dominoes, int steps,
+                                            int threads, SolverType solver,
+                                            BroadphaseType broadphase,
+                                            float settleTime) {
+  World world;
+  world.setGravity(btVector3(0.0, -9.81, 0.0));
+  world.setPhysicsSolver(solver);
+  world.setPhysicsBroadphase(broadphase);
+  world.setPhysicsThreadsNumber(threads);
+  world.setSettleTime(settleTime);
+  addDominoRows(world, dominoes, 0);
+  for (int step = 0; step < steps; ++step)
+    world.stepSimulation();
+
+  std::vector<btTransform> transforms;
+  for (auto object : world.getObjects())
+    transforms.push_back(object->getRigidBody()->getWorldTransform());
+  return transforms;
+}
+
+// -----------------------------------------------------------------------------
+// The transforms have to be the same to the bit.
+bool checkThreads(int dominoes, int steps, int threads, SolverType solver,
+                  BroadphaseType broadphase, float settleTime) {
+  const auto single =
+      getFinalTransforms(dominoes, steps, 1, solver, broadphase, settleTime);
+  const auto several = getFinalTransforms(dominoes, steps, threads, solver,
+                                          broadphase, settleTime);
+  int different = 0;
+  for (std::size_t i = 0; i < single.size(); ++i) {
+    if (!(single[i] == several[i]))
+      ++different;
+  }
+  const bool passed = different == 0;
+  std::cout << getBroadphaseName(broadphase) << " with " << dominoes
+            << " dominoes on 1 and " << threads << " threads: " << different
+            << " transforms differ, " << (passed ? "ok" : "FAILED")
+            << std::endl;
+  return passed;
+}
+
+// -----------------------------------------------------------------------------
+void printHeader() {
+  std::cout << std::setw(11) << "broadphase" << std::setw(8) << "threads"
+            << std::setw(10) << "dominoes"
+            << std::setw(8) << "steps" << std::setw(12) << "setup(ms)"
+            << std::setw(12) << "steps/s" << std::setw(12) << "avg(ms)"
+            << std::setw(12) << "max(ms)" << std::setw(12) << "pairs(ms)"
+            << std::setw(12) << "iters(avg)"
+            << std::setw(14) << "active(avg)"
+            << std::setw(14) << "active(end)" << std::setw(14)
+            << "frozen(end)" << "\n";
+}
+
+// -----------------------------------------------------------------------------
+void printResult(const BenchmarkResult &result) {
+  std::cout << std::fixed << std::setprecision(3) << std::setw(11)
+            << getBroadphaseName(result.broadphase) << std::setw(8)
+            << result.threads << std::setw(10) << result.dominoes
+            << std::setw(8) << result.steps << std::setw(12)
+            << result.setupTime * 1000 << std::setw(12)
+            << result.steps / result.totalTime << std::setw(12)
+            << result.totalTime * 1000 / result.steps << std::setw(12)
+            << result.maxStepTime * 1000 << std::setw(12)
+            << result.pairsTime / result.steps << std::setw(12)
+            << result.averageIterations << std::setw(14)
+            << result.averageActive << std::setw(14) << result.finalActive
+            << std::setw(14) << result.finalFrozen << std::endl;
+  if (result.recordedFrames > 0)
+    std::cout << "  recorded " << result.recordedFrames << " frames, "
+              << result.recordingSize / 1024.0 << " KB, "
+              << result.recordingSize / result.recordedFrames
+              << " bytes/frame" << std::endl;
+  if (result.regions > 1)
+    std::cout << "  " << result.regions << " regions, " << result.ghosts
+              << " ghosts at the end, " << result.handOffs << " hand offs"
+              << std::endl;
+  if (result.contactEvents)
+    std::cout << "  contacts " << result.contactsBegun << " begun, "
+              << result.contactsEnded << " ended, " << result.droppedEvents
+              << " events dropped" << std::endl;
+  if (result.profiled)
+    std::cout << "  stages(ms) broadphase " << result.profile.broadphase
+              << ", narrowphase " << result.profile.narrowphase << ", solver "
+              << result.profile.solver << ", integration "
+              << result.profile.integration << ", step "
+              << result.profile.total << "; manifolds(avg) "
+              << result.profile.manifolds << ", islands(avg) "
+              << result.profile.awakeIslands << std::endl;
+  if (result.churnSwaps > 0)
+    std::cout << "  churned " << result.churnDominoes << " dominoes "
+              << result.churnSwaps << " times, "
+              << result.churnTime * 1000 / result.churnSwaps << " ms per swap"
+              << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+void printKernelHeader() {
+  std::cout << std::setw(8) << "kernel" << std::setw(10) << "dominoes"
+            << std::setw(12) << "rows/iter" << std::setw(12) << "iters(ms)"
+            << std::setw(12) << "Mrows/s" << std::setw(12) << "solve(ms)"
+            << std::setw(14) << "max dv(m/s)" << std::setw(16)
+            << "max dw(rad/s)" << "\n";
+}
+
+// -----------------------------------------------------------------------------
+// Times are per solve.
+void printKernelResult(const KernelResult &result) {
+  std::cout << std::fixed << std::setprecision(3) << std::setw(8)
+            << result.kernel << std::setw(10) << result.dominoes
+            << std::setw(12)
+            << result.rows / (result.solves * result.iterations)
+            << std::setw(12) << result.iterationsTime * 1000 / result.solves
+            << std::setw(12) << result.rows / result.iterationsTime / 1e6
+            << std::setw(12) << result.solveTime * 1000 / result.solves
+            << std::setprecision(6) << std::setw(14) << result.linearError
+            << std::setw(16) << result.angularError << std::endl;
+}
@@ -17,9 +17,16 @@
 
 #ifndef BT_NO_PROFILE
 
+#include <thread>
+
 
 static btClock gProfileClock;
 
+// The profile tree is not thread safe: only the thread which last reset the
+// profiler, i.e. the one stepping the world, records samples.
+static std::thread::id gProfileThread;
+static bool gResetHeld = false;
+
 
 #ifdef __CELLOS_LV2__
 #include <sys/sys_time.h>
@@ -443,6 +450,9 @@ unsigned long int			CProfileManager::ResetTime = 0;
  *=============================================================================================*/
 void	CProfileManager::Start_Profile( const char * name )
 {
+	if (std::this_thread::get_id() != gProfileThread)
+		return;
+
 	if (name != CurrentNode->Get_Name()) {
 		CurrentNode = CurrentNode->Get_Sub_Node( name );
 	} 
@@ -456,6 +466,9 @@ void	CProfileManager::Start_Profile( const char * name )
  *=============================================================================================*/
 void	CProfileManager::Stop_Profile( void )
 {
+	if (std::this_thread::get_id() != gProfileThread)
+		return;
+
 	// Return will indicate whether we should back up to our parent (we may
 	// be profiling a recursive function)
 	if (CurrentNode->Return()) {
@@ -471,6 +484,10 @@ void	CProfileManager::Stop_Profile( void )
  *=============================================================================================*/
 void	CProfileManager::Reset( void )
 { 
+	if (gResetHeld)
+		return;
+
+	gProfileThread = std::this_thread::get_id();
 	gProfileClock.reset();
 	Root.Reset();
     Root.Call();
@@ -484,10 +501,19 @@ void	CProfileManager::Reset( void )
  *=============================================================================================*/
 void CProfileManager::Increment_Frame_Counter( void )
 {
+	if (std::this_thread::get_id() != gProfileThread)
+		return;
+
 	FrameCounter++;
 }
 
 
+void CProfileManager::Hold_Reset( bool hold )
+{
+	gResetHeld = hold;
+}
+
+
 /***********************************************************************************************
  * CProfileManager::Get_Time_Since_Reset -- returns the elapsed time since last reset         *
  *=============================================================================================*/
@@ -149,6 +149,9 @@ public:
 	}
 
 	static	void						Reset( void );
+	// Ignore Reset while held, for worlds stepped at once on several threads
+	// into one profile, reset beforehand by the thread that collects it.
+	static	void						Hold_Reset( bool hold );
 	static	void						Increment_Frame_Counter( void );
 	static	int						Get_Frame_Count_Since_Reset( void )		{ return FrameCounter; }
 	static	float						Get_Time_Since_Reset( void );
@@ -7,10 +7,14 @@
 
 #include <glm/fwd.hpp>
 
+#include <memory>
+
 class Box : public Object {
 protected:
+  // The faces are set up unless the geometry already has them.
   Box(const btTransform &transform, const btScalar mass, btVector3 &inertia,
-      const btVector3 &sides);
+      const btVector3 &sides,
+      std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>());
 
 protected:
   void setupFaces(const glm::vec3 &halfSides);
@@ -21,13 +25,32 @@ protected:
 
 //-----------------------------------------------------------------------------
 class BoxBuilder : public ObjectBuilder<BoxBuilder> {
+public:
+  static const btScalar CCD_MOTION_THRESHOLD_RATIO;
+  static const btScalar CCD_SWEPT_SPHERE_RATIO;
+
 public:
   BoxBuilder();
 
   BoxBuilder &setSides(const btVector3 &sidesLength);
 
+  // Continuous collision detection of dynamic boxes. When a box moves more
+  // than the motion threshold in one step, Bullet sweeps a sphere of the
+  // given radius along the motion, so that thin boxes do not tunnel through
+  // each other at low physics rates. Both are ratios of the thinnest half
+  // side unless set, negative values go back to them. A null threshold
+  // disables CCD.
+  BoxBuilder &setCcdMotionThreshold(btScalar motionThreshold);
+  BoxBuilder &setCcdSweptSphereRadius(btScalar sweptSphereRadius);
+
+  // Boxes created one after the other with the same sides share their
+  // geometry.
   Box *create();
 
 private:
   btVector3 m_sidesLengths;
+  std::shared_ptr<Geometry> m_geometry;
+  btVector3 m_geometrySides;
+  btScalar m_ccdMotionThreshold = -1;
+  btScalar m_ccdSweptSphereRadius = -1;
 };
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Engine.h"
+
+#include <string>
+#include <vector>
+
+// Named collision layers, and which pairs of them collide. The broadphase
+// only pairs two bodies when their layers collide, and never two static
+// bodies. A layer takes two bits of the 16 of a Bullet filter, one for its
+// dynamic bodies and one for its static ones.
+class CollisionLayers {
+public:
+  static const int MAX_LAYERS = 8;
+  // Every object starts in it. It collides with every layer until they are
+  // set otherwise.
+  static const int DEFAULT_LAYER = 0;
+  static const char *const DEFAULT_LAYER_NAME;
+
+public:
+  CollisionLayers();
+
+private:
+  std::vector<std::string> m_names;
+  // A bit for every layer the layer collides with, kept symmetric.
+  unsigned int m_collisions[MAX_LAYERS];
+
+public:
+  inline int getLayersNumber() const { return m_names.size(); }
+  inline const std::string &getName(int layer) const { return m_names[layer]; }
+  // The layer called name, -1 if there is none.
+  int findLayer(const std::string &name) const;
+
+  // Create the layer or redefine it. It collides with exactly the layers
+  // listed, itself only if listed, and they with it. Returns the layer.
+  int setLayer(const std::string &name,
+               const std::vector<std::string> &collidingLayers);
+  bool collides(int layer, int otherLayer) const;
+
+  // Filter of the bodies of the layer.
+  CollisionFilter getFilter(int layer, bool dynamic) const;
+};
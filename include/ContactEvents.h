@@ -0,0 +1,108 @@
+#pragma once
+
+#include "RingBuffer.h"
+
+#include <LinearMath/btScalar.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class btCollisionObject;
+class btDispatcher;
+
+struct ContactEvent {
+  enum class Type { ceBegin, ceEnd };
+
+  Type type;
+  // Transform slots of the two bodies, slot0 < slot1.
+  int slot0;
+  int slot1;
+  // Sum of the impulses the solver applied at the contact points during the
+  // step the contact began, 0 for end events.
+  btScalar impulse;
+  // Step of the world the event happened in.
+  unsigned int step;
+};
+
+// Turns the contact manifolds of the dispatcher into begin and end events,
+// queued for another thread. A pair of bodies is touching as long as its
+// manifold holds contact points, so the contact breaking threshold of Bullet
+// keeps resting bodies from flickering in and out of contact. The pairs
+// touching at the first update are where the stream starts from, they get no
+// begin event: a world of dominoes standing on the ground would otherwise
+// fill the queue at once. The manifolds between two sleeping bodies are left
+// as they are by Bullet, and skipped: their pairs keep touching until a body
+// wakes up. The same goes for frozen bodies, whose pairs with each other and
+// with the static ones are gone from the broadphase until they thaw. An
+// update only revisits the pairs seen in the update before and the pairs of
+// the slots passed to revisitSlot, the sleeping part of the world costs
+// nothing. Only meant for the thread stepping the physics, except for
+// popEvent. The ghosts of a region grid stand for their body.
+class ContactEventStream {
+public:
+  // Most events waiting for the consumer, the newer ones are dropped.
+  static const int CAPACITY = 4096;
+
+public:
+  ContactEventStream() {}
+
+  ContactEventStream(const ContactEventStream &) = delete;
+  ContactEventStream &operator=(const ContactEventStream &) = delete;
+
+private:
+  RingBuffer<ContactEvent, CAPACITY> m_events;
+  struct TouchingPair {
+    const btCollisionObject *body0;
+    const btCollisionObject *body1;
+    // Last update the pair was seen touching in.
+    unsigned int update;
+  };
+
+  // Pairs touching after the last update, keyed by their two slots.
+  std::unordered_map<uint64_t, TouchingPair> m_touchingPairs;
+  // Touching pairs of every slot.
+  std::vector<std::vector<uint64_t>> m_slotPairs;
+  // The only pairs that can end in the next update, and the pairs seen
+  // touching in the current one.
+  std::vector<uint64_t> m_revisitPairs;
+  std::vector<uint64_t> m_seenPairs;
+  unsigned int m_updatesNumber = 0;
+
+public:
+  // Compare the manifolds of the dispatchers after a step with the pairs
+  // touching before it.
+  void update(const std::vector<btDispatcher *> &dispatchers,
+              unsigned int step);
+  // Forget the touching pairs without ending them, the next update starts
+  // the stream over. The events still queued are kept.
+  void reset();
+  // Follow the bodies to the slots they moved to, slots maps the old slot to
+  // the new one, -1 when the body is gone. The pairs of a body gone end, the
+  // event naming the slots the two bodies had.
+  void remapSlots(const std::unordered_map<int, int> &slots, unsigned int step);
+  // Check the pairs of slot in the next update, after its body froze or
+  // thawed.
+  void revisitSlot(int slot);
+
+  // Consumer side, safe from one other thread. Returns false once drained.
+  inline bool popEvent(ContactEvent &event) { return m_events.pop(event); }
+  // Events lost because the queue was full.
+  inline unsigned int getDroppedEventsNumber() const {
+    return m_events.getDroppedNumber();
+  }
+  // Producer side.
+  inline int getTouchingPairsNumber() const { return m_touchingPairs.size(); }
+
+private:
+  void addManifolds(btDispatcher *dispatcher, unsigned int step,
+                    bool firstUpdate);
+  void addPair(uint64_t pair, const TouchingPair &touching);
+  void endPair(uint64_t pair, unsigned int step);
+  void pushEvent(ContactEvent::Type type, uint64_t pair, btScalar impulse,
+                 unsigned int step);
+  static uint64_t makePair(int slot0, int slot1);
+  // False when a body of the pair is gone.
+  static bool remapPair(uint64_t &pair,
+                        const std::unordered_map<int, int> &slots);
+};
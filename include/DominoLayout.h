@@ -0,0 +1,77 @@
+#pragma once
+
+#include <LinearMath/btAlignedObjectArray.h>
+#include <LinearMath/btScalar.h>
+#include <LinearMath/btTransform.h>
+#include <LinearMath/btVector3.h>
+
+#include <functional>
+#include <vector>
+
+class BoxBuilder;
+class Object;
+
+// Transforms of dominoes standing along paths on the ground.
+// The paths lie in the xz plane at the height of their points, the dominoes
+// stand on it every spacing along the path, measured along the curve, their
+// thin side facing the way the path goes. The first domino of every path
+// leans forward by the tip angle, so that the whole path falls once the
+// simulation starts.
+class DominoLayout {
+public:
+  static const btScalar DEFAULT_TIP_ANGLE;
+
+public:
+  DominoLayout(const btVector3 &sides, btScalar spacing);
+
+private:
+  btVector3 m_sides;
+  btScalar m_spacing;
+  btScalar m_tipAngle = DEFAULT_TIP_ANGLE;
+  btAlignedObjectArray<btTransform> m_transforms;
+
+  // Samples of a curve per domino, for the curves spaced along their length.
+  static const int SAMPLES_PER_DOMINO = 8;
+  static const int MIN_SAMPLES = 64;
+
+public:
+  inline const btVector3 &getSides() const { return m_sides; }
+  inline btScalar getSpacing() const { return m_spacing; }
+  // Null leaves all the dominoes standing.
+  inline void setTipAngle(btScalar tipAngle) { m_tipAngle = tipAngle; }
+
+  inline int getDominoesNumber() const { return m_transforms.size(); }
+  inline const btTransform &getTransform(int domino) const {
+    return m_transforms[domino];
+  }
+  void reserve(int dominoesNumber);
+
+  // Paths. The number of dominoes follows the length of the path, the last
+  // one falls short of the end unless the length is a multiple of the
+  // spacing.
+  void traceLine(const btVector3 &origin, const btVector3 &destination);
+  // Angles in radians, from the x axis towards the z axis.
+  void traceArc(const btVector3 &center, btScalar radius, btScalar startAngle,
+                btScalar endAngle);
+  // Archimedean spiral from the start radius to the end radius, starting on
+  // the x axis and turning like the arcs. Negative turns go the other way.
+  void traceSpiral(const btVector3 &center, btScalar startRadius,
+                   btScalar endRadius, btScalar turns);
+  // Cubic Bezier curve from the first control point to the last.
+  void traceBezier(const btVector3 &point0, const btVector3 &point1,
+                   const btVector3 &point2, const btVector3 &point3);
+  // Rows along x one behind the other along z, columns dominoes each. Every
+  // row is a path of its own.
+  void traceGrid(const btVector3 &origin, int columns, int rows,
+                 btScalar rowDistance);
+
+  // Build a box for every domino, sharing one collision shape and one
+  // geometry. The builder gives the mass and the look, the sides and the
+  // transforms are the ones of the layout.
+  void createDominoes(BoxBuilder &builder, std::vector<Object *> &dominoes);
+
+private:
+  void traceCurve(const std::function<btVector3(btScalar)> &curve);
+  void addDomino(const btVector3 &position, const btVector3 &direction,
+                 bool first);
+};
@@ -6,6 +6,7 @@
 #include "MirrorShader.h"
 #include "PhongShader.h"
 #include "PhongNormalMappingShader.h"
+#include "StaticBatch.h"
 #include "TextureManager.h"    
 
 #include <GL/glew.h>
@@ -15,10 +16,13 @@
 
 #include <map>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 class Box;
+struct Geometry;
 class LightBulb;
 class LightedObjectShader;
 class Mirror;
@@ -43,6 +47,21 @@ public:
                             const World &world);
   void initMirror(const Mirror *mirror);
 
+  // Objects added to the world once the drawer is set up, drawn with the
+  // shader of the shader map named shaderName. Call removeObjects() before
+  // the world deletes them. The buffers of a geometry go with its last
+  // object, the textures stay with the texture manager.
+  void addObjects(const std::vector<const Object *> &objects,
+                  const std::string &shaderName);
+  void removeObjects(const std::vector<const Object *> &objects);
+
+  // Move the phong objects the world froze since the last call into static
+  // batches, and the ones it thawed back out. The normal mapped objects are
+  // not batched: their shader takes tangents and a texture array the batches
+  // do not have, and they are the planes of the scene, static from the start
+  // and never frozen.
+  void updateStaticBatches(World *world);
+
   // Drawing functions.
   void drawWorld(const World *world, const glm::mat4 &originalModelView,
                  const glm::mat4 &projection,
@@ -89,6 +108,19 @@ private:
   void createPhongNormalMappingObjectGPUBuffers(const Object *object);
 
   void createMirrorObjectGPUBuffers();
+  // Give the object the VAO already made for its geometry and shader, if
+  // any.
+  bool shareGeometryVAO(const Object *object, const ShaderProgram &shader);
+  // The geometry key is null for the VAOs made for one object only.
+  void addVertexArray(const Object *object, GLuint vaoId,
+                      std::vector<GLuint> vboIds,
+                      const ShaderProgram *geometryShader);
+  void releaseVertexArray(const Object *object);
+  void addObject(const Object *object, std::vector<const Object *> &objects);
+  void addDynamicPhongObject(const Object *object);
+  void removeDynamicPhongObject(const Object *object);
+  // Drop the batches left empty, then upload the changes of the others.
+  void updateBatches();
 
   void createObjectTextures(const Object *object);
   void createMirrorObjects();
@@ -135,6 +167,10 @@ private:
                        const glm::mat4 &originalShadowModelView,
                        const glm::mat4 &shadowProjection) const;
 
+  void drawStaticBatch(const StaticBatch &batch,
+                       const glm::mat4 &originalModelView,
+                       const glm::mat4 &projection) const;
+
   void drawPhongNormalMappingObject(const Object *object,
                                     const glm::mat4 &originalModelView,
                                     const glm::mat4 &projection,
@@ -159,9 +195,23 @@ private:
 private:
   std::vector<const Object *> m_lightBulbs;
   std::vector<const Object *> m_phongObjects;
+  // The phong objects not in a static batch.
+  std::vector<const Object *> m_dynamicPhongObjects;
+  std::vector<std::unique_ptr<StaticBatch>> m_staticBatches;
+  std::vector<const Object *> m_frozenChanges;
   std::vector<const Object *> m_phongNormalMappingObjects;
   const Mirror *m_mirror = nullptr;
 
+  // List of each object drawn and its position there, for removals. A phong
+  // object is either at dynamicIndex in m_dynamicPhongObjects or in batch.
+  struct ObjectEntry {
+    std::vector<const Object *> *objects;
+    int index;
+    int dynamicIndex;
+    StaticBatch *batch;
+  };
+  std::unordered_map<const Object *, ObjectEntry> m_objectEntries;
+
   glm::ivec2 m_screenSize;
 
   LightBulbShader m_lightBulbShader;
@@ -176,6 +226,17 @@ private:
   // Mapping between shaders and world objects.
   // Mapping between world objects and VAOs.
   std::unordered_map<const Object *, GLuint> m_vaoWorldMap;
+  // Mapping between geometries shared by several objects and their VAO, for
+  // each shader.
+  std::map<std::pair<const ShaderProgram *, const Geometry *>, GLuint>
+      m_geometryVaoMap;
+  // Buffers of every VAO and the objects drawn with it.
+  struct VertexArray {
+    std::vector<GLuint> vboIds;
+    int usersNumber;
+    std::pair<const ShaderProgram *, const Geometry *> geometryKey;
+  };
+  std::unordered_map<GLuint, VertexArray> m_vertexArrays;
   // Mapping between world objects shadows and VAOs.
   std::unordered_map<const Object *, GLuint> m_vaoShadowMap;
   // Mapping between world objects and their vertex VBO.
@@ -185,8 +246,8 @@ private:
   // Mapping between world objects and their normal texture objects.
   std::unordered_map<const Object *, GLuint> m_normalTextureMap;
 
-  // Ids of VBOs associated with the VAOs. These are kept so I know what to
-  // delete to free the memory.
+  // Ids of the canvas VBOs. These are kept so I know what to delete to free
+  // the memory.
   std::vector<GLuint> m_vboIds;
 
   GLuint m_mirrorFBO = 0;
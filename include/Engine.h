@@ -2,7 +2,53 @@
 
 #include <btBulletDynamicsCommon.h>
 
+class btMLCPSolverInterface;
+class btThreadSupportInterface;
+class ParallelDynamicsWorld;
+class ThreadPool;
+
+// Constraint solving strategies.
+// stSequential: one btSequentialImpulseConstraintSolver for the whole world.
+// stIslands: awake islands solved concurrently on a thread pool.
+// stBatches: btParallelConstraintSolver, needs MULTITHREADED_PHYSICS.
+// stDantzig: btMLCPSolver with the Dantzig direct solver, island by island.
+//            Exact, but cubic in the contacts of an island: small scenes only.
+// stProjectedGaussSeidel: btMLCPSolver with projected Gauss-Seidel.
+// stSimd: stSequential with the contact rows solved in SIMD packets, see
+//         SimdContactSolver.
+enum class SolverType {
+  stSequential,
+  stIslands,
+  stBatches,
+  stDantzig,
+  stProjectedGaussSeidel,
+  stSimd
+};
+
+// Broadphases.
+// bpDbvt: dynamic AABB trees, no bounds nor size limit, paired on the
+//         threads, see ParallelDbvtBroadphase.
+// bpAxisSweep: 16 bit sweep and prune, at most AXIS_SWEEP_MAX_HANDLES bodies.
+// bpAxisSweep32: 32 bit sweep and prune.
+// bpSimple: brute force, for comparison on small scenes only.
+// The sweep and prune variants quantize the AABBs within the world bounds.
+enum class BroadphaseType { bpDbvt, bpAxisSweep, bpAxisSweep32, bpSimple };
+
+// Broadphase filter of a body: two bodies are paired only when the group of
+// each one is in the mask of the other.
+struct CollisionFilter {
+  short group;
+  short mask;
+};
+
 class Engine {
+public:
+  static const int AXIS_SWEEP_MAX_HANDLES = 32766;
+  static const btVector3 DEFAULT_WORLD_MIN;
+  static const btVector3 DEFAULT_WORLD_MAX;
+  static const int DEFAULT_SOLVER_ITERATIONS = 10;
+  static const btScalar PENETRATION_TOLERANCE;
+
 public:
   Engine();
   ~Engine();
@@ -11,15 +57,126 @@ private:
   btBroadphaseInterface *m_broadphase = nullptr;
   btDefaultCollisionConfiguration *m_collisionConfiguration = nullptr;
   btCollisionDispatcher *m_collisionDispatcher = nullptr;
-  btSequentialImpulseConstraintSolver *m_constraintSolver = nullptr;
-  btDiscreteDynamicsWorld *m_dynamicsWorld = nullptr;
+  btConstraintSolver *m_constraintSolver = nullptr;
+  btMLCPSolverInterface *m_mlcpSolver = nullptr;
+  ParallelDynamicsWorld *m_dynamicsWorld = nullptr;
+  btThreadSupportInterface *m_collisionThreadSupport = nullptr;
+  btThreadSupportInterface *m_solverThreadSupport = nullptr;
+  // Shared by the world and the broadphase.
+  ThreadPool *m_threadPool = nullptr;
   btVector3 m_gravity;
+  int m_threadsNumber = 1;
+  SolverType m_solverType = SolverType::stSequential;
+  BroadphaseType m_broadphaseType = BroadphaseType::bpDbvt;
+  // Type of m_broadphase, until a rebuild brings it to m_broadphaseType.
+  BroadphaseType m_builtBroadphaseType = BroadphaseType::bpDbvt;
+  btVector3 m_worldMin = DEFAULT_WORLD_MIN;
+  btVector3 m_worldMax = DEFAULT_WORLD_MAX;
+  // Bodies the fixed size broadphases have room for.
+  int m_broadphaseCapacity = DEFAULT_BROADPHASE_CAPACITY;
+
+  // Bounds of the solver iterations and time budget of a step in seconds.
+  int m_solverIterations = DEFAULT_SOLVER_ITERATIONS;
+  int m_minSolverIterations = DEFAULT_SOLVER_ITERATIONS;
+  int m_maxSolverIterations = DEFAULT_SOLVER_ITERATIONS;
+  double m_stepBudget = 0;
+
+  static const int DEFAULT_BROADPHASE_CAPACITY = 16384;
 
 public:
   btDiscreteDynamicsWorld *getDynamicsWorld() const;
 
+  // One fixed time step, then the solver iterations are adapted for the next
+  // one.
+  void stepSimulation(btScalar timeStep);
+
   const btVector3 &getGravity() const;
   void setGravity(const btVector3 &gravity);
 
-  void addRigidBody(btRigidBody *rigidBody);
+  // Number of threads used by the parallel solvers, the AABB updates and the
+  // dbvt broadphase and, in builds with MULTITHREADED_PHYSICS, by the
+  // narrowphase.
+  inline int getThreadsNumber() const { return m_threadsNumber; }
+  void setThreadsNumber(int threadsNumber);
+
+  inline SolverType getSolverType() const { return m_solverType; }
+  void setSolverType(SolverType solverType);
+
+  inline BroadphaseType getBroadphaseType() const { return m_broadphaseType; }
+  void setBroadphaseType(BroadphaseType broadphaseType);
+
+  // Bounds of the sweep and prune broadphases. Bodies outside still collide,
+  // but all of them are piled on the border.
+  inline const btVector3 &getWorldMin() const { return m_worldMin; }
+  inline const btVector3 &getWorldMax() const { return m_worldMax; }
+  void setWorldBounds(const btVector3 &worldMin, const btVector3 &worldMax);
+
+  // The solver iterations follow the contacts, between the bounds: raised
+  // while the deepest contact penetrates more than PENETRATION_TOLERANCE,
+  // lowered as the contacts settle, down to the minimum without contacts.
+  // A step longer than the budget scales them down to fit. Equal bounds keep
+  // the iterations fixed. A null budget is no budget, a positive one makes
+  // the simulation depend on the machine.
+  inline int getSolverIterations() const { return m_solverIterations; }
+  inline int getMinSolverIterations() const { return m_minSolverIterations; }
+  inline int getMaxSolverIterations() const { return m_maxSolverIterations; }
+  inline double getStepBudget() const { return m_stepBudget; }
+  void setSolverIterations(int minIterations, int maxIterations,
+                           double stepBudget);
+
+  // Bullet only moves the bodies that are dynamic when added: a dynamic body
+  // goes in as one even while frozen, to be able to thaw.
+  void addRigidBody(btRigidBody *rigidBody, const CollisionFilter &filter,
+                    bool dynamic);
+  // Add many bodies at once, with a filter and a dynamic flag each. Inserted one after the other
+  // in spatial order, each one lands at the bottom of the dynamic AABB tree
+  // next to the last: the tree turns into a list. They go in scattered
+  // instead, and their pairs are found in one pass over the whole tree, or by
+  // a query for each of them once the world holds other bodies.
+  void addRigidBodies(btRigidBody *const *rigidBodies,
+                      const CollisionFilter *filters, const bool *dynamic,
+                      int bodiesNumber);
+  // Searches the bodies and the pairs, meant for the odd body only.
+  void removeRigidBody(btRigidBody *rigidBody);
+  // Take many bodies out at once, with a single pass over the pairs and one
+  // over the bodies of the world however many of them go.
+  void removeRigidBodies(btRigidBody *const *rigidBodies, int bodiesNumber);
+  // Take all the bodies out of the world, in one go. The bodies are not
+  // deleted, they belong to the objects.
+  void removeAllRigidBodies();
+
+  // Turn a dynamic body into a static one and back. A frozen body takes no
+  // part in the simulation islands, so waking a neighbour does not wake it.
+  void freezeRigidBody(btRigidBody *rigidBody);
+  void thawRigidBody(btRigidBody *rigidBody, btScalar mass,
+                     const btVector3 &inertia);
+
+  int getActiveRigidBodiesNumber() const;
+  int getManifoldsNumber() const;
+  // Islands of the last step holding a body Bullet has not put to sleep.
+  int getAwakeIslandsNumber() const;
+
+  // Drop the contact manifolds and their cached impulses. The overlapping
+  // pairs stay, the next step finds the contacts again.
+  void resetContacts();
+
+  // The filter the body was added with, or last given.
+  static CollisionFilter getCollisionFilter(const btCollisionObject *object);
+  // Give bodies in the world new filters, in place. The pairs the new filters
+  // reject go along with their manifolds, and the pairs they accept are
+  // looked up around the bodies: the broadphases only pair bodies as they
+  // move.
+  void setCollisionFilters(btRigidBody *const *rigidBodies,
+                           const CollisionFilter *filters, int bodiesNumber);
+
+private:
+  btBroadphaseInterface *createBroadphase() const;
+  void reserveBroadphase(int bodiesNumber);
+  void releaseProxies();
+  void createDynamicsWorld();
+  void destroyDynamicsWorld();
+  void rebuildDynamicsWorld();
+  void addToWorld(btRigidBody *rigidBody, const CollisionFilter &filter,
+                  bool dynamic);
+  void adaptSolverIterations(double stepTime);
 };
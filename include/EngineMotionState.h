@@ -0,0 +1,31 @@
+#pragma once
+
+#include <LinearMath/btMotionState.h>
+#include <LinearMath/btTransform.h>
+
+class TransformBuffer;
+class btCollisionObject;
+
+// Motion state forwarding the transforms computed by Bullet to a slot of a
+// TransformBuffer. Bullet only calls setWorldTransform for bodies that moved,
+// so static and sleeping bodies never reach the buffer after being bound.
+class EngineMotionState : public btMotionState {
+public:
+  BT_DECLARE_ALIGNED_ALLOCATOR();
+
+  EngineMotionState(const btTransform &startTransform);
+
+private:
+  btTransform m_transform;
+  TransformBuffer *m_buffer = nullptr;
+  int m_slot = -1;
+
+public:
+  void bind(TransformBuffer *buffer, int slot);
+  inline int getSlot() const { return m_slot; }
+  // Slot of a body of the world, -1 for anything else.
+  static int getBodySlot(const btCollisionObject *object);
+
+  virtual void getWorldTransform(btTransform &worldTransform) const override;
+  virtual void setWorldTransform(const btTransform &worldTransform) override;
+};
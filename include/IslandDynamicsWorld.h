@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ParallelDynamicsWorld.h"
+
+#include <vector>
+
+// Dynamics world solving independent simulation islands concurrently.
+// Islands go to the work stealing thread pool of the world and each one is
+// solved on its own by a btSequentialImpulseConstraintSolver owned by the
+// worker.
+// Since islands do not share dynamic bodies and every solve starts from a
+// reset solver, the result does not depend on the number of threads.
+class IslandDynamicsWorld : public ParallelDynamicsWorld {
+public:
+  // The given solver is used by worker 0, the other workers get their own.
+  IslandDynamicsWorld(btDispatcher *dispatcher,
+                      btBroadphaseInterface *broadphase,
+                      btSequentialImpulseConstraintSolver *constraintSolver,
+                      btCollisionConfiguration *collisionConfiguration,
+                      ThreadPool &threadPool);
+  virtual ~IslandDynamicsWorld();
+
+private:
+  struct Island {
+    int bodiesBegin;
+    int bodiesNumber;
+    btPersistentManifold **manifolds;
+    int manifoldsNumber;
+    btTypedConstraint **constraints;
+    int constraintsNumber;
+    bool touchesKinematic;
+  };
+
+  // A task solves a run of consecutive islands.
+  struct IslandTask {
+    int islandsBegin;
+    int islandsEnd;
+    int cost;
+  };
+
+  class IslandCollector;
+
+  std::vector<btSequentialImpulseConstraintSolver *> m_solvers;
+  btAlignedObjectArray<btCollisionObject *> m_islandBodies;
+  std::vector<Island> m_islands;
+  std::vector<IslandTask> m_tasks;
+  static const int MIN_TASK_COST = 128;
+
+protected:
+  virtual void solveConstraints(btContactSolverInfo &solverInfo) override;
+
+private:
+  void buildTasks();
+  void solveIsland(const Island &island, btContactSolverInfo &solverInfo,
+                   btSequentialImpulseConstraintSolver *solver);
+};
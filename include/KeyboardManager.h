@@ -18,10 +18,17 @@ public:
   int getLightMask() const;
   void setLightMask(int lightMask);
 
+  // Seconds of playback to skip since the last call.
+  int takePlaybackSkip();
+  // Whether a reset of the scene was asked since the last call.
+  bool takeResetRequest();
+
 private:
   Window *m_window = nullptr;
 
   int m_lightMask = 0;
+  int m_playbackSkip = 0;
+  bool m_resetRequested = false;
 
   bool m_leftDown = 0;
   bool m_rightDown = 0;
@@ -4,7 +4,11 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
-class LightedObjectShader;
+enum class LightType {
+  ltDirectional,
+  ltPositional,
+  ltSpot
+};
 
 // -----------------------------------------------------------------------------
 class Light {
@@ -23,8 +27,9 @@ public:
 public:
   virtual ~Light(){};
 
-  virtual void setUniforms(const LightedObjectShader &shader,
-                           const glm::mat4 &modelView) const;
+  virtual LightType getType() const = 0;
+
+  inline int getNumber() const { return m_number; }
 
   void setDiffuseColor(const glm::vec4 &color);
   const glm::vec4 &getDiffuseColor() const;
@@ -52,10 +57,9 @@ private:
 public:
   virtual ~DirectionalLight(){};
 
-  void setUniforms(const LightedObjectShader &shader,
-                   const glm::mat4 &modelView) const override;
+  LightType getType() const override { return LightType::ltDirectional; }
   void setDirection(const glm::vec3 &direction);
-  const glm::vec4 &getDirection();
+  const glm::vec4 &getDirection() const;
 
 private:
   glm::vec4 m_direction;
@@ -71,20 +75,19 @@ protected:
 public:
   virtual ~PositionalLight(){};
 
+  LightType getType() const override { return LightType::ltPositional; }
+
   void setPosition(const glm::vec3 &position);
-  const glm::vec4 &getPosition();
+  const glm::vec4 &getPosition() const;
 
   void setConstantAttenuation(float attenuation);
-  float getConstantAttenuation();
+  float getConstantAttenuation() const;
 
   void setLinearAttenuation(float attenuation);
-  float getLinearAttenuation();
+  float getLinearAttenuation() const;
 
   void setQuadraticAttenuation(float attenuation);
-  float getQuadraticAttenuation();
-
-  void setUniforms(const LightedObjectShader &shader,
-                   const glm::mat4 &modelView) const override;
+  float getQuadraticAttenuation() const;
 
 protected:
   glm::vec4 m_position;
@@ -103,17 +106,16 @@ private:
 public:
   virtual ~SpotLight() {}
 
+  LightType getType() const override { return LightType::ltSpot; }
+
   void setDirection(const glm::vec3 &direction);
-  const glm::vec4 &getDirection();
+  const glm::vec4 &getDirection() const;
 
   void setCutOff(float cutOff);
-  float getCutOff();
+  float getCutOff() const;
 
   void setExponent(float exponent);
-  float getExponent();
-
-  void setUniforms(const LightedObjectShader &shader,
-                   const glm::mat4 &modelView) const override;
+  float getExponent() const;
 
 private:
   glm::vec4 m_direction;
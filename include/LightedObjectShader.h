@@ -2,8 +2,15 @@
 
 #include "ShaderProgram.h"
 
+#include <glm/fwd.hpp>
+
 #include <vector>
 
+class DirectionalLight;
+class Light;
+class PositionalLight;
+class SpotLight;
+
 class LightedObjectShader : public ShaderProgram {
 public:
   enum LightUniformName {
@@ -28,12 +35,21 @@ public:
 public:
   template <typename type>
   void setLightUniform(int lightIndex, int nameIndex, const type &value) const;
+  void setLightUniforms(const Light &light, const glm::mat4 &modelView) const;
   virtual ShaderType getType() const override = 0; 
 
 protected:
   std::vector<int>
   createLightUniformTable(std::vector<std::string> &uniformLightNames);
 
+  void setBaseLightUniforms(const Light &light) const;
+  void setDirectionalLightUniforms(const DirectionalLight &light,
+                                   const glm::mat4 &modelView) const;
+  void setPositionalLightUniforms(const PositionalLight &light,
+                                  const glm::mat4 &modelView) const;
+  void setSpotLightUniforms(const SpotLight &light,
+                            const glm::mat4 &modelView) const;
+
 protected:
   std::vector<int> m_uniformLightLocations;
   static std::vector<std::string> uniformLightNames;
@@ -10,10 +10,12 @@ class ObjParser;
 class Mesh : public Object {
 private:
   Mesh(const btTransform &transform, const btScalar mass, btVector3 &inertia,
-       const std::string &meshFile);
+       const std::string &meshFile, btScalar shapeTolerance,
+       bool triangleMesh);
   void parseObjFile(const std::string &meshFile);
   void fillMesh(const ObjParser &objParser);
-  void setupBulletShape();
+  void setupBulletShape(const std::string &meshFile, btScalar shapeTolerance,
+                        bool triangleMesh);
 
   friend class MeshBuilder;
 };
@@ -24,8 +26,16 @@ public:
   MeshBuilder();
 
   MeshBuilder &setMeshFile(const std::string &meshFile);
+  // How far the collision shape may be from the mesh to be a primitive
+  // instead of a hull, see ShapeFitter. Zero takes exact matches only.
+  MeshBuilder &setShapeTolerance(btScalar shapeTolerance);
+  // Collide with the triangles of the mesh instead, for static meshes such as
+  // terrain or buildings, see ShapeCache::acquireTriangleMesh.
+  MeshBuilder &setTriangleMesh(bool triangleMesh);
   Mesh *create();
 
 private:
   std::string m_meshFile;
+  btScalar m_shapeTolerance;
+  bool m_triangleMesh = false;
 };
@@ -1,11 +1,8 @@
 #pragma once
 
 #include "Box.h"
-#include "ShaderProgram.h"
-#include "SysUtils.h"
-
-#include <GL/glew.h>
 
+#include <glm/fwd.hpp>
 #include <glm/vec2.hpp>
 
 #include <LinearMath/btScalar.h>
@@ -1,14 +1,17 @@
 #pragma once
 
+#include "EngineMotionState.h"
 #include "Entity.h"
 
 #include <btBulletDynamicsCommon.h>
 #include <LinearMath/btScalar.h>
 
 #include <glm/fwd.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
 #include <glm/vec3.hpp>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -17,6 +20,16 @@ class btVector3;
 class Drawer;
 class ShaderProgram;
 
+// Vertices of an object, in object space. The objects built alike share one,
+// and the GPU buffers made from it.
+struct Geometry {
+  std::vector<glm::vec3> points;
+  std::vector<glm::vec3> normals;
+  std::vector<unsigned int> indices;
+  std::vector<glm::vec2> textureCoos;
+  std::vector<glm::vec3> tangents;
+};
+
 class Object : public Entity {
 public:
   static const glm::vec3 DEFAULT_POSITION;
@@ -26,7 +39,8 @@ public:
   static const glm::vec4 DEFAULT_SPECULAR_COLOR;
 
 protected:
-  Object(const btTransform &transform, btScalar mass, btVector3 &inertia);
+  Object(const btTransform &transform, btScalar mass, btVector3 &inertia,
+         std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>());
 
 public:
   virtual ~Object();
@@ -35,17 +49,17 @@ protected:
   // Physical parameters.
   btScalar m_mass = 0;
   btVector3 m_inertia;
+  // Owned by the ShapeCache.
   btCollisionShape* m_collisionShape = nullptr;
+  // The body and its motion state come from pools shared by all objects.
   btRigidBody* m_rigidBody = nullptr;
-  btDefaultMotionState* m_motionState = nullptr;
-  btRigidBody::btRigidBodyConstructionInfo* m_constructionInfo = nullptr;
+  EngineMotionState* m_motionState = nullptr;
+  bool m_frozen = false;
+  // Layer of the world collision layers, the default one to start with.
+  int m_collisionLayer = 0;
 
-  // Shape parameters.
-  std::vector<glm::vec3> m_points;
-  std::vector<glm::vec3> m_normals;
-  std::vector<unsigned int> m_indices;
-  std::vector<glm::vec2> m_textureCoos;
-  std::vector<glm::vec3> m_tangents;
+  // Shape parameters, shared by the objects built alike.
+  std::shared_ptr<Geometry> m_geometry;
 
   // Material colors.
   glm::vec4 m_ambientColor;
@@ -58,6 +72,8 @@ protected:
   std::string m_name;
 
 public:
+  inline const Geometry *getGeometry() const { return m_geometry.get(); }
+
   const float* getPoints() const;
   int getPointsNumber() const;
 
@@ -69,10 +85,10 @@ public:
   const float* getTangents() const;
 
   inline int getTrigsNumber() const {
-    return m_indices.size() / 3;
+    return m_geometry->indices.size() / 3;
   }
   inline int getIndicesNumber() const {
-    return m_indices.size();
+    return m_geometry->indices.size();
   }
 
   inline const glm::vec4 &getAmbientColor() const {
@@ -102,20 +118,26 @@ public:
   void setInertia(const btVector3& inertia);
 
   btCollisionShape* getCollisionShape() const;
+  // Takes over a reference acquired from the ShapeCache.
   void setCollisionShape(btCollisionShape* collisionShape);
 
   inline btRigidBody* getRigidBody() const {
     return m_rigidBody;
   }
-  void setRigidBody(btRigidBody* rigidBody);
 
-  btDefaultMotionState* getMotionState() const;
-  void setMotionState(btDefaultMotionState* motionState);
+  EngineMotionState* getMotionState() const;
+
+  // Slot of the object in the world transform buffer, -1 until added.
+  inline int getTransformSlot() const { return m_motionState->getSlot(); }
 
-  btRigidBody::btRigidBodyConstructionInfo* 
-               getConstructionInfo() const;
-  void setConstructionInfo(btRigidBody::btRigidBodyConstructionInfo* 
-                           constructionInfo);
+  // Whether the body settled and has been frozen into a static one, as last
+  // synced from the simulation.
+  inline bool isFrozen() const { return m_frozen; }
+  inline void setFrozen(bool frozen) { m_frozen = frozen; }
+
+  // Read when the object is added to the world.
+  inline int getCollisionLayer() const { return m_collisionLayer; }
+  inline void setCollisionLayer(int layer) { m_collisionLayer = layer; }
 
   inline void getOpenGLMatrix(btScalar* matrix) const {
     m_transform.getOpenGLMatrix(matrix);
@@ -128,6 +150,11 @@ public:
   inline const std::string &getNormalTextureFile() const {
     return m_normalTextureFile;
   }
+
+protected:
+  // Build the rigid body around the collision shape, once the subclass set
+  // it.
+  void setupRigidBody();
 };
 
 //-----------------------------------------------------------------------------
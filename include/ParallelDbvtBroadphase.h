@@ -0,0 +1,62 @@
+#pragma once
+
+#include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+// Dbvt broadphase finding its pairs on a thread pool. A proxy whose AABB
+// leaves its leaf only has its leaf updated, and is paired with both trees
+// once the AABBs of the step are all set, instead of right away against
+// trees only partly updated. With deferred collisions, the dynamic tree is
+// paired with the static one and with itself, split into pairs of subtrees.
+// Either way the traversals are dealt to the threads in chunks, each one
+// filling a pair buffer of its own, and the buffers go to the pair cache in
+// chunk order: the pairs do not depend on the number of threads. They are
+// the ones of btDbvtBroadphase, but not in its order, so the engine uses this
+// broadphase with a single thread as well.
+class ParallelDbvtBroadphase : public btDbvtBroadphase {
+public:
+  // Subtree pairs a deferred traversal is split into at least, when the
+  // trees are deep enough.
+  static const int MIN_SUBTREE_PAIRS = 256;
+  // Node pairs traversed by a task.
+  static const int NODE_PAIRS_CHUNK = 32;
+
+public:
+  explicit ParallelDbvtBroadphase(ThreadPool &threadPool);
+
+private:
+  struct NodePair {
+    const btDbvtNode *a;
+    const btDbvtNode *b;
+  };
+  typedef std::pair<btBroadphaseProxy *, btBroadphaseProxy *> ProxyPair;
+
+  class PairCollector;
+
+  ThreadPool &m_threadPool;
+  // Proxies moved out of their leaf since the last pairs.
+  std::vector<btDbvtProxy *> m_movedProxies;
+  // Proxies destroyed since, their memory is gone: compared, never followed.
+  // They leave m_movedProxies in one pass before the pairs.
+  std::unordered_set<const btBroadphaseProxy *> m_destroyedProxies;
+  std::vector<NodePair> m_nodePairs;
+  std::vector<NodePair> m_splitPairs;
+  std::vector<std::vector<ProxyPair>> m_chunkPairs;
+
+public:
+  virtual void destroyProxy(btBroadphaseProxy *proxy,
+                            btDispatcher *dispatcher) override;
+  virtual void setAabb(btBroadphaseProxy *proxy, const btVector3 &aabbMin,
+                       const btVector3 &aabbMax,
+                       btDispatcher *dispatcher) override;
+  virtual void calculateOverlappingPairs(btDispatcher *dispatcher) override;
+
+private:
+  void splitTraversal();
+  void collideNodePairs();
+};
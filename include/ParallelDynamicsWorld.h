@@ -0,0 +1,52 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+
+#include <unordered_set>
+
+class ThreadPool;
+
+// Dynamics world computing the AABBs of its bodies on a thread pool, in
+// chunks of consecutive bodies. The broadphase then takes them one after the
+// other, in the order of the bodies, as btCollisionWorld::updateAabbs does.
+// With a single thread the world is a btDiscreteDynamicsWorld.
+class ParallelDynamicsWorld : public btDiscreteDynamicsWorld {
+public:
+  // Bodies of an AABB task.
+  static const int AABB_CHUNK = 256;
+
+public:
+  ParallelDynamicsWorld(btDispatcher *dispatcher,
+                        btBroadphaseInterface *broadphase,
+                        btConstraintSolver *constraintSolver,
+                        btCollisionConfiguration *collisionConfiguration,
+                        ThreadPool &threadPool);
+
+private:
+  ThreadPool &m_threadPool;
+  btAlignedObjectArray<btVector3> m_aabbMins;
+  btAlignedObjectArray<btVector3> m_aabbMaxs;
+
+public:
+  inline ThreadPool &getThreadPool() { return m_threadPool; }
+  // The bodies dynamic when added, frozen ones included.
+  inline const btAlignedObjectArray<btRigidBody *> &
+  getNonStaticRigidBodies() const {
+    return m_nonStaticRigidBodies;
+  }
+
+  virtual void updateAabbs() override;
+
+  // Take the bodies out of the arrays of the world in one pass, the others
+  // keep their order. Their proxies and pairs must be gone already.
+  void removeRigidBodies(
+      const std::unordered_set<const btCollisionObject *> &rigidBodies);
+
+private:
+  bool needsAabb(const btCollisionObject *object) const;
+  // The AABB btCollisionWorld::updateSingleAabb gives the broadphase.
+  void computeAabb(const btCollisionObject *object, btVector3 &aabbMin,
+                   btVector3 &aabbMax) const;
+  void setAabb(btCollisionObject *object, const btVector3 &aabbMin,
+               const btVector3 &aabbMax);
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <string>
+
+class CProfileIterator;
+
+// Timings of a physics step, in milliseconds, and the state of the world
+// after it.
+struct StepProfile {
+  // Step of the world the profile was taken after.
+  unsigned int step = 0;
+  // Updating the AABBs and finding the overlapping pairs.
+  double broadphase = 0;
+  // Contact points of the overlapping pairs.
+  double narrowphase = 0;
+  // Islands and constraint solver.
+  double solver = 0;
+  // Velocities, continuous collision and new transforms.
+  double integration = 0;
+  // The whole step, the stages above included.
+  double total = 0;
+  int activeBodies = 0;
+  int manifolds = 0;
+  // Islands holding a body Bullet has not put to sleep.
+  int awakeIslands = 0;
+};
+
+// Reads the stages of the last step from the profile Bullet keeps with
+// btQuickprof, which starts over with every step. The thread stepping the
+// physics records the steps, another one can take their average. With
+// regions, only the regions stepped by the calling thread are timed. Every
+// step also goes to a CSV file when one is given.
+class PhysicsProfiler {
+public:
+  // An empty file name writes no CSV.
+  PhysicsProfiler(const std::string &csvFile);
+
+  PhysicsProfiler(const PhysicsProfiler &) = delete;
+  PhysicsProfiler &operator=(const PhysicsProfiler &) = delete;
+
+private:
+  std::ofstream m_csv;
+  mutable std::mutex m_mutex;
+  // Sums of the steps since the last takeAverage().
+  StepProfile m_sum;
+  int m_stepsNumber = 0;
+  StepProfile m_average;
+
+public:
+  // Producer side, right after the step. The counts are the ones of the
+  // world after it.
+  void recordStep(unsigned int step, int activeBodies, int manifolds,
+                  int awakeIslands);
+
+  // Consumer side. The average of the steps recorded since the last call,
+  // or the last average when no step was. Returns false until the first
+  // step.
+  bool takeAverage(StepProfile &profile);
+
+  // Milliseconds spent in the samples called name, at any depth below the
+  // current node of the iterator.
+  static double getSampleTime(CProfileIterator *iterator, const char *name);
+
+private:
+  static void readStages(StepProfile &profile);
+  void writeCsv(const StepProfile &profile);
+};
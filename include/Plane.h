@@ -14,7 +14,7 @@ private:
 
 private:
   void computePoints(const btScalar side);
-  void setupBulletShape();
+  void setupBulletShape(const btScalar side);
 
 private:
   int m_textureRepetitions = 0; 
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <LinearMath/btAlignedAllocator.h>
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Typed pool building its objects in contiguous blocks of BLOCK_SIZE slots,
+// so objects created one after the other sit next to each other in memory.
+// The slots of destroyed objects are reused first, the blocks are given back
+// only when the pool goes. Slots are aligned to 16 bytes, as Bullet wants for
+// its vectors and transforms.
+template <typename T, int BLOCK_SIZE = 1024> class Pool {
+public:
+  Pool() {}
+  ~Pool() {
+    for (auto block : m_blocks)
+      btAlignedFree(block);
+  }
+
+  Pool(const Pool &) = delete;
+  Pool &operator=(const Pool &) = delete;
+
+private:
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+
+  static const std::size_t ALIGNMENT = 16;
+  static const std::size_t SLOT_SIZE =
+      (sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+  std::vector<char *> m_blocks;
+  // Slots of the last block handed out so far.
+  int m_blockSlots = BLOCK_SIZE;
+  FreeSlot *m_freeSlots = nullptr;
+  std::mutex m_mutex;
+
+public:
+  template <typename... Args> T *create(Args &&... args) {
+    return new (allocate()) T(std::forward<Args>(args)...);
+  }
+
+  void destroy(T *object) {
+    if (object == nullptr)
+      return;
+    object->~T();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FreeSlot *slot = reinterpret_cast<FreeSlot *>(object);
+    slot->next = m_freeSlots;
+    m_freeSlots = slot;
+  }
+
+private:
+  void *allocate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_freeSlots != nullptr) {
+      FreeSlot *slot = m_freeSlots;
+      m_freeSlots = slot->next;
+      return slot;
+    }
+
+    if (m_blockSlots == BLOCK_SIZE) {
+      m_blocks.push_back(static_cast<char *>(
+          btAlignedAlloc(SLOT_SIZE * BLOCK_SIZE, ALIGNMENT)));
+      m_blockSlots = 0;
+    }
+    return m_blocks.back() + SLOT_SIZE * m_blockSlots++;
+  }
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <LinearMath/btScalar.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TransformBuffer;
+
+// Transforms of the bodies after every physics step, in a memory mapped
+// binary log.
+// A frame lists only the bodies whose quantized transform or frozen flag
+// changed since the previous frame. Positions are quantized to
+// POSITION_QUANTUM, orientations to 16 bit per quaternion component, and both
+// are stored as variable length deltas from the previous quantized value, so
+// that the rounding never accumulates. Every KEYFRAME_INTERVAL frames a
+// keyframe lists all the bodies from scratch, to seek without decoding the
+// whole log.
+//
+// File layout, in the byte order of the machine:
+//   header: magic, version, slots number, steps per second, position quantum,
+//           frames number
+//   frame:  byte size, keyframe flag, entries up to the end of the frame
+//   entry:  slot delta << 1 | frozen, 3 position deltas, 4 orientation deltas
+class RecordingCodec {
+public:
+  static const uint32_t MAGIC = 0x43455244; // "DREC"
+  static const uint32_t VERSION = 1;
+  static const int KEYFRAME_INTERVAL = 256;
+  static const float POSITION_QUANTUM;
+  static const int ORIENTATION_SCALE = 32767;
+
+protected:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotsNumber;
+    float stepsPerSecond;
+    float positionQuantum;
+    uint32_t framesNumber;
+  };
+  static const std::size_t HEADER_SIZE = sizeof(Header);
+  // Frame size and keyframe flag.
+  static const std::size_t FRAME_HEADER_SIZE = 5;
+  // Eight varints of at most five bytes.
+  static const std::size_t MAX_ENTRY_SIZE = 40;
+
+  // Last quantized state of every slot: x, y, z then x, y, z, w.
+  std::vector<int32_t> m_positions;
+  std::vector<int16_t> m_orientations;
+  std::vector<bool> m_frozenFlags;
+  float m_positionQuantum = POSITION_QUANTUM;
+
+  void resetState(int slotsNumber);
+};
+
+// Appends a frame to the log after every step. Only meant for the thread
+// stepping the physics.
+class Recorder : public RecordingCodec {
+public:
+  Recorder(const std::string &fileName, float stepsPerSecond);
+  ~Recorder();
+
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+private:
+  int m_fileDescriptor = -1;
+  uint8_t *m_data = nullptr;
+  std::size_t m_capacity = 0;
+  std::size_t m_size = 0;
+  float m_stepsPerSecond;
+  unsigned int m_framesNumber = 0;
+  std::vector<int> m_slots;
+
+public:
+  // Record the dirty slots of the transforms, or all of them on keyframes.
+  // The first frame is always a keyframe. False, recording nothing, once the
+  // transforms no longer have the slots number of the first frame.
+  bool recordFrame(const TransformBuffer &transforms);
+  // Trim the file to its content and write the frames number.
+  void close();
+
+  inline unsigned int getFramesNumber() const { return m_framesNumber; }
+  inline std::size_t getSize() const { return m_size; }
+
+private:
+  void writeHeader();
+  void reserve(std::size_t size);
+  void writeVarint(uint32_t value);
+  void writeEntry(int slot, int previousSlot, const int32_t *position,
+                  const int16_t *orientation, bool frozen);
+};
+
+// Reads a log back into a transform buffer, one frame at a time, and seeks
+// to any frame from the keyframe before it.
+class Player : public RecordingCodec {
+public:
+  Player(const std::string &fileName);
+  ~Player();
+
+  Player(const Player &) = delete;
+  Player &operator=(const Player &) = delete;
+
+private:
+  int m_fileDescriptor = -1;
+  const uint8_t *m_data = nullptr;
+  std::size_t m_size = 0;
+  Header m_header;
+  // Offset of every frame in the file.
+  std::vector<std::size_t> m_frameOffsets;
+  // Next frame to read.
+  int m_frame = 0;
+
+public:
+  inline int getSlotsNumber() const { return m_header.slotsNumber; }
+  inline float getStepsPerSecond() const { return m_header.stepsPerSecond; }
+  inline int getFramesNumber() const { return m_frameOffsets.size(); }
+  inline int getFrame() const { return m_frame; }
+  inline bool isOver() const { return m_frame >= getFramesNumber(); }
+
+  // Write the next frame into the transforms, only the slots it lists are
+  // set. Returns false past the last frame.
+  bool readFrame(TransformBuffer &transforms);
+  // Move to frame and set every slot of the transforms to it. The next
+  // readFrame reads the frame after it.
+  void seek(int frame, TransformBuffer &transforms);
+
+private:
+  void decodeFrame(int frame, TransformBuffer *transforms);
+  void writeSlot(int slot, TransformBuffer &transforms) const;
+};
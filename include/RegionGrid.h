@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Engine.h"
+#include "ThreadPool.h"
+
+#include <LinearMath/btScalar.h>
+#include <LinearMath/btVector3.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class btCollisionObject;
+class btDispatcher;
+class btRigidBody;
+
+// The world bounds split into a grid of columns along x by rows along z, each
+// cell simulated by an Engine of its own, all of them stepped in parallel.
+// A body belongs to the region its center is in, and moves over to the next
+// one when it crosses the border. Within overlap of a border, a body has a
+// ghost in the neighbouring regions: a copy with the same shape and mass,
+// which takes the state of the body before every step. Both sides of a
+// contact across a border are then solved in both regions, each region
+// keeping the result for its own body. Chains of contacts longer than the
+// overlap are cut at the border, so the overlap is best kept above the size
+// of the bodies.
+// Ghosts are bodies without motion state, their user pointer is the body they
+// copy. They take its collision filter too.
+class RegionGrid {
+public:
+  static const btScalar DEFAULT_OVERLAP;
+
+public:
+  // The engines follow the settings of engine, one thread each: the threads
+  // step regions instead.
+  RegionGrid(const Engine &settings, int columns, int rows, btScalar overlap,
+             int threadsNumber);
+  ~RegionGrid();
+
+  RegionGrid(const RegionGrid &) = delete;
+  RegionGrid &operator=(const RegionGrid &) = delete;
+
+private:
+  struct Ghost {
+    int region;
+    btRigidBody *body;
+  };
+
+  struct Body {
+    btRigidBody *body;
+    // Bounding sphere, to find the regions within overlap.
+    btScalar radius;
+    int region;
+    // Dynamic for Bullet, frozen or not.
+    bool dynamic;
+    CollisionFilter filter;
+    std::vector<Ghost> ghosts;
+  };
+
+  int m_columns;
+  int m_rows;
+  btScalar m_overlap;
+  btVector3 m_worldMin;
+  btScalar m_cellWidth;
+  btScalar m_cellDepth;
+  std::vector<std::unique_ptr<Engine>> m_engines;
+  std::vector<Body> m_bodies;
+  std::unordered_map<const btRigidBody *, int> m_bodyIndices;
+  ThreadPool m_threadPool;
+  std::vector<int> m_ghostRegions;
+  unsigned int m_handOffsNumber = 0;
+
+public:
+  inline int getRegionsNumber() const { return m_engines.size(); }
+  inline Engine &getEngine(int region) { return *m_engines[region]; }
+  inline const Engine &getEngine(int region) const {
+    return *m_engines[region];
+  }
+  inline int getThreadsNumber() const {
+    return m_threadPool.getThreadsNumber();
+  }
+
+  // Apply the solver, broadphase, iterations and gravity of settings to
+  // every region.
+  void configure(const Engine &settings);
+
+  // The bodies follow Engine::addRigidBody, dynamic even while frozen.
+  void addRigidBody(btRigidBody *rigidBody, const CollisionFilter &filter,
+                    bool dynamic);
+  void addRigidBodies(btRigidBody *const *rigidBodies,
+                      const CollisionFilter *filters, const bool *dynamic,
+                      int bodiesNumber);
+  // The bodies and their ghosts leave their regions in one batch per region.
+  void removeRigidBodies(btRigidBody *const *rigidBodies, int bodiesNumber);
+  // New filters for bodies of the grid and their ghosts, see
+  // Engine::setCollisionFilters.
+  void setCollisionFilters(btRigidBody *const *rigidBodies,
+                           const CollisionFilter *filters, int bodiesNumber);
+  // Sync the ghosts, step every region, then move the bodies that crossed a
+  // border and update their ghosts.
+  void stepSimulation(btScalar timeStep);
+  // Move every body to its region after their state was changed in place,
+  // with fresh contacts.
+  void resetBodies();
+
+  // Bodies Bullet has not put to sleep, ghosts left out.
+  int getActiveRigidBodiesNumber() const;
+  int getGhostsNumber() const;
+  // Sums over the regions, a contact or an island across a border counts in
+  // every region it reaches.
+  int getManifoldsNumber() const;
+  int getAwakeIslandsNumber() const;
+  inline unsigned int getHandOffsNumber() const { return m_handOffsNumber; }
+  // Highest of the solver iterations of the regions.
+  int getSolverIterations() const;
+  void getDispatchers(std::vector<btDispatcher *> &dispatchers) const;
+
+  // The body a ghost copies, the object itself for anything else.
+  static const btCollisionObject *getOwner(const btCollisionObject *object);
+
+private:
+  int findRegion(const btVector3 &position) const;
+  int findColumn(btScalar x) const;
+  int findRow(btScalar z) const;
+  void updateBody(Body &body);
+  void handOff(Body &body, int region);
+  void addToRegion(btRigidBody *rigidBody, int region, const Body &body);
+  void createGhost(Body &body, int region);
+  void destroyGhost(const Ghost &ghost);
+  static void syncGhost(const btRigidBody *owner, btRigidBody *ghost);
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+
+// Lock free single producer, single consumer bounded queue.
+// The head and the tail only ever grow, each side writes its own and reads
+// the other one, so neither of them ever waits. A push on a full queue is
+// dropped and counted rather than blocking the producer.
+template <typename T, int CAPACITY> class RingBuffer {
+  static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+                "The capacity must be a power of two");
+
+public:
+  RingBuffer() {}
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+private:
+  static const unsigned int INDEX_MASK = CAPACITY - 1;
+  static const int CACHE_LINE = 64;
+
+  T m_items[CAPACITY];
+  // Next item to pop, owned by the consumer.
+  std::atomic<unsigned int> m_head{0};
+  // Keeps the two sides from sharing a cache line.
+  char m_padding[CACHE_LINE];
+  // Next item to push, owned by the producer.
+  std::atomic<unsigned int> m_tail{0};
+  std::atomic<unsigned int> m_droppedNumber{0};
+
+public:
+  // Producer side. Returns false when the queue is full.
+  inline bool push(const T &item) {
+    const unsigned int tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == CAPACITY) {
+      m_droppedNumber.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    m_items[tail & INDEX_MASK] = item;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the queue is empty, item is left
+  // untouched in that case.
+  inline bool pop(T &item) {
+    const unsigned int head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+      return false;
+    item = m_items[head & INDEX_MASK];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Either side, only a hint while the other one is running.
+  inline int getSize() const {
+    return m_tail.load(std::memory_order_acquire) -
+           m_head.load(std::memory_order_acquire);
+  }
+  inline unsigned int getDroppedNumber() const {
+    return m_droppedNumber.load(std::memory_order_relaxed);
+  }
+};
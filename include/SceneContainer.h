@@ -13,6 +13,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 class Light;
 class Object;
@@ -30,6 +31,12 @@ public:
 //    world->addSpotLight(light);
 //  }
   inline void addObject(Object *object) { m_world->addObject(object); }
+  inline void addObjects(const std::vector<Object *> &objects,
+                         const std::string &shaderFile) {
+    auto &shaderObjects = m_shaderFileMap[shaderFile];
+    shaderObjects.insert(shaderObjects.end(), objects.begin(), objects.end());
+    m_world->addObjects(objects);
+  }
   inline void addLightBulb(LightBulb *bulb) { m_world->addLightBulb(bulb); }
   inline void setMirror(Mirror *mirror) { 
     m_world->setMirror(mirror); 
@@ -38,6 +45,54 @@ public:
   inline void setGravity(const btVector3 &gravity) {
     m_world->setGravity(gravity);
   }
+  inline void setPhysicsThreads(int threadsNumber) {
+    m_world->setPhysicsThreadsNumber(threadsNumber);
+  }
+  inline void setPhysicsSolver(SolverType solverType) {
+    m_world->setPhysicsSolver(solverType);
+  }
+  inline void setSolverIterations(int minIterations, int maxIterations,
+                                  double stepBudget) {
+    m_world->setSolverIterations(minIterations, maxIterations, stepBudget);
+  }
+  inline void setPhysicsBroadphase(BroadphaseType broadphaseType) {
+    m_world->setPhysicsBroadphase(broadphaseType);
+  }
+  inline void setWorldBounds(const btVector3 &worldMin,
+                             const btVector3 &worldMax) {
+    m_world->setWorldBounds(worldMin, worldMax);
+  }
+  inline void setPhysicsRate(float stepsPerSecond, int maxSubsteps) {
+    m_world->setStepsPerSecond(stepsPerSecond);
+    m_world->setMaxSubsteps(maxSubsteps);
+  }
+
+  inline void setSettleTime(float settleTime) {
+    m_world->setSettleTime(settleTime);
+  }
+  inline void setContactEvents(bool enabled) {
+    m_world->setContactEvents(enabled);
+  }
+  inline void setPhysicsProfile(bool enabled, const std::string &csvFile) {
+    m_world->setProfiling(enabled, csvFile);
+  }
+  inline void setPhysicsRegions(int columns, int rows, float overlap) {
+    m_world->setRegions(columns, rows, overlap);
+  }
+  inline void setCollisionLayer(const std::string &name,
+                                const std::vector<std::string> &layers) {
+    m_world->setCollisionLayer(name, layers);
+  }
+  inline int findCollisionLayer(const std::string &name) const {
+    return m_world->getCollisionLayers().findLayer(name);
+  }
+
+  inline void recordSimulation(const std::string &fileName) {
+    m_world->startRecording(fileName);
+  }
+  inline void playRecording(const std::string &fileName) {
+    m_world->startPlayback(fileName);
+  }
 
   // Camera setup.
   inline void setCamera(const glm::vec4 position, const glm::vec2 orientation,
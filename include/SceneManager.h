@@ -5,6 +5,7 @@
 #include "SceneContainer.h"
 #include "ShaderProgram.h"
 #include "ShadowManager.h"
+#include "SimulationThread.h"
 #include "TextManager.h"
 #include "World.h"
 
@@ -43,7 +44,12 @@ public:
   int getLightMask() const;
   void updateLightMask(int lightMask);
 
-  void stepSimulation();
+  void startSimulation();
+  void stopSimulation();
+  // Jump through the recording being played back, if any.
+  void skipPlayback(int seconds);
+  // Put the world back as it was when the simulation started.
+  void resetWorld();
 
 private:
   void initGPU(SceneContainer *container);
@@ -54,6 +60,7 @@ private:
   void drawShadowWorld(const glm::mat4 &modelView, const glm::mat4 &projection,
                        ShaderProgram &shader);
   void drawText();
+  void drainContactEvents();
   void mirrorRenderingPass();
   void noMirrorRenderingPass();
   void shadowRenderingPass();
@@ -62,6 +69,7 @@ private:
 private:
   World* m_world = nullptr;
   Camera* m_camera = nullptr;
+  SimulationThread m_simulation;
 
   #ifndef WINDOWS
   TextManager m_textManager;
@@ -81,4 +89,10 @@ private:
 
   int m_fps = 0;
   int m_lightMask = 0;
+
+  // Contacts begun so far, from the events drained once per frame.
+  unsigned int m_contactHits = 0;
+  // Average of the physics steps since the last frame.
+  StepProfile m_stepProfile;
+  bool m_hasStepProfile = false;
 };
@@ -21,6 +21,7 @@ class World;
 // Support functions.
 // -----------------------------------------------------------------------------
 int addBox(lua_State *luaState);
+int addDominoes(lua_State *luaState);
 int addDirectionalLight(lua_State *luaState);
 int addMesh(lua_State *luaState);
 int addPlane(lua_State *luaState);
@@ -32,6 +33,19 @@ int addSpotLight(lua_State *luaState);
 int setBackgroundColor(lua_State *luaState);
 int setCamera(lua_State *luaState);
 int setGravity(lua_State *luaState);
+int setPhysicsRate(lua_State *luaState);
+int setPhysicsSolver(lua_State *luaState);
+int setSolverIterations(lua_State *luaState);
+int setPhysicsBroadphase(lua_State *luaState);
+int setWorldBounds(lua_State *luaState);
+int setPhysicsThreads(lua_State *luaState);
+int setSettleTime(lua_State *luaState);
+int setContactEvents(lua_State *luaState);
+int setPhysicsProfile(lua_State *luaState);
+int setPhysicsRegions(lua_State *luaState);
+int setCollisionLayer(lua_State *luaState);
+int recordSimulation(lua_State *luaState);
+int playRecording(lua_State *luaState);
 
 // ============================================================================= 
 class LuaState {
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <LinearMath/btScalar.h>
+#include <LinearMath/btVector3.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+class btCollisionShape;
+struct TriangleMesh;
+
+// Collision shapes shared by all the objects with the same geometry: boxes
+// with the same sides, planes with the same side, spheres with the same
+// radius, meshes from the same file fitted with the same tolerance and
+// triangle meshes from the same file. Every acquire has to be matched by a
+// release, the last release deletes the shape.
+class ShapeCache {
+public:
+  // Most vertices of a mesh hull, GJK queries a support point by scanning
+  // them all.
+  static const int MAX_HULL_VERTICES = 48;
+
+public:
+  static ShapeCache &getInstance();
+
+  ShapeCache(const ShapeCache &) = delete;
+  ShapeCache &operator=(const ShapeCache &) = delete;
+
+private:
+  ShapeCache() {}
+  ~ShapeCache();
+
+private:
+  enum class ShapeKind { skBox, skPlane, skSphere, skMesh, skTriangleMesh };
+  typedef std::tuple<ShapeKind, btScalar, btScalar, btScalar, std::string>
+      ShapeKey;
+
+  struct CachedShape {
+    btCollisionShape *shape = nullptr;
+    int references = 0;
+    // The triangles a triangle mesh shape points into.
+    std::shared_ptr<TriangleMesh> triangleMesh;
+  };
+
+  std::map<ShapeKey, CachedShape> m_shapes;
+  std::unordered_map<const btCollisionShape *, ShapeKey> m_shapeKeys;
+  mutable std::mutex m_mutex;
+
+public:
+  btCollisionShape *acquireBox(const btVector3 &halfSides);
+  btCollisionShape *acquireSphere(btScalar radius);
+  // A square of the side, as a box as thin as the collision margin.
+  btCollisionShape *acquirePlane(btScalar side);
+  // The shape is built from the points only the first time, the key alone
+  // tells whether two of them are the same. The points get the primitive
+  // ShapeFitter finds within the tolerance, a hull when there is none. Hulls
+  // are simplified to MAX_HULL_VERTICES, and cached in a .hull file next to
+  // the mesh.
+  btCollisionShape *acquireMesh(const std::string &meshFile,
+                                const float *points, int pointsNumber,
+                                btScalar tolerance);
+  // The triangles of the mesh themselves, for static meshes only: Bullet
+  // cannot move a concave shape. Contacts are found through a quantized
+  // bounding volume tree over the triangles, cached in a .bvh file next to
+  // the mesh and read back in place.
+  btCollisionShape *acquireTriangleMesh(const std::string &meshFile,
+                                        const float *points, int pointsNumber,
+                                        const unsigned int *indices,
+                                        int indicesNumber);
+  void release(btCollisionShape *shape);
+
+  // Distinct shapes alive.
+  int getShapesNumber() const;
+
+private:
+  btCollisionShape *acquire(const ShapeKey &key, const float *points,
+                            int pointsNumber,
+                            const unsigned int *indices = nullptr,
+                            int indicesNumber = 0);
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <LinearMath/btScalar.h>
+#include <LinearMath/btVector3.h>
+
+#include <vector>
+
+class btCollisionShape;
+
+// Fits a primitive to the points of a mesh: a sphere, a box, or a capsule or
+// a cylinder along one of the axes. Each of them bounds the points, and is as
+// far from their hull as the largest difference of the two supports over a
+// set of directions. The closest primitive within the tolerance wins, the
+// cheaper one on a tie, in the order above. The tolerance is a fraction of
+// the largest half side of the bounding box of the points. The primitives
+// share the center of the box, one off the origin of the mesh goes into a
+// compound shape.
+class ShapeFitter {
+public:
+  static const btScalar DEFAULT_TOLERANCE;
+  // Directions the primitives are compared along, besides the axes.
+  static const int DIRECTIONS_NUMBER = 256;
+
+public:
+  ShapeFitter(const std::vector<btVector3> &points,
+              btScalar tolerance = DEFAULT_TOLERANCE);
+
+private:
+  btVector3 m_center;
+  btVector3 m_halfSides;
+  btScalar m_tolerance;
+  // Largest distance of the points from each axis through the center.
+  btVector3 m_axisRadii;
+  btScalar m_radius;
+  std::vector<btVector3> m_directions;
+  // Support of the points about the center along every direction.
+  std::vector<btScalar> m_supports;
+
+public:
+  // A new shape, or nullptr when no primitive fits and the hull is best.
+  btCollisionShape *createShape() const;
+
+private:
+  enum class PrimitiveType { ptSphere, ptBox, ptCapsule, ptCylinder };
+
+  btCollisionShape *createPrimitive() const;
+  btCollisionShape *createPrimitive(PrimitiveType type, int axis) const;
+  btVector3 getBoxHalfSides() const;
+  btScalar getCylinderRadius(int axis) const;
+  btScalar getCylinderHalfLength(int axis) const;
+  // Largest difference between the supports of the primitive and the points.
+  template <typename Support>
+  btScalar getDistance(const Support &support) const;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+
+#include <cstdint>
+#include <vector>
+
+// Sequential impulses with the contact and friction rows regrouped into
+// packets of rows that touch no dynamic body twice, stored as structures of
+// arrays and solved a packet at a time: 8 rows per instruction with AVX when
+// the build enables it, 4 with SSE otherwise. Every row goes to the first
+// open packet it fits in, so rows are solved in about the order of
+// btSequentialImpulseConstraintSolver, and the rows of a packet, being
+// independent, give the same impulses as if solved one after the other. The
+// scalar kernel solves the same packets a row at a time, it is the only one
+// in double precision builds or without SSE.
+// Joints and split impulses are left to the base solver, as is the whole
+// solve in the solver modes that randomize or interleave the rows and for
+// contacts with rolling friction.
+class SimdContactSolver : public btSequentialImpulseConstraintSolver {
+public:
+#if defined(__AVX__) && !defined(BT_USE_DOUBLE_PRECISION)
+  static const int ROWS_PER_PACKET = 8;
+#else
+  static const int ROWS_PER_PACKET = 4;
+#endif
+  // Packets being filled at once, one bit each in a body mask.
+  static const int OPEN_PACKETS = 64;
+
+  enum class Kernel { kScalar, kSimd };
+
+public:
+  // Without a SIMD kernel in the build, the scalar one is used.
+  explicit SimdContactSolver(Kernel kernel = Kernel::kSimd);
+
+private:
+  struct RowPacket {
+    // Jacobian of the rows on each body.
+    btScalar normalA[3][ROWS_PER_PACKET];
+    btScalar torqueA[3][ROWS_PER_PACKET];
+    btScalar normalB[3][ROWS_PER_PACKET];
+    btScalar torqueB[3][ROWS_PER_PACKET];
+    // Velocity change of each body per unit of impulse.
+    btScalar linearA[3][ROWS_PER_PACKET];
+    btScalar angularA[3][ROWS_PER_PACKET];
+    btScalar linearB[3][ROWS_PER_PACKET];
+    btScalar angularB[3][ROWS_PER_PACKET];
+    btScalar rhs[ROWS_PER_PACKET];
+    btScalar cfm[ROWS_PER_PACKET];
+    btScalar jacobianInverse[ROWS_PER_PACKET];
+    // Lower limit of a contact row, friction coefficient of a friction one.
+    btScalar limit[ROWS_PER_PACKET];
+    btScalar appliedImpulse[ROWS_PER_PACKET];
+    // Solver bodies, -1 for bodies impulses do not move. Empty lanes have
+    // no body and all zeros, they solve to no impulse.
+    int bodyA[ROWS_PER_PACKET];
+    int bodyB[ROWS_PER_PACKET];
+    // Rows in the pool, and for friction rows the slot of their contact row.
+    int rows[ROWS_PER_PACKET];
+    int contactSlots[ROWS_PER_PACKET];
+    int rowsNumber;
+  };
+
+  Kernel m_kernel;
+  bool m_packed = false;
+  btAlignedObjectArray<RowPacket> m_contactPackets;
+  btAlignedObjectArray<RowPacket> m_frictionPackets;
+  // Every solver body as the packets see it, see getPackedBody.
+  std::vector<int> m_packedBodies;
+  // Packet times ROWS_PER_PACKET plus lane of every contact row.
+  std::vector<int> m_contactSlots;
+  // The open packets every body is in, a bit per packet slot.
+  std::vector<std::uint64_t> m_bodyPackets;
+
+public:
+  inline Kernel getKernel() const { return m_kernel; }
+  // "avx" or "sse", "scalar" for builds without a SIMD kernel.
+  static const char *getSimdName();
+  static bool hasSimdKernel();
+
+protected:
+  virtual btScalar solveGroupCacheFriendlySetup(
+      btCollisionObject **bodies, int bodiesNumber,
+      btPersistentManifold **manifolds, int manifoldsNumber,
+      btTypedConstraint **constraints, int constraintsNumber,
+      const btContactSolverInfo &solverInfo,
+      btIDebugDraw *debugDrawer) override;
+  virtual btScalar solveSingleIteration(
+      int iteration, btCollisionObject **bodies, int bodiesNumber,
+      btPersistentManifold **manifolds, int manifoldsNumber,
+      btTypedConstraint **constraints, int constraintsNumber,
+      const btContactSolverInfo &solverInfo,
+      btIDebugDraw *debugDrawer) override;
+  virtual btScalar
+  solveGroupCacheFriendlyFinish(btCollisionObject **bodies, int bodiesNumber,
+                                const btContactSolverInfo &solverInfo) override;
+
+private:
+  void packRows(const btConstraintArray &rows,
+                const btAlignedObjectArray<int> &order, bool friction,
+                btAlignedObjectArray<RowPacket> &packets);
+  // Returns the lane of the row.
+  int addRow(RowPacket &packet, int row, const btSolverConstraint &constraint,
+             int bodyA, int bodyB, bool friction);
+  int getPackedBody(int solverBody) const;
+  void closePacket(const RowPacket &packet, int slot);
+  void unpackRows(const btAlignedObjectArray<RowPacket> &packets,
+                  btConstraintArray &rows) const;
+  void solvePackets(btAlignedObjectArray<RowPacket> &packets, bool friction);
+  void solvePacketScalar(RowPacket &packet, bool friction);
+  void solvePacketSimd(RowPacket &packet, bool friction);
+};
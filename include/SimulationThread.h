@@ -0,0 +1,88 @@
+#pragma once
+
+#include "TransformBuffer.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+class Object;
+class World;
+
+// Transforms of every object after a batch of simulation steps. The dirty
+// slots are the objects moved by that batch alone.
+struct SimulationFrame {
+  typedef std::chrono::steady_clock Clock;
+
+  TransformBuffer transforms;
+  // Layout of the world the slots belong to, see World::getLayoutVersion(),
+  // and the object of every slot in it.
+  unsigned int layoutVersion = 0;
+  std::vector<Object *> objects;
+  unsigned int sequence = 0;
+  Clock::time_point time;
+};
+
+// Steps the physics of a world on its own thread, at the fixed rate of the
+// world, and publishes a complete frame after every batch of steps. The
+// renderer picks up the frames with syncWorld() and never waits for the
+// simulation, nor the other way around.
+// Once started, only this thread touches the physics engine, and only the
+// thread calling syncWorld() touches the objects. That thread may add and
+// remove objects, the world queues them for the next batch of steps and the
+// frames published before are then skipped.
+class SimulationThread {
+public:
+  typedef SimulationFrame::Clock Clock;
+  // Batches whose dirty slots are kept to bring a frame up to date. A frame
+  // older than that is copied whole.
+  static const int DIRTY_HISTORY = 8;
+
+  SimulationThread(World *world);
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+private:
+  World *m_world;
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  TripleBuffer<SimulationFrame> m_frames;
+
+  // Written by the simulation thread only. The dirty slots of the batch of
+  // every sequence are at sequence % DIRTY_HISTORY.
+  unsigned int m_sequence = 0;
+  unsigned int m_firstSequence = 1;
+  std::vector<int> m_dirtyHistory[DIRTY_HISTORY];
+  std::vector<int> m_changedSlots;
+
+  // Renderer side only. The objects are drawn between the previous frame and
+  // the read one, the interpolation lags one frame behind the simulation.
+  // The previous transforms follow the frames one after the other, only the
+  // slots each frame moved are copied.
+  TransformBuffer m_previousTransforms;
+  unsigned int m_previousSequence = 0;
+  unsigned int m_previousLayout = 0;
+  Clock::time_point m_previousTime;
+  unsigned int m_syncedSequence = 0;
+  bool m_allSlotsMoved = true;
+  // Set once the objects reached the read frame.
+  bool m_landed = true;
+
+public:
+  void start();
+  void stop();
+
+  // Move the objects of the world to the current time, between the last two
+  // published frames.
+  void syncWorld();
+
+private:
+  void simulationLoop();
+  void publishFrame(Clock::time_point time);
+  bool pickUpFrame();
+  void updatePreviousTransforms(const SimulationFrame &frame);
+};
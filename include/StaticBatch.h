@@ -0,0 +1,68 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <unordered_map>
+#include <vector>
+
+class Object;
+class ShaderProgram;
+
+// Frozen objects sharing a texture and a material, drawn without any per
+// object state. Their vertices are moved to world space once and packed in
+// chunks of at most CHUNK_OBJECTS objects, one draw call each. Adding or
+// removing an object only rebuilds its own chunk.
+class StaticBatch {
+public:
+  static const int CHUNK_OBJECTS = 1024;
+
+public:
+  StaticBatch(const Object *material, GLuint texture,
+              const ShaderProgram &shader);
+  ~StaticBatch();
+
+  StaticBatch(const StaticBatch &) = delete;
+  StaticBatch &operator=(const StaticBatch &) = delete;
+
+private:
+  struct Chunk {
+    std::vector<const Object *> objects;
+    GLuint vaoId = 0;
+    // Vertices, normals, texture coordinates and indices.
+    GLuint vboIds[4] = {0, 0, 0, 0};
+    int indicesNumber = 0;
+    bool dirty = false;
+  };
+
+  const Object *m_material;
+  GLuint m_texture;
+  const ShaderProgram &m_shader;
+  std::vector<Chunk> m_chunks;
+  // Chunks with room for another object.
+  std::vector<int> m_freeChunks;
+  // Chunk holding each object of the batch.
+  std::unordered_map<const Object *, int> m_objectChunks;
+
+public:
+  // Same texture and same material as the batch.
+  bool accepts(const Object *object, GLuint texture) const;
+
+  inline const Object *getMaterial() const { return m_material; }
+  inline GLuint getTexture() const { return m_texture; }
+  inline bool contains(const Object *object) const {
+    return m_objectChunks.count(object) != 0;
+  }
+  inline bool isEmpty() const { return m_objectChunks.empty(); }
+
+  // The geometry is taken from the object transform when the chunk is
+  // rebuilt, by the next update(). The material passes to another object of
+  // the batch when its own object leaves.
+  void add(const Object *object);
+  void remove(const Object *object);
+  void update();
+
+  void draw() const;
+
+private:
+  void rebuildChunk(Chunk &chunk);
+};
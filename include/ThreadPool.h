@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers running batches of indexed tasks.
+// Every worker owns a queue and steals from the others once its own queue is
+// empty. The thread calling run() works as worker 0.
+class ThreadPool {
+public:
+  typedef std::function<void(int task, int worker)> TaskFunction;
+
+  ThreadPool(int threadsNumber);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+private:
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+
+  std::vector<std::thread> m_threads;
+  std::vector<std::unique_ptr<TaskQueue>> m_queues;
+  const TaskFunction *m_function = nullptr;
+  std::atomic<int> m_pendingTasks{0};
+  std::mutex m_mutex;
+  std::condition_variable m_startCondition;
+  std::condition_variable m_doneCondition;
+  unsigned int m_generation = 0;
+  bool m_stop = false;
+
+public:
+  inline int getThreadsNumber() const { return m_queues.size(); }
+
+  // Run function on every task in [0, tasksNumber) and wait for all of them.
+  // Tasks are dealt round robin, so put the most expensive ones first.
+  void run(int tasksNumber, const TaskFunction &function);
+
+private:
+  void workerLoop(int worker);
+  bool popTask(int worker, int &task);
+  void runTask(int task, int worker);
+};
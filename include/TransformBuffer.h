@@ -0,0 +1,64 @@
+#pragma once
+
+#include <LinearMath/btScalar.h>
+#include <LinearMath/btTransform.h>
+
+#include <vector>
+
+// Structure of arrays holding the world transform of every body.
+// Each component lives in its own contiguous array, so that a reader can
+// stream positions and orientations directly. Slots written since the last
+// clearDirtySlots() are listed once in the dirty list. Every slot also tells
+// whether its body has been frozen into a static one.
+class TransformBuffer {
+public:
+  TransformBuffer();
+
+private:
+  std::vector<btScalar> m_positions[3];
+  std::vector<btScalar> m_orientations[4];
+  std::vector<int> m_dirtySlots;
+  std::vector<bool> m_dirtyFlags;
+  std::vector<bool> m_frozenFlags;
+
+public:
+  int addSlot(const btTransform &transform);
+  void reserve(int slotsNumber);
+  // The last slot takes the place of slot, which is marked dirty. The dirty
+  // list keeps the slots past the end until pruneDirtySlots(), so that many
+  // slots go in a single pass over it.
+  void removeSlot(int slot);
+  void pruneDirtySlots();
+
+  void setTransform(int slot, const btTransform &transform);
+  btTransform getTransform(int slot) const;
+  void getOpenGLMatrix(int slot, btScalar *matrix) const;
+
+  inline int getSize() const { return m_dirtyFlags.size(); }
+
+  // Component 0, 1, 2 are x, y, z. Orientations are quaternions, w is 3.
+  inline const btScalar *getPositions(int component) const {
+    return m_positions[component].data();
+  }
+  inline const btScalar *getOrientations(int component) const {
+    return m_orientations[component].data();
+  }
+
+  // Changing the frozen flag marks the slot dirty.
+  inline bool isFrozen(int slot) const { return m_frozenFlags[slot]; }
+  void setFrozen(int slot, bool frozen);
+
+  inline const std::vector<int> &getDirtySlots() const { return m_dirtySlots; }
+  inline bool isDirty(int slot) const { return m_dirtyFlags[slot]; }
+  void clearDirtySlots();
+
+  // Copy slots of source, a buffer with the same slots, leaving the dirty
+  // slots alone.
+  void copySlots(const TransformBuffer &source, const std::vector<int> &slots);
+  // Copy the dirty slots of source, a buffer with the same slots, which
+  // become the dirty slots of this one.
+  void copyDirtySlots(const TransformBuffer &source);
+
+private:
+  void markDirty(int slot);
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+// Lock free single producer, single consumer triple buffer.
+// The writer fills the write buffer and publishes it, the reader picks up the
+// last published buffer. Both sides only swap their own buffer with the
+// middle one, so neither of them ever waits for the other and the reader
+// always sees a complete buffer.
+template <typename T> class TripleBuffer {
+public:
+  TripleBuffer() {}
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+private:
+  // Set on the middle index when it holds a buffer the reader has not seen.
+  static const int FRESH_BIT = 4;
+  static const int INDEX_MASK = 3;
+
+  T m_buffers[3];
+  std::atomic<int> m_middle{1};
+  // Owned by the writer.
+  int m_write = 0;
+  // Owned by the reader.
+  int m_read = 2;
+
+public:
+  // Writer side.
+  inline T &getWriteBuffer() { return m_buffers[m_write]; }
+  inline void publish() {
+    m_write = m_middle.exchange(m_write | FRESH_BIT, std::memory_order_acq_rel) &
+              INDEX_MASK;
+  }
+
+  // Reader side. Only the reader clears the fresh bit, so a fresh buffer stays
+  // fresh until the next update.
+  inline bool isFresh() const {
+    return m_middle.load(std::memory_order_relaxed) & FRESH_BIT;
+  }
+  // Take the last published buffer. Returns false when nothing was published
+  // since the last update, the read buffer is left untouched in that case.
+  inline bool update() {
+    if (!isFresh())
+      return false;
+    m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+  inline const T &getReadBuffer() const { return m_buffers[m_read]; }
+};
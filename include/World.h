@@ -1,12 +1,24 @@
 #pragma once
 
+#include "CollisionLayers.h"
+#include "ContactEvents.h"
 #include "Engine.h"
+#include "PhysicsProfiler.h"
+#include "Recording.h"
+#include "RegionGrid.h"
+#include "TransformBuffer.h"
 
+#include <LinearMath/btAlignedObjectArray.h>
+#include <LinearMath/btTransform.h>
 #include <LinearMath/btVector3.h>
 
 #include <glm/vec4.hpp>
 
+#include <atomic>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 class Light;
@@ -17,6 +29,9 @@ class Mirror;
 class Object;
 
 class World {
+public:
+  static const float DEFAULT_SETTLE_TIME;
+
 public:
   World();
   ~World();
@@ -27,20 +42,246 @@ private:
   std::vector<Light*> m_lights;
   std::vector<LightBulb*> m_bulbs;
   Mirror* m_mirror = nullptr;
+  // Slot i holds the transform of m_objects[i].
+  TransformBuffer m_transforms;
   Engine m_engine;
-  static const float STEPS_PER_SECOND;
-  static const int MAX_STEPS = 8;
+  float m_stepsPerSecond = DEFAULT_STEPS_PER_SECOND;
+  int m_maxSubsteps = DEFAULT_MAX_SUBSTEPS;
+  unsigned int m_stepsNumber = 0;
+
+  // Settle detection, simulation side. The dynamic slots are the bodies not
+  // frozen yet, m_dynamicIndices[slot] is their position in the list or -1.
+  float m_settleTime = DEFAULT_SETTLE_TIME;
+  std::vector<int> m_dynamicSlots;
+  std::vector<int> m_dynamicIndices;
+  // Step from which each body has been sleeping.
+  std::vector<unsigned int> m_sleepingSince;
+  std::vector<int> m_pendingSlots;
+  int m_frozenNumber = 0;
+  // Slots frozen or thawed since their collision filter was last updated.
+  std::vector<int> m_filterSlots;
+
+  // Objects whose frozen flag the sync changed, until taken.
+  std::vector<const Object *> m_frozenChanges;
+
+  // While playing back, the steps read the recording and leave the engine
+  // alone. The skip is requested by any thread, taken by the next step.
+  std::unique_ptr<Recorder> m_recorder;
+  std::unique_ptr<Player> m_player;
+  std::atomic<int> m_playbackSkip{0};
+
+  // Rigid body state of every slot, saved by snapshot().
+  struct BodyState {
+    btTransform transform;
+    btVector3 linearVelocity;
+    btVector3 angularVelocity;
+    btScalar deactivationTime;
+    int activationState;
+    bool frozen;
+  };
+  btAlignedObjectArray<BodyState> m_snapshot;
+  std::vector<unsigned int> m_snapshotSleepingSince;
+  unsigned int m_snapshotStepsNumber = 0;
+  std::atomic<bool> m_restoreRequested{false};
+
+  // Fed after every step while enabled.
+  std::unique_ptr<ContactEventStream> m_contactEvents;
+  std::unique_ptr<PhysicsProfiler> m_profiler;
+
+  // With more than one region the bodies live in the grid, m_engine only
+  // keeps the settings.
+  std::unique_ptr<RegionGrid> m_regions;
+  int m_regionColumns = 1;
+  int m_regionRows = 1;
+  btScalar m_regionOverlap = RegionGrid::DEFAULT_OVERLAP;
+  std::vector<btDispatcher *> m_dispatchers;
+
+  CollisionLayers m_collisionLayers;
+
+  // Objects to add or remove, queued by the thread drawing them while the
+  // physics steps on a thread of its own. The steps take the queue in before
+  // stepping, the mutex is only held to swap it, and to hand the objects
+  // removed back for deletion.
+  struct LayoutChange {
+    std::vector<Object *> objects;
+    bool removal;
+  };
+  bool m_layoutQueued = false;
+  std::mutex m_layoutMutex;
+  std::vector<LayoutChange> m_layoutChanges;
+  std::vector<LayoutChange> m_appliedChanges;
+  std::vector<Object *> m_removedObjects;
+  // Bumped whenever objects are added or removed, slots may have moved.
+  std::atomic<unsigned int> m_layoutVersion{0};
+
+  static const float DEFAULT_STEPS_PER_SECOND;
+  static const int DEFAULT_MAX_SUBSTEPS = 8;
 
 public:
+  // The changes to the objects are made right away, or by the next step
+  // while the layout is queued. Either way they are meant for a single
+  // thread, the one syncing the objects, not while recording or playing back.
   void addObject(Object *object);
+  // Add many objects at once, the world makes room for all of them first and
+  // the engine takes their bodies in bulk. Much faster than one at a time
+  // for large layouts.
+  void addObjects(const std::vector<Object *> &objects);
   void addLightBulb(LightBulb *lightBulb);
+  // Take the objects out of the world and delete them, light bulbs included.
+  // The last object takes the slot of every object removed, so that a
+  // removal costs the same however many objects the world holds; the
+  // broadphase drops all their pairs in one pass. While the layout is
+  // queued, the objects are deleted by deleteRemovedObjects once out.
+  void removeObject(Object *object);
+  void removeObjects(const std::vector<Object *> &objects);
+  // Queue the changes to the objects for the steps to take in, while the
+  // physics steps on a thread of its own. Unqueuing makes the changes left.
+  void setLayoutQueued(bool queued);
+  // Delete the objects the steps took out of the world, call it before
+  // syncing the objects.
+  void deleteRemovedObjects();
   void addDirectionalLight(DirectionalLight *light);
+  // Step the physics once and sync the objects, on the calling thread.
   void stepSimulation();
+  // Step the physics by steps fixed time steps, the objects are left
+  // untouched. The moved bodies are the dirty slots of getTransforms().
+  void stepPhysics(int steps);
+  // Copy the transforms into the objects and the light bulbs. Only the dirty
+  // slots are copied unless allSlots is set.
+  void syncObjects(const TransformBuffer &transforms, bool allSlots = false);
+  // Same as syncObjects, blending between two frames: 0 is previous, 1 is
+  // current. The objects are the ones of each slot when the frames were
+  // copied, see getObjects().
+  void interpolateObjects(const std::vector<Object *> &objects,
+                          const TransformBuffer &previous,
+                          const TransformBuffer &current, btScalar alpha,
+                          bool allSlots = false);
+
+  // Fixed rate of the physics steps.
+  inline float getStepsPerSecond() const { return m_stepsPerSecond; }
+  void setStepsPerSecond(float stepsPerSecond);
+  inline btScalar getTimeStep() const { return 1 / m_stepsPerSecond; }
+
+  // Most steps taken at once to catch up with the wall clock. Beyond this the
+  // simulation runs slower than real time instead of falling behind.
+  inline int getMaxSubsteps() const { return m_maxSubsteps; }
+  void setMaxSubsteps(int maxSubsteps);
+
+  // Seconds a body has to sleep before it is frozen into a static body, 0
+  // never freezes. Frozen bodies are not paired with each other nor with the
+  // static ones, and turn dynamic again as soon as an awake body touches
+  // them.
+  inline float getSettleTime() const { return m_settleTime; }
+  void setSettleTime(float settleTime);
+  inline int getFrozenObjectsNumber() const { return m_frozenNumber; }
+
+  // Record the transforms after every step into fileName, from the next
+  // step on. The first frame is the world before that step.
+  void startRecording(const std::string &fileName);
+  void stopRecording();
+  inline const Recorder *getRecorder() const { return m_recorder.get(); }
+
+  // Drive the transforms from a recording of this same world instead of the
+  // physics, at the rate it was recorded at. The playback stops on the last
+  // frame.
+  void startPlayback(const std::string &fileName);
+  inline bool isPlayingBack() const { return m_player != nullptr; }
+  inline const Player *getPlayer() const { return m_player.get(); }
+  // Jump by steps frames of the recording, backwards when negative. Safe
+  // from any thread.
+  inline void skipPlayback(int steps) { m_playbackSkip += steps; }
+
+  // Save the state of every rigid body: transform, velocities, activation
+  // and frozen flag. restore() puts it back in place, the shapes, the objects
+  // and their GPU buffers are left alone. Both touch the engine, call them
+  // from the thread stepping the physics, or before it starts.
+  void snapshot();
+  void restore();
+  inline bool hasSnapshot() const { return m_snapshot.size() > 0; }
+  // Restore the snapshot before the next step, safe from any thread. A
+  // playback goes back to its first frame instead.
+  inline void requestRestore() { m_restoreRequested = true; }
+
+  // Queue a begin and an end event whenever two bodies start and stop
+  // touching. Scanning the manifolds costs every step, the stream is off
+  // until enabled. Switch it before the physics starts stepping; a playback
+  // has no contacts. The stream starts over from the contacts after the first
+  // step, and again after a restore.
+  void setContactEvents(bool enabled);
+  inline bool hasContactEvents() const { return m_contactEvents != nullptr; }
+  // Take the oldest contact event, safe from one thread other than the one
+  // stepping the physics. Returns false when there is none.
+  inline bool popContactEvent(ContactEvent &event) {
+    return m_contactEvents && m_contactEvents->popEvent(event);
+  }
+  inline const ContactEventStream *getContactEvents() const {
+    return m_contactEvents.get();
+  }
+
+  // Time the stages of every step, see PhysicsProfiler, and write them to
+  // csvFile unless empty. Counting the active bodies and the islands costs a
+  // pass over the bodies per step, the profile is off until enabled. Switch
+  // it before the physics starts stepping.
+  void setProfiling(bool enabled, const std::string &csvFile = "");
+  inline bool isProfiling() const { return m_profiler != nullptr; }
+  // Average of the steps since the last call, safe from one thread other
+  // than the one stepping the physics. Returns false before the first step.
+  inline bool takeStepProfile(StepProfile &profile) {
+    return m_profiler && m_profiler->takeAverage(profile);
+  }
+
+  // Move into objects the objects syncObjects or interpolateObjects froze or
+  // thawed since the last call, once per change. Removed objects are left
+  // out.
+  void takeFrozenChanges(std::vector<const Object *> &objects);
 
   const btVector3& getGravity() const;
   void setGravity(const btVector3& gravity);
   void setGravity();
 
+  inline int getPhysicsThreadsNumber() const {
+    return m_engine.getThreadsNumber();
+  }
+  void setPhysicsThreadsNumber(int threadsNumber);
+
+  inline SolverType getPhysicsSolver() const {
+    return m_engine.getSolverType();
+  }
+  void setPhysicsSolver(SolverType solverType);
+
+  inline int getSolverIterations() const {
+    return m_regions ? m_regions->getSolverIterations()
+                     : m_engine.getSolverIterations();
+  }
+  // See Engine::setSolverIterations, the budget is in seconds.
+  void setSolverIterations(int minIterations, int maxIterations,
+                           double stepBudget);
+
+  inline BroadphaseType getPhysicsBroadphase() const {
+    return m_engine.getBroadphaseType();
+  }
+  void setPhysicsBroadphase(BroadphaseType broadphaseType);
+  // Hint for the sweep and prune broadphases, the box all the bodies are
+  // expected to stay in.
+  void setWorldBounds(const btVector3 &worldMin, const btVector3 &worldMax);
+
+  // Split the world bounds into columns along x by rows along z, each region
+  // stepped by its own engine on the physics threads. See RegionGrid. A
+  // single region is the plain engine. Set it up before the simulation
+  // starts, the bounds and the threads rebuild the grid.
+  void setRegions(int columns, int rows,
+                  btScalar overlap = RegionGrid::DEFAULT_OVERLAP);
+  inline const RegionGrid *getRegions() const { return m_regions.get(); }
+
+  // Create a collision layer or redefine it, see CollisionLayers::setLayer.
+  // The filters are taken when the objects are added: set the layers up
+  // before adding the objects in them.
+  void setCollisionLayer(const std::string &name,
+                         const std::vector<std::string> &collidingLayers);
+  inline const CollisionLayers &getCollisionLayers() const {
+    return m_collisionLayers;
+  }
+
   const glm::vec4 &getAmbientColor() const;
   void setAmbientColor(const glm::vec4 &color);
 
@@ -48,6 +289,20 @@ public:
     return m_lights.size();
   }
 
+  // The objects and their iterators belong to the thread stepping the
+  // physics once the layout is queued.
+  inline int getObjectsNumber() const {
+    return m_objects.size();
+  }
+  // Object of every transform slot.
+  inline const std::vector<Object *> &getObjects() const { return m_objects; }
+  int getActiveObjectsNumber() const;
+
+  // Transforms of all the objects, the dirty slots are the objects moved by
+  // the last step.
+  inline const TransformBuffer &getTransforms() const { return m_transforms; }
+  inline unsigned int getLayoutVersion() const { return m_layoutVersion; }
+
   inline void setMirror(Mirror *mirror) {
     m_mirror = mirror;
   } 
@@ -60,6 +315,30 @@ public:
 
 private:
   void initWorld();
+  void bindTransformSlot(Object *object);
+  CollisionFilter getCollisionFilter(const Object *object) const;
+  void addRigidBody(const Object *object);
+  void addRigidBodies(const Object *const *objects, int objectsNumber);
+  void removeRigidBodies(const std::vector<btRigidBody *> &rigidBodies);
+  void applyLayoutChanges();
+  void insertObjects(const std::vector<Object *> &objects);
+  void eraseObjects(const std::vector<Object *> &objects);
+  bool isLayoutFixed() const;
+  void removeSlot(int slot);
+  void removeDynamicSlot(int slot);
+  void saveBodyState(int slot, BodyState &state) const;
+  void buildRegions();
+  const std::vector<btDispatcher *> &getDispatchers();
+  void playSteps(int steps);
+  void profileStep(unsigned int step);
+  void recordFrame();
+  void settleBodies();
+  void thawTouchedBodies();
+  void freezeObject(int slot);
+  void thawObject(int slot);
+  void updateCollisionFilters();
+  void syncObject(Object *object, const TransformBuffer &previous,
+                  const TransformBuffer &current, int slot, btScalar alpha);
 
 //-----------------------------------------------------------------------------
 public:
@@ -7,6 +7,13 @@ TOP_DOWN_DIRECTION = {x = 0, y = -1, z = 0};
 BLACK = {r = 0, g = 0, b = 0, a = 1};
 WHITE = {r = 1, g = 1, b = 1, a = 1};
 
+-- Objects go into the default collision layer unless they name another one.
+local function checkLayer(layer)
+  if layer ~= nil and type(layer) ~= "string" then
+    error("The collision layer must be the name of a layer.");
+  end
+end
+
 --------------------------------------------------------------------------------
 function setCamera(camera)
   if camera.position == nil then
@@ -58,6 +65,201 @@ function setGravity(gravity)
 
   engine:_setGravity(gravity.x, gravity.y, gravity.z);
 end
+
+--------------------------------------------------------------------------------
+function setPhysicsThreads(threads)
+  if type(threads) ~= "number" or threads < 1 then
+    error("The number of physics threads must be a positive number.");
+  end
+
+  engine:_setPhysicsThreads(threads);
+end
+
+--------------------------------------------------------------------------------
+-- One of "sequential", "islands", "batches" or "simd", which solves the
+-- contacts several at a time, or for small scenes needing accuracy the MLCP
+-- solvers "dantzig" and "pgs".
+function setPhysicsSolver(solver)
+  if solver ~= "sequential" and solver ~= "islands" and solver ~= "batches" and
+     solver ~= "dantzig" and solver ~= "pgs" and solver ~= "simd" then
+    error("Unknown physics solver.");
+  end
+
+  engine:_setPhysicsSolver(solver);
+end
+
+--------------------------------------------------------------------------------
+-- The solver iterations adapt to the contacts between min and max, equal
+-- bounds fix them. A step longer than the optional budget, in milliseconds,
+-- takes fewer iterations.
+function setSolverIterations(min, max, budget)
+  if type(min) ~= "number" or min < 1 then
+    error("The minimum solver iterations must be a positive number.");
+  end
+  max = max or min;
+  if type(max) ~= "number" or max < min then
+    error("The maximum solver iterations must be at least the minimum.");
+  end
+  budget = budget or 0;
+  if type(budget) ~= "number" or budget < 0 then
+    error("The step budget must be a non negative number.");
+  end
+
+  engine:_setSolverIterations(min, max, budget / 1000);
+end
+
+--------------------------------------------------------------------------------
+-- One of "dbvt", "sap", "sap32" or "simple". The sweep and prune broadphases,
+-- "sap" and "sap32", work best with world bounds fitting the scene.
+function setPhysicsBroadphase(broadphase)
+  if broadphase ~= "dbvt" and broadphase ~= "sap" and
+     broadphase ~= "sap32" and broadphase ~= "simple" then
+    error("Unknown physics broadphase.");
+  end
+
+  engine:_setPhysicsBroadphase(broadphase);
+end
+
+--------------------------------------------------------------------------------
+-- Box all the bodies are expected to stay in, e.g.
+-- { min = { x = -50, y = -1, z = -50 }, max = { x = 50, y = 20, z = 50 } }.
+function setWorldBounds(bounds)
+  for _, corner in ipairs({ "min", "max" }) do
+    local point = bounds[corner];
+    if type(point) ~= "table" then
+      error("No " .. corner .. " corner in world bounds.");
+    elseif type(point.x) ~= "number" then
+      error("No x coordinate in world bounds " .. corner .. ".");
+    elseif type(point.y) ~= "number" then
+      error("No y coordinate in world bounds " .. corner .. ".");
+    elseif type(point.z) ~= "number" then
+      error("No z coordinate in world bounds " .. corner .. ".");
+    end
+  end
+  if bounds.min.x >= bounds.max.x or bounds.min.y >= bounds.max.y or
+     bounds.min.z >= bounds.max.z then
+    error("Empty world bounds.");
+  end
+
+  engine:_setWorldBounds(bounds.min.x, bounds.min.y, bounds.min.z,
+                         bounds.max.x, bounds.max.y, bounds.max.z);
+end
+
+--------------------------------------------------------------------------------
+-- Physics steps per second and the most steps taken in one go to catch up,
+-- past which the simulation slows down.
+function setPhysicsRate(stepsPerSecond, maxSubsteps)
+  if type(stepsPerSecond) ~= "number" or stepsPerSecond <= 0 then
+    error("The physics rate must be a positive number.");
+  end
+  maxSubsteps = maxSubsteps or 8;
+  if type(maxSubsteps) ~= "number" or maxSubsteps < 1 then
+    error("The number of physics substeps must be a positive number.");
+  end
+
+  engine:_setPhysicsRate(stepsPerSecond, maxSubsteps);
+end
+
+--------------------------------------------------------------------------------
+-- Bodies asleep for this many seconds are frozen into the static scenery.
+function setSettleTime(seconds)
+  if type(seconds) ~= "number" or seconds < 0 then
+    error("The settle time must be a non negative number.");
+  end
+
+  engine:_setSettleTime(seconds);
+end
+
+--------------------------------------------------------------------------------
+-- Report every body starting and stopping to touch another one. The count of
+-- hits shows in the overlay.
+function setContactEvents(enabled)
+  if type(enabled) ~= "boolean" then
+    error("The contact events switch must be a boolean.");
+  end
+
+  engine:_setContactEvents(enabled);
+end
+
+--------------------------------------------------------------------------------
+-- Time the broadphase, narrowphase, solver and integration of every physics
+-- step and show them in the overlay, along with the active bodies, contact
+-- manifolds and islands. Every step also goes to csvFile, when given.
+function setPhysicsProfile(enabled, csvFile)
+  if type(enabled) ~= "boolean" then
+    error("The physics profile switch must be a boolean.");
+  end
+  if csvFile ~= nil and type(csvFile) ~= "string" then
+    error("The physics profile file name must be a string.");
+  end
+
+  engine:_setPhysicsProfile(enabled, csvFile);
+end
+
+--------------------------------------------------------------------------------
+-- Split the world bounds into columns along x by rows along z, the regions
+-- stepped in parallel on the threads set by setPhysicsThreads. Bodies within
+-- overlap of a border are copied into the neighbouring regions, best kept
+-- above the size of a body.
+function setPhysicsRegions(columns, rows, overlap)
+  if type(columns) ~= "number" or columns < 1 or
+     type(rows) ~= "number" or rows < 1 then
+    error("The physics regions must be a positive number of columns and rows.");
+  end
+  overlap = overlap or 4;
+  if type(overlap) ~= "number" or overlap <= 0 then
+    error("The region overlap must be a positive number.");
+  end
+
+  engine:_setPhysicsRegions(columns, rows, overlap);
+end
+
+--------------------------------------------------------------------------------
+-- Create a collision layer, or redefine one, colliding with exactly the
+-- layers listed by name: itself only if listed, "default" only if listed.
+-- The layers listed must exist already. Objects pick their layer with
+-- layer = name, set the layers up before adding them. For instance
+--   setCollisionLayer("dominoes", {"default", "dominoes"});
+--   setCollisionLayer("decor", {"dominoes"});
+-- keeps the decor from colliding with the default layer and with itself.
+-- At most 8 layers, the default one included.
+function setCollisionLayer(name, collidesWith)
+  if type(name) ~= "string" then
+    error("The collision layer name must be a string.");
+  end
+  if type(collidesWith) ~= "table" then
+    error("The colliding layers must be a list of layer names.");
+  end
+  for _, layer in ipairs(collidesWith) do
+    if type(layer) ~= "string" then
+      error("The colliding layers must be a list of layer names.");
+    end
+  end
+
+  engine:_setCollisionLayer(name, collidesWith);
+end
+
+--------------------------------------------------------------------------------
+-- Record the motion of every object into a file, to be played back later
+-- by playRecording.
+function recordSimulation(fileName)
+  if type(fileName) ~= "string" then
+    error("The recording file name must be a string.");
+  end
+
+  engine:_recordSimulation(fileName);
+end
+
+--------------------------------------------------------------------------------
+-- Replay a recording of the same scene instead of simulating it. Use [ and ]
+-- to jump one second back and forth.
+function playRecording(fileName)
+  if type(fileName) ~= "string" then
+    error("The recording file name must be a string.");
+  end
+
+  engine:_playRecording(fileName);
+end
   
 --------------------------------------------------------------------------------
 function setBackgroundColor(color) 
@@ -228,6 +430,8 @@ function addMirror(mirror)
     mirror.orientation = CENTER;
   end
 
+  checkLayer(mirror.layer);
+
   engine:_addMirror(mirror.sides.x,
                     mirror.sides.y,
                     mirror.sides.z,
@@ -236,7 +440,8 @@ function addMirror(mirror)
                     mirror.position.y,
                     mirror.position.z,
                     mirror.orientation.x,
-                    mirror.orientation.y);
+                    mirror.orientation.y,
+                    mirror.layer);
 end
 
 --------------------------------------------------------------------------------
@@ -278,6 +483,8 @@ function addPlane(plane)
     plane.textureRepetitions = 1;
   end
 
+  checkLayer(plane.layer);
+
   engine:_addPlane(plane.side,
                    plane.mass,
                    plane.position.x,
@@ -301,7 +508,8 @@ function addPlane(plane)
                    plane.textureFile,
                    plane.normalTextureFile,
                    plane.textureRepetitions,
-                   plane.shader);
+                   plane.shader,
+                   plane.layer);
 end
 
 --------------------------------------------------------------------------------
@@ -339,6 +547,19 @@ function addBox(box)
   if box.normalTextureFile == nil then
     box.normalTextureFile = "";
   end
+  -- Continuous collision detection, derived from the sides when missing.
+  -- A null motion threshold disables it.
+  if box.ccdMotionThreshold ~= nil and
+     (type(box.ccdMotionThreshold) ~= "number" or box.ccdMotionThreshold < 0) then
+    error("The CCD motion threshold must be a non negative number.");
+  end
+  if box.ccdSweptSphereRadius ~= nil and
+     (type(box.ccdSweptSphereRadius) ~= "number" or
+      box.ccdSweptSphereRadius < 0) then
+    error("The CCD swept sphere radius must be a non negative number.");
+  end
+
+  checkLayer(box.layer);
 
   engine:_addBox(box.sides.x,
                  box.sides.y,
@@ -364,7 +585,152 @@ function addBox(box)
                  box.specularColor.a,
                  box.textureFile,
                  box.normalTextureFile,
-                 box.shader);
+                 box.shader,
+                 box.ccdMotionThreshold,
+                 box.ccdSweptSphereRadius,
+                 box.layer);
+end
+
+--------------------------------------------------------------------------------
+-- Dominoes standing every spacing along a path, built and added in one go.
+-- The path is one of:
+--   line:   from, to
+--   arc:    center, radius, startAngle, endAngle, angles in radians
+--   spiral: center, startRadius, endRadius, turns
+--   bezier: points, the four control points of a cubic curve
+--   grid:   origin, columns, rows, rowDistance, rows of columns dominoes
+--           along x one behind the other along z
+-- The first domino of every path, and of every row of a grid, leans forward
+-- by tipAngle so that the path falls on its own.
+function addDominoes(dominoes)
+  local DEFAULT_SIDES = {x = 0.25, y = 2, z = 0.5};
+
+  -- Optional parameters.
+  if dominoes.sides == nil then
+    dominoes.sides = DEFAULT_SIDES;
+  end
+  if dominoes.spacing == nil then
+    dominoes.spacing = dominoes.sides.y / 2;
+  end
+  if dominoes.tipAngle == nil then
+    dominoes.tipAngle = math.pi / 10;
+  end
+  if dominoes.mass == nil then
+    dominoes.mass = 20;
+  end
+  if dominoes.ambientColor == nil then
+    dominoes.ambientColor = BLACK;
+  end
+  if dominoes.diffuseColor == nil then
+    dominoes.diffuseColor = BLACK;
+  end
+  if dominoes.specularColor == nil then
+    dominoes.specularColor = BLACK;
+  end
+  if dominoes.shader == nil then
+    dominoes.shader = "phong";
+  end
+  if dominoes.textureFile == nil then
+    dominoes.textureFile = "";
+  end
+  if dominoes.normalTextureFile == nil then
+    dominoes.normalTextureFile = "";
+  end
+  if type(dominoes.spacing) ~= "number" or dominoes.spacing <= 0 then
+    error("The domino spacing must be a positive number.");
+  end
+  -- Continuous collision detection, as for addBox.
+  if dominoes.ccdMotionThreshold ~= nil and
+     (type(dominoes.ccdMotionThreshold) ~= "number" or
+      dominoes.ccdMotionThreshold < 0) then
+    error("The CCD motion threshold must be a non negative number.");
+  end
+  if dominoes.ccdSweptSphereRadius ~= nil and
+     (type(dominoes.ccdSweptSphereRadius) ~= "number" or
+      dominoes.ccdSweptSphereRadius < 0) then
+    error("The CCD swept sphere radius must be a non negative number.");
+  end
+
+  -- The path, as twelve numbers.
+  local path;
+  if dominoes.path == "line" then
+    if dominoes.from == nil or dominoes.to == nil then
+      error("Domino line ends missing");
+    end
+    path = {dominoes.from.x, dominoes.from.y, dominoes.from.z,
+            dominoes.to.x, dominoes.to.y, dominoes.to.z};
+  elseif dominoes.path == "arc" then
+    if dominoes.center == nil or type(dominoes.radius) ~= "number" or
+       type(dominoes.startAngle) ~= "number" or
+       type(dominoes.endAngle) ~= "number" then
+      error("Domino arc center, radius or angles missing");
+    end
+    path = {dominoes.center.x, dominoes.center.y, dominoes.center.z,
+            dominoes.radius, dominoes.startAngle, dominoes.endAngle};
+  elseif dominoes.path == "spiral" then
+    if dominoes.center == nil or type(dominoes.startRadius) ~= "number" or
+       type(dominoes.endRadius) ~= "number" or
+       type(dominoes.turns) ~= "number" then
+      error("Domino spiral center, radii or turns missing");
+    end
+    path = {dominoes.center.x, dominoes.center.y, dominoes.center.z,
+            dominoes.startRadius, dominoes.endRadius, dominoes.turns};
+  elseif dominoes.path == "bezier" then
+    if dominoes.points == nil or #dominoes.points ~= 4 then
+      error("A domino Bezier path needs four control points");
+    end
+    path = {};
+    for _, point in ipairs(dominoes.points) do
+      table.insert(path, point.x);
+      table.insert(path, point.y);
+      table.insert(path, point.z);
+    end
+  elseif dominoes.path == "grid" then
+    if dominoes.origin == nil or type(dominoes.columns) ~= "number" or
+       dominoes.columns < 1 or type(dominoes.rows) ~= "number" or
+       dominoes.rows < 1 then
+      error("Domino grid origin, columns or rows missing");
+    end
+    if dominoes.rowDistance == nil then
+      dominoes.rowDistance = 2 * dominoes.sides.z;
+    end
+    path = {dominoes.origin.x, dominoes.origin.y, dominoes.origin.z,
+            dominoes.columns, dominoes.rows, dominoes.rowDistance};
+  else
+    error("Unknown domino path.");
+  end
+  for index = #path + 1, 12 do
+    path[index] = 0;
+  end
+  checkLayer(dominoes.layer);
+
+  engine:_addDominoes(dominoes.path,
+                      path[1], path[2], path[3], path[4], path[5], path[6],
+                      path[7], path[8], path[9], path[10], path[11], path[12],
+                      dominoes.sides.x,
+                      dominoes.sides.y,
+                      dominoes.sides.z,
+                      dominoes.spacing,
+                      dominoes.tipAngle,
+                      dominoes.mass,
+                      dominoes.ambientColor.r,
+                      dominoes.ambientColor.g,
+                      dominoes.ambientColor.b,
+                      dominoes.ambientColor.a,
+                      dominoes.diffuseColor.r,
+                      dominoes.diffuseColor.g,
+                      dominoes.diffuseColor.b,
+                      dominoes.diffuseColor.a,
+                      dominoes.specularColor.r,
+                      dominoes.specularColor.g,
+                      dominoes.specularColor.b,
+                      dominoes.specularColor.a,
+                      dominoes.textureFile,
+                      dominoes.normalTextureFile,
+                      dominoes.shader,
+                      dominoes.ccdMotionThreshold,
+                      dominoes.ccdSweptSphereRadius,
+                      dominoes.layer);
 end
 
 --------------------------------------------------------------------------------
@@ -405,6 +771,7 @@ function addLightBulb(bulb)
   end
 
   bulb.shader = "lightBulb";
+  checkLayer(bulb.layer);
 
   engine:_addLightBulb(bulb.radius,
                        bulb.mass,
@@ -430,7 +797,8 @@ function addLightBulb(bulb)
                        bulb.linearAttenuation,
                        bulb.quadraticAttenuation,
                        bulb.textureFile,
-                       bulb.shader);
+                       bulb.shader,
+                       bulb.layer);
 end
 
 --------------------------------------------------------------------------------
@@ -462,6 +830,22 @@ function addMesh(mesh)
   if mesh.shader == nil then
     mesh.shader = "phong";
   end
+  checkLayer(mesh.layer);
+  -- How far the collision shape may be from the mesh, as a fraction of its
+  -- size, for a sphere, box, capsule or cylinder to stand in for its hull.
+  -- 5% when missing, 0 takes exact matches only.
+  if mesh.shapeTolerance ~= nil and
+     (type(mesh.shapeTolerance) ~= "number" or mesh.shapeTolerance < 0) then
+    error("The shape tolerance must be a non negative number.");
+  end
+  -- Collide with the triangles of the mesh instead of a primitive or a hull,
+  -- for static meshes only.
+  if mesh.triangleMesh ~= nil and type(mesh.triangleMesh) ~= "boolean" then
+    error("Mesh triangleMesh must be true or false.");
+  end
+  if mesh.triangleMesh and mesh.mass ~= 0 then
+    error("A triangle mesh must have no mass.");
+  end
 
   engine:_addMesh(mesh.objFile,
                   mesh.mass,
@@ -483,5 +867,8 @@ function addMesh(mesh)
                   mesh.specularColor.g,
                   mesh.specularColor.b,
                   mesh.specularColor.a,
-                  mesh.shader);
+                  mesh.shader,
+                  mesh.layer,
+                  mesh.shapeTolerance,
+                  mesh.triangleMesh);
 end
@@ -1,55 +1,5 @@
 require "domino_setup"
 
-function signum(x)
-   if x<0 then
-     return -1
-   elseif x>0 then
-     return 1
-   else
-     return 0
-   end
-end
-
-function traceDominoLine(start, finish)
-  DOMINO_NUMBER = 31;
-
-  deltaX = finish.x - start.x;
-  deltaZ = finish.z - start.z;
-
-  length = math.sqrt(deltaX * deltaX + deltaZ * deltaZ);
-  slope = deltaZ / deltaX;
-  if(slope < 0) then
-    slope = -1 * slope; 
-  end
-  if(deltaX == 0) then
-    slope = 1;
-  end
-  angle = math.atan2(deltaZ, deltaX);
-
-  dominoDistance = length / (DOMINO_NUMBER - 1);
-
-  directionX = signum(deltaX);
-  directionY = 0;
-  directionZ = signum(deltaZ) * slope; 
-
-  directionNorm = math.sqrt(directionX * directionX + directionY * directionY + directionZ * directionZ);
-
-  direction = {x = directionX / directionNorm, y = 0, z = directionZ / directionNorm};
-
-  for index = 0,DOMINO_NUMBER - 1 do 
-    positionX = start.x + dominoDistance * index * direction.x; 
-    positionY = start.y + dominoDistance * index * direction.y + 1.25;
-    positionZ = start.z + dominoDistance * index * direction.z;
-
-    print(positionX, positionY, positionZ);
-
-    addBox({sides = {x = 0.25, y = 2.5, z =1}, 
-            position = {x = positionX, y = positionY, z = positionZ}, 
-            orientation = {x = -angle, y = 0, z = 0},
-            mass = 10, textureFile = "checker.png"});
-  end
-end
-
 setCamera({position = {x = 0, y = 2, z = -20}, orientation = {x = 0, y = 0}});
 setGravity({x = 0, y = -9.81, z = 0});
 setBackgroundColor({r = 0.2, g = 0.4, b = 0.6, a = 1});
@@ -79,23 +29,25 @@ addLightBulb({radius = 0.5,
               position = {x = -10, y = 3, z = -10}, 
               mass = 1, constantAttenuation = 0.1, linearAttenuation = 0.1});
 addBox({sides = {x = 60, y = 2, z = 60}, textureFile = "red_brick.tif", normalTextureFile = "red_brick_normal.tif"});
+addDominoes({path = "arc", center = {x = 0, y = 1, z = 0}, radius = 25, startAngle = 0, endAngle = math.pi,
+             textureFile = "checker.png"});
 
 barrelPosition = 29;
 for index = 1,20 do
-addMesh({objFile = "barrel.obj", position = {x = -barrelPosition + index * 3, y = 2, z = -barrelPosition}, mass = 1});
+addMesh({objFile = "barrel.obj", position = {x = -barrelPosition + index * 3, y = 2, z = -barrelPosition}, mass = 1, shapeTolerance = 0.2});
 end
 for index = 1,20 do
-  addMesh({objFile = "barrel.obj", position = {x = -barrelPosition + index * 3, y = 2, z = barrelPosition}, mass = 1});
+  addMesh({objFile = "barrel.obj", position = {x = -barrelPosition + index * 3, y = 2, z = barrelPosition}, mass = 1, shapeTolerance = 0.2});
 end
 for index = 1,20 do
-  addMesh({objFile = "barrel.obj", position = {x = barrelPosition, y = 2, z = -barrelPosition + index * 3}, mass = 1});
+  addMesh({objFile = "barrel.obj", position = {x = barrelPosition, y = 2, z = -barrelPosition + index * 3}, mass = 1, shapeTolerance = 0.2});
 end
 for index = 1,20 do
-  addMesh({objFile = "barrel.obj", position = {x = -barrelPosition, y = 2, z = -barrelPosition + index * 3}, mass = 1});
+  addMesh({objFile = "barrel.obj", position = {x = -barrelPosition, y = 2, z = -barrelPosition + index * 3}, mass = 1, shapeTolerance = 0.2});
 end
 
 for index = 1,30 do 
-  addMesh({objFile = "barrel.obj", position = {x = 0, y = index * 10, z = index % 2}, mass = 10});
+  addMesh({objFile = "barrel.obj", position = {x = 0, y = index * 10, z = index % 2}, mass = 10, shapeTolerance = 0.2});
 end
 for index = 1,30 do 
   addMesh({objFile = "kufel.obj", position = {x = 0, y = index * 10, z = index % 2}, mass = 10});
@@ -105,10 +57,14 @@ end
 --addMesh({objFile = "barrel.obj", position = {x = -10, y = 20, z = 0}, mass = 10});
 --addMesh({objFile = "barrel.obj", position = {x = -10, y = 30, z = 0}, mass = 10});
 --
-----traceDominoLine({x = 1, y = 20, z = 1}, {x = 20, y = 0, z = 20});
-----traceDominoLine({x = -1, y = 0, z = 1}, {x = -20, y = 0, z = 20});
-----traceDominoLine({x = 20, y = 0, z = 21}, {x = 1, y = 0, z = 80});
-----traceDominoLine({x = -20, y = 0, z = 21}, {x = -1, y = 0, z = 80});
+----addDominoes({path = "line", from = {x = 1, y = 20, z = 1}, to = {x = 20, y = 0, z = 20},
+----             sides = {x = 0.25, y = 2.5, z = 1}, mass = 10, textureFile = "checker.png"});
+----addDominoes({path = "line", from = {x = -1, y = 0, z = 1}, to = {x = -20, y = 0, z = 20},
+----             sides = {x = 0.25, y = 2.5, z = 1}, mass = 10, textureFile = "checker.png"});
+----addDominoes({path = "line", from = {x = 20, y = 0, z = 21}, to = {x = 1, y = 0, z = 80},
+----             sides = {x = 0.25, y = 2.5, z = 1}, mass = 10, textureFile = "checker.png"});
+----addDominoes({path = "line", from = {x = -20, y = 0, z = 21}, to = {x = -1, y = 0, z = 80},
+----             sides = {x = 0.25, y = 2.5, z = 1}, mass = 10, textureFile = "checker.png"});
 --addBox({sides = {x = 1, y = 2.5, z =2}, 
 --        position = {x = 0, y = 20, z = -0.5}, 
 --        orientation = {x = 0, y = 0, z = 0},
@@ -119,5 +75,7 @@ end
 ----        orientation = {x = 1.57, y = 0, z = 0},
 ----        mass = 10, textureFile = "checker.png"});
 --
-----traceDominoLine({x = 20, y = 0, z = 1}, {x = 20, y = 0, z = 21});
-----traceDominoLine({x = -20, y = 0, z = 22}, {x = 20, y = 0, z = 22});
+----addDominoes({path = "line", from = {x = 20, y = 0, z = 1}, to = {x = 20, y = 0, z = 21},
+----             sides = {x = 0.25, y = 2.5, z = 1}, mass = 10, textureFile = "checker.png"});
+----addDominoes({path = "line", from = {x = -20, y = 0, z = 22}, to = {x = 20, y = 0, z = 22},
+----             sides = {x = 0.25, y = 2.5, z = 1}, mass = 10, textureFile = "checker.png"});
@@ -1,6 +1,7 @@
 #include "Box.h"
 
 #include "MathUtils.h"
+#include "ShapeCache.h"
 
 #include <LinearMath/btVector3.h>
 
@@ -9,19 +10,32 @@
 #include <iostream>
 
 #include <algorithm>
+#include <utility>
 
 template class ObjectBuilder<BoxBuilder>;
 
+// Past half the thickness in one step a box may end up more inside its
+// neighbour than out of it. The sphere has to fit inside the box.
+const btScalar BoxBuilder::CCD_MOTION_THRESHOLD_RATIO = 1.0;
+const btScalar BoxBuilder::CCD_SWEPT_SPHERE_RATIO = 0.8;
+
 Box::Box(const btTransform &transform, const btScalar mass, btVector3 &inertia,
-         const btVector3 &sides)
-    : Object(transform, mass, inertia) {
+         const btVector3 &sides, std::shared_ptr<Geometry> geometry)
+    : Object(transform, mass, inertia, std::move(geometry)) {
   const btVector3 halfSides = sides / 2;
-  setupFaces({ halfSides.x(), halfSides.y(), halfSides.z() });
+  if (m_geometry->points.empty())
+    setupFaces({ halfSides.x(), halfSides.y(), halfSides.z() });
   setupBulletShape(halfSides);
 }
 
 //------------------------------------------------------------------------------
 void Box::setupFaces(const glm::vec3 &halfSides) {
+  auto &points = m_geometry->points;
+  auto &normals = m_geometry->normals;
+  auto &indices = m_geometry->indices;
+  auto &textureCoos = m_geometry->textureCoos;
+  auto &tangents = m_geometry->tangents;
+
   glm::vec3 frontTopLeft = glm::vec3(-1, 1, -1) * halfSides;
   glm::vec3 frontTopRight = glm::vec3(1, 1, -1) * halfSides;
   glm::vec3 frontBottomLeft = glm::vec3(-1, -1, -1) * halfSides;
@@ -31,34 +45,34 @@ void Box::setupFaces(const glm::vec3 &halfSides) {
   glm::vec3 backBottomLeft = glm::vec3(-1, -1, 1) * halfSides;
   glm::vec3 backBottomRight = glm::vec3(1, -1, 1) * halfSides;
 
-  m_points = { frontTopRight,    frontBottomRight,
-             frontBottomLeft,  frontTopLeft, // Front.
-             backTopRight,     backBottomRight,
-             frontBottomRight, frontTopRight, // Right.
-             backTopLeft,      backBottomLeft,
-             backBottomRight,  backTopRight, // Back.
-             frontTopLeft,     frontBottomLeft,
-             backBottomLeft,   backTopLeft, // Left.
-             backTopRight,     frontTopRight,
-             frontTopLeft,     backTopLeft, // Top.
-             backBottomLeft,   frontBottomLeft,
-             frontBottomRight, backBottomRight // Bottom.
+  points = { frontTopRight,    frontBottomRight,
+           frontBottomLeft,  frontTopLeft, // Front.
+           backTopRight,     backBottomRight,
+           frontBottomRight, frontTopRight, // Right.
+           backTopLeft,      backBottomLeft,
+           backBottomRight,  backTopRight, // Back.
+           frontTopLeft,     frontBottomLeft,
+           backBottomLeft,   backTopLeft, // Left.
+           backTopRight,     frontTopRight,
+           frontTopLeft,     backTopLeft, // Top.
+           backBottomLeft,   frontBottomLeft,
+           frontBottomRight, backBottomRight // Bottom.
   };
 
-  m_textureCoos = { {1, 1}, {1, 0}, {0, 0}, {0, 1},
-                  {1, 1}, {1, 0}, {0, 0}, {0, 1},
-                  {1, 1}, {1, 0}, {0, 0}, {0, 1},
-                  {1, 1}, {1, 0}, {0, 0}, {0, 1},
-                  {1, 1}, {1, 0}, {0, 0}, {0, 1},
-                  {1, 1}, {1, 0}, {0, 0}, {0, 1}
+  textureCoos = { {1, 1}, {1, 0}, {0, 0}, {0, 1},
+                {1, 1}, {1, 0}, {0, 0}, {0, 1},
+                {1, 1}, {1, 0}, {0, 0}, {0, 1},
+                {1, 1}, {1, 0}, {0, 0}, {0, 1},
+                {1, 1}, {1, 0}, {0, 0}, {0, 1},
+                {1, 1}, {1, 0}, {0, 0}, {0, 1}
   };
 
-  m_indices = { 0,  1,  2,  2,  3,  0,  // Front.
-              4,  5,  6,  6,  7,  4,  // Right.
-              8,  9,  10, 10, 11, 8,  // Back.
-              12, 13, 14, 14, 15, 12, // Left.
-              16, 17, 18, 18, 19, 16, // Top.
-              20, 21, 22, 22, 23, 20  // Bottom.
+  indices = { 0,  1,  2,  2,  3,  0,  // Front.
+            4,  5,  6,  6,  7,  4,  // Right.
+            8,  9,  10, 10, 11, 8,  // Back.
+            12, 13, 14, 14, 15, 12, // Left.
+            16, 17, 18, 18, 19, 16, // Top.
+            20, 21, 22, 22, 23, 20  // Bottom.
   };
 
   glm::vec3 frontNormal =
@@ -74,12 +88,12 @@ void Box::setupFaces(const glm::vec3 &halfSides) {
   glm::vec3 bottomNormal =
       computeNormal(backBottomLeft, frontBottomLeft, frontBottomRight);
 
-  m_normals = { frontNormal,  frontNormal,  frontNormal,  frontNormal,
-              rightNormal,  rightNormal,  rightNormal,  rightNormal,
-              backNormal,   backNormal,   backNormal,   backNormal,
-              leftNormal,   leftNormal,   leftNormal,   leftNormal,
-              topNormal,    topNormal,    topNormal,    topNormal,
-              bottomNormal, bottomNormal, bottomNormal, bottomNormal };
+  normals = { frontNormal,  frontNormal,  frontNormal,  frontNormal,
+            rightNormal,  rightNormal,  rightNormal,  rightNormal,
+            backNormal,   backNormal,   backNormal,   backNormal,
+            leftNormal,   leftNormal,   leftNormal,   leftNormal,
+            topNormal,    topNormal,    topNormal,    topNormal,
+            bottomNormal, bottomNormal, bottomNormal, bottomNormal };
 
   glm::vec3 frontTangent {1, 0, 0};
   glm::vec3 rightTangent {0, 0, 1};
@@ -97,14 +111,14 @@ void Box::setupFaces(const glm::vec3 &halfSides) {
 //    };
 
   // Compute the tangent vector for each triangle.
-  for (auto index = 0u; index < m_indices.size() / 3; ++index) {
-    auto point0 = m_points[m_indices[3 * index + 0]];
-    auto point1 = m_points[m_indices[3 * index + 1]]; 
-    auto point2 = m_points[m_indices[3 * index + 2]];
+  for (auto index = 0u; index < indices.size() / 3; ++index) {
+    auto point0 = points[indices[3 * index + 0]];
+    auto point1 = points[indices[3 * index + 1]]; 
+    auto point2 = points[indices[3 * index + 2]];
 
-    auto tex0 = m_textureCoos[m_indices[3 * index + 0]];
-    auto tex1 = m_textureCoos[m_indices[3 * index + 1]];
-    auto tex2 = m_textureCoos[m_indices[3 * index + 2]];
+    auto tex0 = textureCoos[indices[3 * index + 0]];
+    auto tex1 = textureCoos[indices[3 * index + 1]];
+    auto tex2 = textureCoos[indices[3 * index + 2]];
 
     auto edge1 = point1 - point0;
     auto edge2 = point2 - point0;
@@ -115,18 +129,14 @@ void Box::setupFaces(const glm::vec3 &halfSides) {
     glm::vec3 tangent = (edge1 * deltaTex2.y - edge2 * deltaTex1.y) /
                         (deltaTex1.x * deltaTex2.y - deltaTex1.y * deltaTex2.x);
 
-    m_tangents.insert(m_tangents.end(), {tangent, tangent}); 
+    tangents.insert(tangents.end(), {tangent, tangent}); 
   }
 }
 
 //------------------------------------------------------------------------------
 void Box::setupBulletShape(const btVector3 halfSides) {
-  m_collisionShape = new btBoxShape(halfSides);
-  m_collisionShape->calculateLocalInertia(m_mass, m_inertia);
-  m_motionState = new btDefaultMotionState(m_transform);
-  m_constructionInfo = new btRigidBody::btRigidBodyConstructionInfo(
-      m_mass, m_motionState, m_collisionShape, m_inertia);
-  m_rigidBody = new btRigidBody(*m_constructionInfo);
+  m_collisionShape = ShapeCache::getInstance().acquireBox(halfSides);
+  setupRigidBody();
 }
 
 //------------------------------------------------------------------------------
@@ -137,10 +147,37 @@ BoxBuilder &BoxBuilder::setSides(const btVector3 &sidesLengths) {
   return *this;
 }
 
+BoxBuilder &BoxBuilder::setCcdMotionThreshold(btScalar motionThreshold) {
+  m_ccdMotionThreshold = motionThreshold;
+  return *this;
+}
+
+BoxBuilder &BoxBuilder::setCcdSweptSphereRadius(btScalar sweptSphereRadius) {
+  m_ccdSweptSphereRadius = sweptSphereRadius;
+  return *this;
+}
+
 Box *BoxBuilder::create() {
-  Box *box = new Box(m_transform, m_mass, m_inertia, m_sidesLengths);
+  if (!m_geometry || m_geometrySides != m_sidesLengths) {
+    m_geometry = std::make_shared<Geometry>();
+    m_geometrySides = m_sidesLengths;
+  }
+  Box *box =
+      new Box(m_transform, m_mass, m_inertia, m_sidesLengths, m_geometry);
   ObjectBuilder::setColors(box);
   box->m_textureFile = m_textureFile;
   box->m_normalTextureFile = m_normalTextureFile;
+
+  // Static boxes never move, they take part in the sweeps of the others.
+  if (m_mass > 0) {
+    const btScalar halfThickness = m_sidesLengths[m_sidesLengths.minAxis()] / 2;
+    btRigidBody *rigidBody = box->getRigidBody();
+    rigidBody->setCcdMotionThreshold(
+        m_ccdMotionThreshold >= 0 ? m_ccdMotionThreshold
+                                  : CCD_MOTION_THRESHOLD_RATIO * halfThickness);
+    rigidBody->setCcdSweptSphereRadius(
+        m_ccdSweptSphereRadius >= 0 ? m_ccdSweptSphereRadius
+                                    : CCD_SWEPT_SPHERE_RATIO * halfThickness);
+  }
   return box;
 }
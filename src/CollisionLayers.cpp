@@ -0,0 +1,98 @@
+#include "CollisionLayers.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+const int CollisionLayers::MAX_LAYERS;
+const int CollisionLayers::DEFAULT_LAYER;
+const char *const CollisionLayers::DEFAULT_LAYER_NAME = "default";
+
+static const unsigned int ALL_LAYERS = (1u << CollisionLayers::MAX_LAYERS) - 1;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+unsigned int getDynamicBit(int layer);
+unsigned int getStaticBit(int layer);
+
+// -----------------------------------------------------------------------------
+CollisionLayers::CollisionLayers()
+    : m_names(1, DEFAULT_LAYER_NAME) {
+  std::fill(m_collisions, m_collisions + MAX_LAYERS, ALL_LAYERS);
+}
+
+// -----------------------------------------------------------------------------
+int CollisionLayers::findLayer(const std::string &name) const {
+  auto position = std::find(m_names.begin(), m_names.end(), name);
+  if (position == m_names.end())
+    return -1;
+  return position - m_names.begin();
+}
+
+// -----------------------------------------------------------------------------
+// The colliding layers are looked up first, a new layer can list itself.
+int CollisionLayers::setLayer(const std::string &name,
+                              const std::vector<std::string> &collidingLayers) {
+  int layer = findLayer(name);
+  const int newLayer = layer == -1 ? getLayersNumber() : layer;
+  unsigned int collisions = 0;
+  for (const auto &collidingName : collidingLayers) {
+    const int collidingLayer =
+        collidingName == name ? newLayer : findLayer(collidingName);
+    if (collidingLayer == -1) {
+      std::cerr << "Unknown collision layer: " << collidingName << "\n";
+      exit(1);
+    }
+    collisions |= 1u << collidingLayer;
+  }
+
+  if (layer == -1) {
+    if (getLayersNumber() == MAX_LAYERS) {
+      std::cerr << "Too many collision layers, at most " << MAX_LAYERS
+                << " fit in a filter\n";
+      exit(1);
+    }
+    m_names.push_back(name);
+    layer = newLayer;
+  }
+  m_collisions[layer] = collisions;
+  for (int other = 0; other < MAX_LAYERS; ++other) {
+    if (other == layer)
+      continue;
+    if (collisions & (1u << other))
+      m_collisions[other] |= 1u << layer;
+    else
+      m_collisions[other] &= ~(1u << layer);
+  }
+  return layer;
+}
+
+// -----------------------------------------------------------------------------
+bool CollisionLayers::collides(int layer, int otherLayer) const {
+  assert(layer >= 0 && layer < getLayersNumber() && "Unknown layer");
+  return (m_collisions[layer] & (1u << otherLayer)) != 0;
+}
+
+// -----------------------------------------------------------------------------
+// A dynamic body takes both bits of the layers it collides with, a static one
+// only their dynamic bit. With the default layer alone, the filters pair the
+// same bodies as the ones Bullet gives by default.
+CollisionFilter CollisionLayers::getFilter(int layer, bool dynamic) const {
+  assert(layer >= 0 && layer < getLayersNumber() && "Unknown layer");
+  unsigned int mask = 0;
+  for (int other = 0; other < MAX_LAYERS; ++other) {
+    if (!collides(layer, other))
+      continue;
+    mask |= getDynamicBit(other);
+    if (dynamic)
+      mask |= getStaticBit(other);
+  }
+  const unsigned int group =
+      dynamic ? getDynamicBit(layer) : getStaticBit(layer);
+  return {static_cast<short>(group), static_cast<short>(mask)};
+}
+
+// -----------------------------------------------------------------------------
+unsigned int getDynamicBit(int layer) { return 1u << (2 * layer); }
+unsigned int getStaticBit(int layer) { return 1u << (2 * layer + 1); }
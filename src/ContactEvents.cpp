@@ -0,0 +1,174 @@
+#include "ContactEvents.h"
+
+#include "EngineMotionState.h"
+#include "RegionGrid.h"
+
+#include <BulletCollision/BroadphaseCollision/btDispatcher.h>
+#include <BulletCollision/CollisionDispatch/btCollisionObject.h>
+#include <BulletCollision/NarrowPhaseCollision/btPersistentManifold.h>
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------
+void ContactEventStream::update(const std::vector<btDispatcher *> &dispatchers,
+                                unsigned int step) {
+  const bool firstUpdate = m_updatesNumber++ == 0;
+  m_seenPairs.clear();
+  for (auto dispatcher : dispatchers)
+    addManifolds(dispatcher, step, firstUpdate);
+
+  // The pairs not seen in this update stopped touching, unless they were
+  // skipped for sleeping. Frozen bodies sleep too: their manifolds with each
+  // other and with the static ones are gone, yet they still touch.
+  for (auto pair : m_revisitPairs) {
+    auto touching = m_touchingPairs.find(pair);
+    if (touching == m_touchingPairs.end() ||
+        touching->second.update == m_updatesNumber)
+      continue;
+    const btCollisionObject *body0 = touching->second.body0;
+    const btCollisionObject *body1 = touching->second.body1;
+    if (body0->isActive() || body1->isActive())
+      endPair(pair, step);
+  }
+  m_revisitPairs.swap(m_seenPairs);
+}
+
+// -----------------------------------------------------------------------------
+// A pair across the border of two regions is seen in both, once for the
+// stream. A pair whose manifold lost its contact points is revisited at the
+// end of the update, the other region may still hold some.
+void ContactEventStream::addManifolds(btDispatcher *dispatcher,
+                                      unsigned int step, bool firstUpdate) {
+  for (int index = 0; index < dispatcher->getNumManifolds(); ++index) {
+    const btPersistentManifold *manifold =
+        dispatcher->getManifoldByIndexInternal(index);
+    const btCollisionObject *body0 = RegionGrid::getOwner(manifold->getBody0());
+    const btCollisionObject *body1 = RegionGrid::getOwner(manifold->getBody1());
+    if (!firstUpdate && !body0->isActive() && !body1->isActive())
+      continue;
+
+    const int slot0 = EngineMotionState::getBodySlot(body0);
+    const int slot1 = EngineMotionState::getBodySlot(body1);
+    if (slot0 < 0 || slot1 < 0)
+      continue;
+
+    const uint64_t pair = makePair(slot0, slot1);
+    if (manifold->getNumContacts() == 0) {
+      if (!firstUpdate)
+        m_revisitPairs.push_back(pair);
+      continue;
+    }
+
+    auto touching = m_touchingPairs.find(pair);
+    if (touching != m_touchingPairs.end()) {
+      if (touching->second.update != m_updatesNumber) {
+        touching->second.update = m_updatesNumber;
+        m_seenPairs.push_back(pair);
+      }
+      continue;
+    }
+    addPair(pair, {body0, body1, m_updatesNumber});
+    m_seenPairs.push_back(pair);
+    if (firstUpdate)
+      continue;
+
+    btScalar impulse = 0;
+    for (int point = 0; point < manifold->getNumContacts(); ++point)
+      impulse += manifold->getContactPoint(point).getAppliedImpulse();
+    pushEvent(ContactEvent::Type::ceBegin, pair, impulse, step);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void ContactEventStream::reset() {
+  m_touchingPairs.clear();
+  m_slotPairs.clear();
+  m_revisitPairs.clear();
+  m_updatesNumber = 0;
+}
+
+// -----------------------------------------------------------------------------
+void ContactEventStream::remapSlots(const std::unordered_map<int, int> &slots,
+                                   unsigned int step) {
+  if (slots.empty())
+    return;
+  std::unordered_map<uint64_t, TouchingPair> touchingPairs;
+  touchingPairs.swap(m_touchingPairs);
+  m_touchingPairs.reserve(touchingPairs.size());
+  m_slotPairs.clear();
+  for (const auto &touching : touchingPairs) {
+    uint64_t pair = touching.first;
+    if (remapPair(pair, slots))
+      addPair(pair, touching.second);
+    else
+      pushEvent(ContactEvent::Type::ceEnd, touching.first, 0, step);
+  }
+
+  int kept = 0;
+  for (auto pair : m_revisitPairs) {
+    if (remapPair(pair, slots))
+      m_revisitPairs[kept++] = pair;
+  }
+  m_revisitPairs.resize(kept);
+}
+
+// -----------------------------------------------------------------------------
+void ContactEventStream::revisitSlot(int slot) {
+  if (slot < static_cast<int>(m_slotPairs.size()))
+    m_revisitPairs.insert(m_revisitPairs.end(), m_slotPairs[slot].begin(),
+                          m_slotPairs[slot].end());
+}
+
+// -----------------------------------------------------------------------------
+void ContactEventStream::addPair(uint64_t pair, const TouchingPair &touching) {
+  m_touchingPairs.insert({pair, touching});
+  const int slots[2] = {static_cast<int>(pair >> 32),
+                        static_cast<int>(pair & 0xffffffff)};
+  if (slots[1] >= static_cast<int>(m_slotPairs.size()))
+    m_slotPairs.resize(slots[1] + 1);
+  for (auto slot : slots)
+    m_slotPairs[slot].push_back(pair);
+}
+
+// -----------------------------------------------------------------------------
+void ContactEventStream::endPair(uint64_t pair, unsigned int step) {
+  pushEvent(ContactEvent::Type::ceEnd, pair, 0, step);
+  m_touchingPairs.erase(pair);
+  const int slots[2] = {static_cast<int>(pair >> 32),
+                        static_cast<int>(pair & 0xffffffff)};
+  for (auto slot : slots) {
+    std::vector<uint64_t> &pairs = m_slotPairs[slot];
+    *std::find(pairs.begin(), pairs.end(), pair) = pairs.back();
+    pairs.pop_back();
+  }
+}
+
+// -----------------------------------------------------------------------------
+void ContactEventStream::pushEvent(ContactEvent::Type type, uint64_t pair,
+                                   btScalar impulse, unsigned int step) {
+  ContactEvent event = {type, static_cast<int>(pair >> 32),
+                        static_cast<int>(pair & 0xffffffff), impulse, step};
+  m_events.push(event);
+}
+
+// -----------------------------------------------------------------------------
+uint64_t ContactEventStream::makePair(int slot0, int slot1) {
+  return static_cast<uint64_t>(std::min(slot0, slot1)) << 32 |
+         static_cast<uint32_t>(std::max(slot0, slot1));
+}
+
+// -----------------------------------------------------------------------------
+bool ContactEventStream::remapPair(uint64_t &pair,
+                                   const std::unordered_map<int, int> &slots) {
+  int pairSlots[2] = {static_cast<int>(pair >> 32),
+                      static_cast<int>(pair & 0xffffffff)};
+  for (auto &slot : pairSlots) {
+    auto remapped = slots.find(slot);
+    if (remapped != slots.end())
+      slot = remapped->second;
+  }
+  if (pairSlots[0] < 0 || pairSlots[1] < 0)
+    return false;
+  pair = makePair(pairSlots[0], pairSlots[1]);
+  return true;
+}
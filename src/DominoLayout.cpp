@@ -0,0 +1,139 @@
+#include "DominoLayout.h"
+
+#include "Box.h"
+
+#include <LinearMath/btQuaternion.h>
+
+#include <algorithm>
+#include <cassert>
+
+const btScalar DominoLayout::DEFAULT_TIP_ANGLE = SIMD_PI / 10;
+const int DominoLayout::SAMPLES_PER_DOMINO;
+const int DominoLayout::MIN_SAMPLES;
+
+// A line a hair shorter than a multiple of the spacing still ends on a
+// domino.
+static const btScalar LENGTH_TOLERANCE = 1e-3;
+
+// -----------------------------------------------------------------------------
+DominoLayout::DominoLayout(const btVector3 &sides, btScalar spacing)
+    : m_sides(sides), m_spacing(spacing) {
+  assert(spacing > 0 && "The dominoes need a positive spacing");
+}
+
+// -----------------------------------------------------------------------------
+void DominoLayout::reserve(int dominoesNumber) {
+  m_transforms.reserve(dominoesNumber);
+}
+
+// -----------------------------------------------------------------------------
+void DominoLayout::traceLine(const btVector3 &origin,
+                             const btVector3 &destination) {
+  const btVector3 path = destination - origin;
+  const btScalar length = path.length();
+  const btVector3 direction = length > 0 ? path / length : btVector3(1, 0, 0);
+  const int dominoesNumber =
+      static_cast<int>(length / m_spacing + LENGTH_TOLERANCE) + 1;
+
+  reserve(getDominoesNumber() + dominoesNumber);
+  for (int domino = 0; domino < dominoesNumber; ++domino)
+    addDomino(origin + direction * (domino * m_spacing), direction,
+              domino == 0);
+}
+
+// -----------------------------------------------------------------------------
+void DominoLayout::traceArc(const btVector3 &center, btScalar radius,
+                            btScalar startAngle, btScalar endAngle) {
+  traceCurve([&](btScalar t) {
+    const btScalar angle = startAngle + (endAngle - startAngle) * t;
+    return center + radius * btVector3(btCos(angle), 0, btSin(angle));
+  });
+}
+
+// -----------------------------------------------------------------------------
+void DominoLayout::traceSpiral(const btVector3 &center, btScalar startRadius,
+                               btScalar endRadius, btScalar turns) {
+  traceCurve([&](btScalar t) {
+    const btScalar angle = SIMD_2_PI * turns * t;
+    const btScalar radius = startRadius + (endRadius - startRadius) * t;
+    return center + radius * btVector3(btCos(angle), 0, btSin(angle));
+  });
+}
+
+// -----------------------------------------------------------------------------
+void DominoLayout::traceBezier(const btVector3 &point0,
+                               const btVector3 &point1,
+                               const btVector3 &point2,
+                               const btVector3 &point3) {
+  traceCurve([&](btScalar t) {
+    const btScalar s = 1 - t;
+    return s * s * s * point0 + 3 * s * s * t * point1 +
+           3 * s * t * t * point2 + t * t * t * point3;
+  });
+}
+
+// -----------------------------------------------------------------------------
+void DominoLayout::traceGrid(const btVector3 &origin, int columns, int rows,
+                             btScalar rowDistance) {
+  assert(columns > 0 && rows > 0 && "A grid needs a row and a column");
+  reserve(getDominoesNumber() + columns * rows);
+  const btVector3 rowLength((columns - 1) * m_spacing, 0, 0);
+  for (int row = 0; row < rows; ++row) {
+    const btVector3 rowOrigin = origin + btVector3(0, 0, row * rowDistance);
+    traceLine(rowOrigin, rowOrigin + rowLength);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void DominoLayout::createDominoes(BoxBuilder &builder,
+                                  std::vector<Object *> &dominoes) {
+  dominoes.reserve(dominoes.size() + m_transforms.size());
+  builder.setSides(m_sides);
+  for (int domino = 0; domino < m_transforms.size(); ++domino)
+    dominoes.push_back(builder.setTransform(m_transforms[domino]).create());
+}
+
+// -----------------------------------------------------------------------------
+// The curve goes from t = 0 to t = 1. A coarse pass measures it, then it is
+// walked in steps a fraction of the spacing long, a domino every spacing.
+void DominoLayout::traceCurve(
+    const std::function<btVector3(btScalar)> &curve) {
+  btScalar length = 0;
+  btVector3 previous = curve(0);
+  for (int sample = 1; sample <= MIN_SAMPLES; ++sample) {
+    const btVector3 point = curve(btScalar(sample) / MIN_SAMPLES);
+    length += point.distance(previous);
+    previous = point;
+  }
+  const int samplesNumber = std::max(
+      MIN_SAMPLES, static_cast<int>(length / m_spacing) * SAMPLES_PER_DOMINO);
+  reserve(getDominoesNumber() + static_cast<int>(length / m_spacing) + 1);
+
+  previous = curve(0);
+  addDomino(previous, curve(btScalar(1) / samplesNumber) - previous, true);
+  // Length left to walk to the next domino.
+  btScalar remaining = m_spacing;
+  for (int sample = 1; sample <= samplesNumber; ++sample) {
+    const btVector3 point = curve(btScalar(sample) / samplesNumber);
+    btVector3 position = previous;
+    btScalar segment = position.distance(point);
+    while (segment >= remaining) {
+      position = position.lerp(point, remaining / segment);
+      addDomino(position, point - previous, false);
+      segment -= remaining;
+      remaining = m_spacing;
+    }
+    remaining -= segment;
+    previous = point;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Turned about y so that its x axis, across the thin side, follows the path.
+void DominoLayout::addDomino(const btVector3 &position,
+                             const btVector3 &direction, bool first) {
+  const btScalar yaw = btAtan2(-direction.z(), direction.x());
+  const btQuaternion rotation(yaw, 0, first ? -m_tipAngle : 0);
+  m_transforms.push_back(btTransform(
+      rotation, position + btVector3(0, m_sides.y() / 2, 0)));
+}
@@ -63,8 +63,10 @@ Drawer::Drawer(glm::ivec2 screenSize)
 
 //-----------------------------------------------------------------------------
 Drawer::~Drawer() {
-  for (auto &iter : m_vaoWorldMap)
-    glDeleteVertexArrays(1, &iter.second);
+  for (auto &iter : m_vertexArrays) {
+    glDeleteVertexArrays(1, &iter.first);
+    glDeleteBuffers(iter.second.vboIds.size(), iter.second.vboIds.data());
+  }
 
   if (m_vboIds.size() > 0)
     glDeleteBuffers(m_vboIds.size(), m_vboIds.data());
@@ -100,9 +102,8 @@ void Drawer::fillObjectsVectors(const std::map<
     const std::string shaderName = x.first;
     auto objectVector = x.second;
 
-    if (shaderName == "phong") {
+    if (shaderName == "phong")
       m_phongObjects = objectVector;
-    }
 
     if (shaderName == "lightBulb") {
       m_lightBulbs = objectVector;
@@ -112,6 +113,107 @@ void Drawer::fillObjectsVectors(const std::map<
       m_phongNormalMappingObjects = objectVector;
     }
   }
+
+  for (auto objects :
+       {&m_phongObjects, &m_lightBulbs, &m_phongNormalMappingObjects}) {
+    for (size_t index = 0; index < objects->size(); ++index)
+      m_objectEntries[(*objects)[index]] = {objects, static_cast<int>(index),
+                                            -1, nullptr};
+  }
+  for (auto object : m_phongObjects)
+    addDynamicPhongObject(object);
+}
+
+//-----------------------------------------------------------------------------
+void Drawer::addObjects(const std::vector<const Object *> &objects,
+                        const std::string &shaderName) {
+  for (auto object : objects) {
+    createObjectTextures(object);
+    if (shaderName == "phong") {
+      addObject(object, m_phongObjects);
+      addDynamicPhongObject(object);
+      createPhongObjectGPUBuffers(object);
+    } else if (shaderName == "lightBulb") {
+      addObject(object, m_lightBulbs);
+      createLightBulbGPUBuffers(object);
+    } else if (shaderName == "phongNormalMapping") {
+      addObject(object, m_phongNormalMappingObjects);
+      createPhongNormalMappingObjectGPUBuffers(object);
+    } else {
+      std::cerr << "Drawer: unknown shader " << shaderName << "\n";
+      exit(1);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Drawer::addObject(const Object *object,
+                       std::vector<const Object *> &objects) {
+  m_objectEntries[object] = {&objects, static_cast<int>(objects.size()), -1,
+                             nullptr};
+  objects.push_back(object);
+}
+
+//-----------------------------------------------------------------------------
+void Drawer::addDynamicPhongObject(const Object *object) {
+  m_objectEntries.at(object).dynamicIndex = m_dynamicPhongObjects.size();
+  m_dynamicPhongObjects.push_back(object);
+}
+
+//-----------------------------------------------------------------------------
+// The last dynamic object takes its place.
+void Drawer::removeDynamicPhongObject(const Object *object) {
+  ObjectEntry &entry = m_objectEntries.at(object);
+  const Object *lastObject = m_dynamicPhongObjects.back();
+  m_dynamicPhongObjects[entry.dynamicIndex] = lastObject;
+  m_objectEntries.at(lastObject).dynamicIndex = entry.dynamicIndex;
+  m_dynamicPhongObjects.pop_back();
+  entry.dynamicIndex = -1;
+}
+
+//-----------------------------------------------------------------------------
+// The last object of the list takes the place of each object removed. The
+// light bulbs keep their order instead, it is the order of their lights.
+void Drawer::removeObjects(const std::vector<const Object *> &objects) {
+  for (auto object : objects) {
+    auto entryIter = m_objectEntries.find(object);
+    if (entryIter == m_objectEntries.end())
+      continue;
+    if (entryIter->second.batch != nullptr)
+      entryIter->second.batch->remove(object);
+    else if (entryIter->second.dynamicIndex >= 0)
+      removeDynamicPhongObject(object);
+
+    std::vector<const Object *> &list = *entryIter->second.objects;
+    const int index = entryIter->second.index;
+    if (&list == &m_lightBulbs) {
+      list.erase(list.begin() + index);
+      for (size_t next = index; next < list.size(); ++next)
+        m_objectEntries[list[next]].index = next;
+    } else {
+      list[index] = list.back();
+      m_objectEntries[list[index]].index = index;
+      list.pop_back();
+    }
+    m_objectEntries.erase(object);
+
+    m_textureMap.erase(object);
+    m_normalTextureMap.erase(object);
+    releaseVertexArray(object);
+  }
+  updateBatches();
+}
+
+//-----------------------------------------------------------------------------
+void Drawer::updateBatches() {
+  m_staticBatches.erase(
+      std::remove_if(m_staticBatches.begin(), m_staticBatches.end(),
+                     [](const std::unique_ptr<StaticBatch> &batch) {
+        return batch->isEmpty();
+      }),
+      m_staticBatches.end());
+  for (auto &batch : m_staticBatches)
+    batch->update();
 }
 
 //-----------------------------------------------------------------------------
@@ -185,8 +287,8 @@ void Drawer::createMirrorObjectGPUBuffers() {
   // Unbind.
   glBindVertexArray(0);
 
-  m_vaoWorldMap.insert(std::pair<const Object *, GLuint>(m_mirror, vaoId));
-  m_vboIds.insert(m_vboIds.end(), {vertexVBOId, indexVBOId, normalVBOId});
+  addVertexArray(m_mirror, vaoId, {vertexVBOId, indexVBOId, normalVBOId},
+                 nullptr);
 }
 
 //-----------------------------------------------------------------------------
@@ -202,12 +304,14 @@ void Drawer::createLightBulbGPUBuffers(const Object *object) {
   // Unbind.
   glBindVertexArray(0);
 
-  m_vaoWorldMap.insert(std::pair<const Object *, GLuint>(object, vaoId));
-  m_vboIds.insert(m_vboIds.end(), {vertexVBOId, indexVBOId});
+  addVertexArray(object, vaoId, {vertexVBOId, indexVBOId}, nullptr);
 }
 
 //-----------------------------------------------------------------------------
 void Drawer::createPhongObjectGPUBuffers(const Object *object) {
+  if (shareGeometryVAO(object, m_phongShader))
+    return;
+
   GLuint vaoId = 0;
   // Create VAO.
   glGenVertexArrays(1, &vaoId);
@@ -221,13 +325,16 @@ void Drawer::createPhongObjectGPUBuffers(const Object *object) {
   // Unbind.
   glBindVertexArray(0);
 
-  m_vaoWorldMap.insert(std::pair<const Object *, GLuint>(object, vaoId));
-  m_vboIds.insert(m_vboIds.end(),
-                  {vertexVBOId, indexVBOId, normalVBOId, textureVBOId});
+  addVertexArray(object, vaoId,
+                 {vertexVBOId, indexVBOId, normalVBOId, textureVBOId},
+                 &m_phongShader);
 }
 
 //-----------------------------------------------------------------------------
 void Drawer::createPhongNormalMappingObjectGPUBuffers(const Object *object) {
+  if (shareGeometryVAO(object, m_phongNormalShader))
+    return;
+
   GLuint vaoId = 0;
   // Create VAO.
   glGenVertexArrays(1, &vaoId);
@@ -242,9 +349,99 @@ void Drawer::createPhongNormalMappingObjectGPUBuffers(const Object *object) {
   // Unbind.
   glBindVertexArray(0);
 
+  addVertexArray(object, vaoId, {vertexVBOId, indexVBOId, normalVBOId,
+                                 textureVBOId, tangentVBOId},
+                 &m_phongNormalShader);
+}
+
+//-----------------------------------------------------------------------------
+// Thousands of dominoes built alike draw from a single set of buffers.
+bool Drawer::shareGeometryVAO(const Object *object,
+                              const ShaderProgram &shader) {
+  auto vaoIter = m_geometryVaoMap.find({&shader, object->getGeometry()});
+  if (vaoIter == m_geometryVaoMap.end())
+    return false;
+  m_vaoWorldMap.insert(
+      std::pair<const Object *, GLuint>(object, vaoIter->second));
+  ++m_vertexArrays.at(vaoIter->second).usersNumber;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void Drawer::addVertexArray(const Object *object, GLuint vaoId,
+                            std::vector<GLuint> vboIds,
+                            const ShaderProgram *geometryShader) {
   m_vaoWorldMap.insert(std::pair<const Object *, GLuint>(object, vaoId));
-  m_vboIds.insert(m_vboIds.end(), {vertexVBOId, indexVBOId, normalVBOId,
-                                   textureVBOId, tangentVBOId});
+  std::pair<const ShaderProgram *, const Geometry *> geometryKey(nullptr,
+                                                                 nullptr);
+  if (geometryShader != nullptr) {
+    geometryKey = {geometryShader, object->getGeometry()};
+    m_geometryVaoMap[geometryKey] = vaoId;
+  }
+  m_vertexArrays[vaoId] = {std::move(vboIds), 1, geometryKey};
+}
+
+//-----------------------------------------------------------------------------
+// A geometry built again later gets new buffers.
+void Drawer::releaseVertexArray(const Object *object) {
+  auto vaoIter = m_vaoWorldMap.find(object);
+  if (vaoIter == m_vaoWorldMap.end())
+    return;
+  GLuint vaoId = vaoIter->second;
+  m_vaoWorldMap.erase(vaoIter);
+
+  VertexArray &vertexArray = m_vertexArrays.at(vaoId);
+  if (--vertexArray.usersNumber > 0)
+    return;
+  if (vertexArray.geometryKey.first != nullptr)
+    m_geometryVaoMap.erase(vertexArray.geometryKey);
+  glDeleteVertexArrays(1, &vaoId);
+  glDeleteBuffers(vertexArray.vboIds.size(), vertexArray.vboIds.data());
+  m_vertexArrays.erase(vaoId);
+}
+
+//-----------------------------------------------------------------------------
+// An object frozen and thawed since the last call is listed twice, its flag
+// is the last word.
+void Drawer::updateStaticBatches(World *world) {
+  world->takeFrozenChanges(m_frozenChanges);
+  if (m_frozenChanges.empty())
+    return;
+
+  for (auto object : m_frozenChanges) {
+    auto entryIter = m_objectEntries.find(object);
+    if (entryIter == m_objectEntries.end() ||
+        entryIter->second.objects != &m_phongObjects)
+      continue;
+    ObjectEntry &entry = entryIter->second;
+
+    if (!object->isFrozen()) {
+      if (entry.batch == nullptr)
+        continue;
+      entry.batch->remove(object);
+      entry.batch = nullptr;
+      addDynamicPhongObject(object);
+      continue;
+    }
+    if (entry.batch != nullptr)
+      continue;
+
+    GLuint texture = m_textureMap.at(object);
+    auto batchIter =
+        std::find_if(m_staticBatches.begin(), m_staticBatches.end(),
+                     [&](const std::unique_ptr<StaticBatch> &batch) {
+          return batch->accepts(object, texture);
+        });
+    if (batchIter == m_staticBatches.end())
+      batchIter = m_staticBatches.insert(
+          m_staticBatches.end(),
+          std::unique_ptr<StaticBatch>(
+              new StaticBatch(object, texture, m_phongShader)));
+    removeDynamicPhongObject(object);
+    (*batchIter)->add(object);
+    entry.batch = batchIter->get();
+  }
+  updateBatches();
 }
 
 //-----------------------------------------------------------------------------
@@ -448,10 +645,12 @@ void Drawer::drawPhongObjects(const World *world,
 
   m_phongShader.useProgram();
   setPhongLights(world, m_phongShader, originalModelView, lightMask);
-  for (const auto &obj : m_phongObjects) {
+  for (const auto &obj : m_dynamicPhongObjects) {
     drawPhongObject(obj, originalModelView, projection, originalShadowModelView,
                     shadowProjection);
   }
+  for (const auto &batch : m_staticBatches)
+    drawStaticBatch(*batch, originalModelView, projection);
 
   //  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -582,7 +781,7 @@ void Drawer::setPhongLights(const World *world, const PhongShader &shader,
   shader.setUniform(PhongShader::lightMask, lightMask);
   std::for_each(
       constBeginLights(*world), constEndLights(*world),
-      [&](const Light *light) { light->setUniforms(shader, modelView); });
+      [&](const Light *light) { shader.setLightUniforms(*light, modelView); });
 }
 //-----------------------------------------------------------------------------
 void Drawer::setPhongLights(const World *world,
@@ -595,7 +794,7 @@ void Drawer::setPhongLights(const World *world,
   shader.setUniform(PhongNormalMappingShader::lightMask, lightMask);
   std::for_each(
       constBeginLights(*world), constEndLights(*world),
-      [&](const Light *light) { light->setUniforms(shader, modelView); });
+      [&](const Light *light) { shader.setLightUniforms(*light, modelView); });
 }
 
 //-----------------------------------------------------------------------------
@@ -617,6 +816,26 @@ void Drawer::drawPhongObject(const Object *object,
   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+//-----------------------------------------------------------------------------
+// The batched vertices are already in world space.
+void Drawer::drawStaticBatch(const StaticBatch &batch,
+                             const glm::mat4 &originalModelView,
+                             const glm::mat4 &projection) const {
+  setColors(batch.getMaterial(), m_phongShader);
+  m_phongShader.setUniform(PhongShader::mvpMatrix,
+                           projection * originalModelView);
+  m_phongShader.setUniform(PhongShader::modelViewMatrix, originalModelView);
+  m_phongShader.setUniform(PhongShader::normalMatrix,
+                           glm::inverseTranspose(glm::mat3(originalModelView)));
+  glBindTexture(GL_TEXTURE_2D, batch.getTexture());
+  checkOpenGLError("drawStaticBatch: glBindTexture");
+
+  m_phongShader.setUniform(PhongShader::texture, 0);
+
+  batch.draw();
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 //-----------------------------------------------------------------------------
 void Drawer::drawPhongNormalMappingObject(
     const Object *object, const glm::mat4 &originalModelView,
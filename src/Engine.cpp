@@ -1,37 +1,468 @@
 #include "Engine.h"
 
+#include "IslandDynamicsWorld.h"
+#include "ParallelDbvtBroadphase.h"
+#include "ParallelDynamicsWorld.h"
+#include "SimdContactSolver.h"
+#include "ThreadPool.h"
+
+#include <BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
+#include <BulletDynamics/MLCPSolvers/btDantzigSolver.h>
+#include <BulletDynamics/MLCPSolvers/btMLCPSolver.h>
+#include <BulletDynamics/MLCPSolvers/btSolveProjectedGaussSeidel.h>
 #include <LinearMath/btVector3.h>
 
+#ifdef MULTITHREADED_PHYSICS
+#include <BulletMultiThreaded/PosixThreadSupport.h>
+#include <BulletMultiThreaded/SpuGatheringCollisionDispatcher.h>
+#include <BulletMultiThreaded/SpuNarrowPhaseCollisionTask/SpuGatheringCollisionTask.h>
+#include <BulletMultiThreaded/btParallelConstraintSolver.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <iostream>
+#include <unordered_set>
+#include <vector>
 
-Engine::Engine() {
-  m_broadphase = new btDbvtBroadphase();
-  m_collisionConfiguration = new btDefaultCollisionConfiguration();
-  m_collisionDispatcher = new btCollisionDispatcher(m_collisionConfiguration);
-  m_constraintSolver = new btSequentialImpulseConstraintSolver();
-  m_dynamicsWorld =
-      new btDiscreteDynamicsWorld(m_collisionDispatcher, m_broadphase,
-                                  m_constraintSolver, m_collisionConfiguration);
-}
+// Support functions.
+// -----------------------------------------------------------------------------
+// Whether the filters of two proxies let them pair, as the pair cache tests.
+bool acceptsPair(const btBroadphaseProxy *proxy0,
+                 const btBroadphaseProxy *proxy1);
+// A node of a dbvt allocated as btDbvt does, for it to free. A leaf unless
+// given children.
+btDbvtNode *createDbvtNode(const btDbvtVolume &volume, void *data);
+// A leaf of a dbvt along with its center, for the build to sort.
+struct DbvtLeaf {
+  btVector3 center;
+  btDbvtNode *node;
+};
+// Builds a balanced subtree of the leaves, reordering them: each node splits
+// its leaves at the median of their centers, along the axis they spread the
+// most on.
+btDbvtNode *buildDbvtSubtree(DbvtLeaf *leaves, int leavesNumber);
+
+// Matches the pairs of the bodies being removed.
+class RemovedPairsCallback : public btOverlapCallback {
+public:
+  RemovedPairsCallback(
+      const std::unordered_set<const btCollisionObject *> &removedBodies)
+      : m_removedBodies(removedBodies) {}
+
+private:
+  const std::unordered_set<const btCollisionObject *> &m_removedBodies;
+
+public:
+  virtual bool processOverlap(btBroadphasePair &pair) override {
+    return m_removedBodies.count(static_cast<const btCollisionObject *>(
+               pair.m_pProxy0->m_clientObject)) != 0 ||
+           m_removedBodies.count(static_cast<const btCollisionObject *>(
+               pair.m_pProxy1->m_clientObject)) != 0;
+  }
+};
+
+// Matches the pairs the filters of their proxies reject.
+class RejectedPairsCallback : public btOverlapCallback {
+public:
+  virtual bool processOverlap(btBroadphasePair &pair) override {
+    return !acceptsPair(pair.m_pProxy0, pair.m_pProxy1);
+  }
+};
+
+// Brings the pairs of a proxy in line with its filter, for the proxies found
+// around it.
+class FilteredPairsCallback : public btBroadphaseAabbCallback {
+public:
+  FilteredPairsCallback(btBroadphaseProxy *proxy,
+                        btOverlappingPairCache *pairCache,
+                        btDispatcher *dispatcher)
+      : m_proxy(proxy), m_pairCache(pairCache), m_dispatcher(dispatcher) {}
+
+private:
+  btBroadphaseProxy *m_proxy;
+  btOverlappingPairCache *m_pairCache;
+  btDispatcher *m_dispatcher;
+
+public:
+  virtual bool process(const btBroadphaseProxy *proxy) override {
+    if (proxy == m_proxy)
+      return true;
+    auto other = const_cast<btBroadphaseProxy *>(proxy);
+    const bool paired = m_pairCache->findPair(m_proxy, other) != nullptr;
+    const bool accepted = acceptsPair(m_proxy, other);
+    if (paired && !accepted)
+      m_pairCache->removeOverlappingPair(m_proxy, other, m_dispatcher);
+    else if (!paired && accepted)
+      m_pairCache->addOverlappingPair(m_proxy, other);
+    return true;
+  }
+};
+
+// Pairs the overlapping leaves of two subtrees of the dbvt, or of a subtree
+// with itself.
+class SubtreePairsCollider : public btDbvt::ICollide {
+public:
+  explicit SubtreePairsCollider(btOverlappingPairCache *pairCache)
+      : m_pairCache(pairCache) {}
+
+private:
+  btOverlappingPairCache *m_pairCache;
+
+public:
+  virtual void Process(const btDbvtNode *leaf0,
+                       const btDbvtNode *leaf1) override {
+    m_pairCache->addOverlappingPair(static_cast<btDbvtProxy *>(leaf0->data),
+                                    static_cast<btDbvtProxy *>(leaf1->data));
+  }
+};
 
+#ifdef MULTITHREADED_PHYSICS
+// The parallel solver addresses contacts by their index in the manifold pool,
+// so the pool has to be contiguous and cannot grow at runtime.
+static const int MAX_PERSISTENT_MANIFOLDS = 1 << 17;
+#endif
+
+const int Engine::AXIS_SWEEP_MAX_HANDLES;
+const int Engine::DEFAULT_BROADPHASE_CAPACITY;
+const btVector3 Engine::DEFAULT_WORLD_MIN(-1000, -1000, -1000);
+const btVector3 Engine::DEFAULT_WORLD_MAX(1000, 1000, 1000);
+const int Engine::DEFAULT_SOLVER_ITERATIONS;
+const btScalar Engine::PENETRATION_TOLERANCE = 0.01;
+
+Engine::Engine() { createDynamicsWorld(); }
+
+// The bodies belong to the objects.
 Engine::~Engine() {
-  btCollisionObjectArray objectsArray = m_dynamicsWorld->getCollisionObjectArray();
-  int objNumber = m_dynamicsWorld->getNumCollisionObjects();
+  releaseProxies();
+  destroyDynamicsWorld();
+}
 
-  // Delete all rigid bodies removing them from the world.
-  for (int index = 0; index < objNumber; ++index) {
-    btCollisionObject* obj = objectsArray[index];
-    m_dynamicsWorld->removeCollisionObject(obj);
-    delete obj;
+// -----------------------------------------------------------------------------
+btBroadphaseInterface *Engine::createBroadphase() const {
+  // Nothing casts rays through the broadphase, the sweep and prune variants
+  // would keep a whole dbvt next to their own axes for that.
+  // The dbvt finds its pairs in the same order whatever the threads, one
+  // included.
+  switch (m_broadphaseType) {
+  case BroadphaseType::bpDbvt:
+    break;
+  case BroadphaseType::bpAxisSweep:
+    return new btAxisSweep3(
+        m_worldMin, m_worldMax,
+        static_cast<unsigned short>(m_broadphaseCapacity), nullptr, true);
+  case BroadphaseType::bpAxisSweep32:
+    return new bt32BitAxisSweep3(m_worldMin, m_worldMax, m_broadphaseCapacity,
+                                 nullptr, true);
+  case BroadphaseType::bpSimple:
+    return new btSimpleBroadphase(m_broadphaseCapacity);
   }
+  return new ParallelDbvtBroadphase(*m_threadPool);
+}
+
+// -----------------------------------------------------------------------------
+// Give the fixed size broadphases room for twice the bodies. Past its handle
+// limit the 16 bit sweep and prune is replaced by the 32 bit one.
+void Engine::reserveBroadphase(int bodiesNumber) {
+  if (m_broadphaseType == BroadphaseType::bpAxisSweep &&
+      bodiesNumber >= AXIS_SWEEP_MAX_HANDLES) {
+    std::cerr << "More than " << AXIS_SWEEP_MAX_HANDLES
+              << " bodies: using the 32 bit sweep and prune broadphase.\n";
+    m_broadphaseType = BroadphaseType::bpAxisSweep32;
+  }
+
+  m_broadphaseCapacity =
+      std::max(DEFAULT_BROADPHASE_CAPACITY, 2 * bodiesNumber);
+  if (m_broadphaseType == BroadphaseType::bpAxisSweep)
+    m_broadphaseCapacity =
+        std::min(m_broadphaseCapacity, AXIS_SWEEP_MAX_HANDLES);
+}
+
+// -----------------------------------------------------------------------------
+void Engine::createDynamicsWorld() {
+  m_threadPool = new ThreadPool(m_threadsNumber);
+  m_broadphase = createBroadphase();
+  m_builtBroadphaseType = m_broadphaseType;
+
+  btDefaultCollisionConstructionInfo constructionInfo;
+#ifdef MULTITHREADED_PHYSICS
+  if (m_solverType == SolverType::stBatches)
+    constructionInfo.m_defaultMaxPersistentManifoldPoolSize =
+        MAX_PERSISTENT_MANIFOLDS;
+#endif
+  m_collisionConfiguration =
+      new btDefaultCollisionConfiguration(constructionInfo);
+
+#ifdef MULTITHREADED_PHYSICS
+  if (m_threadsNumber > 1) {
+    PosixThreadSupport::ThreadConstructionInfo collisionInfo(
+        "collision", processCollisionTask, createCollisionLocalStoreMemory,
+        m_threadsNumber);
+    m_collisionThreadSupport = new PosixThreadSupport(collisionInfo);
+    m_collisionDispatcher = new SpuGatheringCollisionDispatcher(
+        m_collisionThreadSupport, m_threadsNumber, m_collisionConfiguration);
+  } else
+#endif
+    m_collisionDispatcher = new btCollisionDispatcher(m_collisionConfiguration);
 
+  switch (m_solverType) {
+  case SolverType::stSequential:
+    m_constraintSolver = new btSequentialImpulseConstraintSolver();
+    m_dynamicsWorld = new ParallelDynamicsWorld(
+        m_collisionDispatcher, m_broadphase, m_constraintSolver,
+        m_collisionConfiguration, *m_threadPool);
+    break;
+  case SolverType::stIslands: {
+    auto solver = new btSequentialImpulseConstraintSolver();
+    m_constraintSolver = solver;
+    m_dynamicsWorld = new IslandDynamicsWorld(
+        m_collisionDispatcher, m_broadphase, solver, m_collisionConfiguration,
+        *m_threadPool);
+    break;
+  }
+  case SolverType::stBatches: {
+#ifdef MULTITHREADED_PHYSICS
+    PosixThreadSupport::ThreadConstructionInfo solverInfo(
+        "solver", SolverThreadFunc, SolverlsMemoryFunc, m_threadsNumber);
+    m_solverThreadSupport = new PosixThreadSupport(solverInfo);
+    m_constraintSolver = new btParallelConstraintSolver(m_solverThreadSupport);
+    m_collisionDispatcher->setDispatcherFlags(
+        btCollisionDispatcher::CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION);
+    m_dynamicsWorld = new ParallelDynamicsWorld(
+        m_collisionDispatcher, m_broadphase, m_constraintSolver,
+        m_collisionConfiguration, *m_threadPool);
+    // The parallel solver batches the whole world by itself.
+    m_dynamicsWorld->getSimulationIslandManager()->setSplitIslands(false);
+#endif
+    break;
+  }
+  case SolverType::stDantzig:
+  case SolverType::stProjectedGaussSeidel:
+    if (m_solverType == SolverType::stDantzig)
+      m_mlcpSolver = new btDantzigSolver();
+    else
+      m_mlcpSolver = new btSolveProjectedGaussSeidel();
+    m_constraintSolver = new btMLCPSolver(m_mlcpSolver);
+    m_dynamicsWorld = new ParallelDynamicsWorld(
+        m_collisionDispatcher, m_broadphase, m_constraintSolver,
+        m_collisionConfiguration, *m_threadPool);
+    // The matrix grows with the square of the batch, solve islands alone.
+    m_dynamicsWorld->getSolverInfo().m_minimumSolverBatchSize = 1;
+    break;
+  case SolverType::stSimd:
+    m_constraintSolver = new SimdContactSolver();
+    m_dynamicsWorld = new ParallelDynamicsWorld(
+        m_collisionDispatcher, m_broadphase, m_constraintSolver,
+        m_collisionConfiguration, *m_threadPool);
+    break;
+  }
+  m_dynamicsWorld->getSolverInfo().m_numIterations = m_solverIterations;
+}
+
+// -----------------------------------------------------------------------------
+void Engine::destroyDynamicsWorld() {
   delete m_dynamicsWorld;
   delete m_constraintSolver;
-  delete m_collisionConfiguration;
+  delete m_mlcpSolver;
   delete m_collisionDispatcher;
+  delete m_collisionConfiguration;
   delete m_broadphase;
+#ifdef MULTITHREADED_PHYSICS
+  // Thread pools are stopped last, nothing uses them anymore.
+  delete m_solverThreadSupport;
+  delete m_collisionThreadSupport;
+#endif
+  delete m_threadPool;
+
+  m_dynamicsWorld = nullptr;
+  m_constraintSolver = nullptr;
+  m_mlcpSolver = nullptr;
+  m_collisionDispatcher = nullptr;
+  m_collisionConfiguration = nullptr;
+  m_broadphase = nullptr;
+  m_solverThreadSupport = nullptr;
+  m_collisionThreadSupport = nullptr;
+  m_threadPool = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+void Engine::setThreadsNumber(int threadsNumber) {
+  if (threadsNumber < 1)
+    threadsNumber = 1;
+  if (threadsNumber == m_threadsNumber)
+    return;
+
+  m_threadsNumber = threadsNumber;
+  rebuildDynamicsWorld();
+}
+
+// -----------------------------------------------------------------------------
+// Take the broadphase proxies away from all the bodies, so that the world can
+// be destroyed without removing them one at a time: every removal searches
+// the bodies and the pairs.
+void Engine::releaseProxies() {
+  btOverlappingPairCache *pairCache = m_broadphase->getOverlappingPairCache();
+  btBroadphasePairArray &pairs = pairCache->getOverlappingPairArray();
+  while (pairs.size() > 0) {
+    const btBroadphasePair &pair = pairs[pairs.size() - 1];
+    pairCache->removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1,
+                                     m_collisionDispatcher);
+  }
+
+  // The other broadphases keep their proxies in arrays of their own.
+  bool ownsProxies = m_builtBroadphaseType == BroadphaseType::bpDbvt;
+  btCollisionObjectArray &objectsArray =
+      m_dynamicsWorld->getCollisionObjectArray();
+  for (int index = 0; index < objectsArray.size(); ++index) {
+    btCollisionObject *object = objectsArray[index];
+    if (ownsProxies)
+      m_broadphase->destroyProxy(object->getBroadphaseHandle(),
+                                 m_collisionDispatcher);
+    object->setBroadphaseHandle(nullptr);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void Engine::removeAllRigidBodies() {
+  btVector3 gravity = m_dynamicsWorld->getGravity();
+
+  releaseProxies();
+  destroyDynamicsWorld();
+  createDynamicsWorld();
+
+  m_dynamicsWorld->setGravity(gravity);
+}
+
+// -----------------------------------------------------------------------------
+// Move the bodies over to a world built with the new configuration, in the
+// same order. The frozen bodies are the static ones the old world moves.
+void Engine::rebuildDynamicsWorld() {
+  const btAlignedObjectArray<btRigidBody *> &nonStaticBodies =
+      m_dynamicsWorld->getNonStaticRigidBodies();
+  std::unordered_set<const btRigidBody *> dynamicBodies;
+  dynamicBodies.reserve(nonStaticBodies.size());
+  for (int index = 0; index < nonStaticBodies.size(); ++index)
+    dynamicBodies.insert(nonStaticBodies[index]);
+
+  btAlignedObjectArray<btRigidBody *> bodies;
+  btAlignedObjectArray<CollisionFilter> filters;
+  btAlignedObjectArray<bool> dynamic;
+  btCollisionObjectArray &objectsArray = m_dynamicsWorld->getCollisionObjectArray();
+  for (int index = 0; index < objectsArray.size(); ++index) {
+    bodies.push_back(btRigidBody::upcast(objectsArray[index]));
+    filters.push_back(getCollisionFilter(objectsArray[index]));
+    dynamic.push_back(dynamicBodies.count(bodies[index]) != 0);
+  }
+  btVector3 gravity = m_dynamicsWorld->getGravity();
+
+  releaseProxies();
+  destroyDynamicsWorld();
+  createDynamicsWorld();
+
+  m_dynamicsWorld->setGravity(gravity);
+  if (bodies.size() > 0)
+    addRigidBodies(&bodies[0], &filters[0], &dynamic[0], bodies.size());
 }
 
+// -----------------------------------------------------------------------------
+void Engine::setSolverType(SolverType solverType) {
+#ifndef MULTITHREADED_PHYSICS
+  if (solverType == SolverType::stBatches) {
+    std::cerr << "Batched solver ignored: build with MULTITHREADED_PHYSICS.\n";
+    return;
+  }
+#endif
+  if (solverType == m_solverType)
+    return;
+
+  m_solverType = solverType;
+  rebuildDynamicsWorld();
+}
+
+// -----------------------------------------------------------------------------
+void Engine::setBroadphaseType(BroadphaseType broadphaseType) {
+  if (broadphaseType == m_broadphaseType)
+    return;
+
+  m_broadphaseType = broadphaseType;
+  reserveBroadphase(m_dynamicsWorld->getNumCollisionObjects());
+  rebuildDynamicsWorld();
+}
+
+// -----------------------------------------------------------------------------
+void Engine::setWorldBounds(const btVector3 &worldMin,
+                            const btVector3 &worldMax) {
+  m_worldMin = worldMin;
+  m_worldMax = worldMax;
+  if (m_broadphaseType == BroadphaseType::bpAxisSweep ||
+      m_broadphaseType == BroadphaseType::bpAxisSweep32)
+    rebuildDynamicsWorld();
+}
+
+// -----------------------------------------------------------------------------
+void Engine::setSolverIterations(int minIterations, int maxIterations,
+                                 double stepBudget) {
+  assert(0 < minIterations && minIterations <= maxIterations &&
+         "Wrong solver iterations bounds");
+  assert(stepBudget >= 0 && "The step budget cannot be negative");
+  m_minSolverIterations = minIterations;
+  m_maxSolverIterations = maxIterations;
+  m_stepBudget = stepBudget;
+  m_solverIterations =
+      std::max(minIterations, std::min(m_solverIterations, maxIterations));
+  m_dynamicsWorld->getSolverInfo().m_numIterations = m_solverIterations;
+}
+
+// -----------------------------------------------------------------------------
+void Engine::stepSimulation(btScalar timeStep) {
+  typedef std::chrono::steady_clock Clock;
+
+  // One Bullet substep per call, so that Bullet neither accumulates time nor
+  // interpolates the motion states on its own.
+  Clock::time_point begin = Clock::now();
+  m_dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+  if (m_minSolverIterations < m_maxSolverIterations)
+    adaptSolverIterations(
+        std::chrono::duration<double>(Clock::now() - begin).count());
+}
+
+// -----------------------------------------------------------------------------
+// A quarter more iterations at a time while the contacts penetrate, one less
+// at a time once they are well within the tolerance. The contacts between
+// sleeping bodies are not solved, they do not count.
+void Engine::adaptSolverIterations(double stepTime) {
+  btDispatcher *dispatcher = m_dynamicsWorld->getDispatcher();
+  int contactsNumber = 0;
+  btScalar penetration = 0;
+  for (int index = 0; index < dispatcher->getNumManifolds(); ++index) {
+    const btPersistentManifold *manifold =
+        dispatcher->getManifoldByIndexInternal(index);
+    if (!manifold->getBody0()->isActive() && !manifold->getBody1()->isActive())
+      continue;
+    for (int contact = 0; contact < manifold->getNumContacts(); ++contact) {
+      penetration = std::max(
+          penetration, -manifold->getContactPoint(contact).getDistance());
+      ++contactsNumber;
+    }
+  }
+
+  int iterations = m_solverIterations;
+  if (contactsNumber == 0)
+    iterations = m_minSolverIterations;
+  else if (m_stepBudget > 0 && stepTime > m_stepBudget)
+    iterations = static_cast<int>(iterations * m_stepBudget / stepTime);
+  else if (penetration > PENETRATION_TOLERANCE)
+    iterations += std::max(1, iterations / 4);
+  else if (penetration < PENETRATION_TOLERANCE / 4)
+    --iterations;
+
+  m_solverIterations = std::max(m_minSolverIterations,
+                                std::min(iterations, m_maxSolverIterations));
+  m_dynamicsWorld->getSolverInfo().m_numIterations = m_solverIterations;
+}
+
+// -----------------------------------------------------------------------------
 void Engine::setGravity(const btVector3& gravity) {
   m_gravity = gravity;
   m_dynamicsWorld->setGravity(gravity);
@@ -42,6 +473,305 @@ btDiscreteDynamicsWorld* Engine::getDynamicsWorld() const {
   return m_dynamicsWorld;
 }
 
-void Engine::addRigidBody(btRigidBody* rigidBody) {
-  m_dynamicsWorld->addRigidBody(rigidBody);
+// -----------------------------------------------------------------------------
+void Engine::addRigidBody(btRigidBody *rigidBody,
+                          const CollisionFilter &filter, bool dynamic) {
+  int bodiesNumber = m_dynamicsWorld->getNumCollisionObjects();
+  if (m_broadphaseType != BroadphaseType::bpDbvt &&
+      bodiesNumber >= m_broadphaseCapacity) {
+    reserveBroadphase(bodiesNumber + 1);
+    rebuildDynamicsWorld();
+  }
+  addToWorld(rigidBody, filter, dynamic);
+}
+
+// -----------------------------------------------------------------------------
+void Engine::addRigidBodies(btRigidBody *const *rigidBodies,
+                            const CollisionFilter *filters,
+                            const bool *dynamic, int bodiesNumber) {
+  if (bodiesNumber == 0)
+    return;
+  int totalNumber = m_dynamicsWorld->getNumCollisionObjects() + bodiesNumber;
+  if (m_broadphaseType != BroadphaseType::bpDbvt &&
+      totalNumber > m_broadphaseCapacity) {
+    reserveBroadphase(totalNumber);
+    rebuildDynamicsWorld();
+  }
+  m_dynamicsWorld->getCollisionObjectArray().reserve(totalNumber);
+  if (m_builtBroadphaseType != BroadphaseType::bpDbvt) {
+    for (int index = 0; index < bodiesNumber; ++index)
+      addToWorld(rigidBodies[index], filters[index], dynamic[index]);
+    return;
+  }
+
+  // The bodies keep their order in the world, only their leaves are held
+  // out of the tree. Inserted one by one, each would descend the whole tree
+  // and in spatial order they would degrade it into a list: they go back in
+  // as a subtree built top down, next to the leaves already there.
+  auto broadphase = static_cast<btDbvtBroadphase *>(m_broadphase);
+  btDbvt &tree = broadphase->m_sets[0];
+  const bool deferredCollide = broadphase->m_deferedcollide;
+  broadphase->m_deferedcollide = true;
+  std::vector<DbvtLeaf> leaves;
+  leaves.reserve(bodiesNumber);
+  for (int index = 0; index < bodiesNumber; ++index) {
+    addToWorld(rigidBodies[index], filters[index], dynamic[index]);
+    auto proxy =
+        static_cast<btDbvtProxy *>(rigidBodies[index]->getBroadphaseHandle());
+    tree.remove(proxy->leaf);
+    proxy->leaf = createDbvtNode(
+        btDbvtVolume::FromMM(proxy->m_aabbMin, proxy->m_aabbMax), proxy);
+    leaves.push_back({proxy->leaf->volume.Center(), proxy->leaf});
+  }
+  broadphase->m_deferedcollide = deferredCollide;
+
+  btDbvtNode *subtree = buildDbvtSubtree(leaves.data(), bodiesNumber);
+  btDbvtNode *root = tree.m_root;
+  if (root != nullptr) {
+    btDbvtVolume volume;
+    Merge(root->volume, subtree->volume, volume);
+    tree.m_root = createDbvtNode(volume, nullptr);
+    tree.m_root->childs[0] = root;
+    tree.m_root->childs[1] = subtree;
+    root->parent = tree.m_root;
+    subtree->parent = tree.m_root;
+  } else {
+    tree.m_root = subtree;
+  }
+  tree.m_leaves += bodiesNumber;
+
+  // The new leaves pair with each other, and with the leaves of both trees
+  // in one pass each instead of a lookup per leaf.
+  SubtreePairsCollider collider(broadphase->m_paircache);
+  tree.collideTTpersistentStack(subtree, subtree, collider);
+  tree.collideTTpersistentStack(subtree, root, collider);
+  broadphase->m_sets[1].collideTTpersistentStack(
+      subtree, broadphase->m_sets[1].m_root, collider);
+}
+
+// -----------------------------------------------------------------------------
+// A frozen body is static for Bullet, which would neither give it the gravity
+// nor move it once thawed.
+void Engine::addToWorld(btRigidBody *rigidBody, const CollisionFilter &filter,
+                        bool dynamic) {
+  const int flags = rigidBody->getCollisionFlags();
+  if (dynamic)
+    rigidBody->setCollisionFlags(flags & ~btCollisionObject::CF_STATIC_OBJECT);
+  m_dynamicsWorld->addRigidBody(rigidBody, filter.group, filter.mask);
+  rigidBody->setCollisionFlags(flags);
+}
+
+// -----------------------------------------------------------------------------
+void Engine::removeRigidBody(btRigidBody *rigidBody) {
+  m_dynamicsWorld->removeRigidBody(rigidBody);
+}
+
+// -----------------------------------------------------------------------------
+// The pairs of the bodies go first, along with their contact manifolds. The
+// dbvt then destroys the proxies against an empty pair cache, instead of
+// searching all the pairs again for each of them.
+void Engine::removeRigidBodies(btRigidBody *const *rigidBodies,
+                               int bodiesNumber) {
+  if (bodiesNumber == 0)
+    return;
+  const std::unordered_set<const btCollisionObject *> removedBodies(
+      rigidBodies, rigidBodies + bodiesNumber);
+
+  RemovedPairsCallback removedPairs(removedBodies);
+  m_broadphase->getOverlappingPairCache()->processAllOverlappingPairs(
+      &removedPairs, m_collisionDispatcher);
+
+  btNullPairCache emptyPairCache;
+  btOverlappingPairCache *pairCache = nullptr;
+  if (m_builtBroadphaseType == BroadphaseType::bpDbvt) {
+    auto broadphase = static_cast<btDbvtBroadphase *>(m_broadphase);
+    pairCache = broadphase->m_paircache;
+    broadphase->m_paircache = &emptyPairCache;
+  }
+  for (int index = 0; index < bodiesNumber; ++index) {
+    m_broadphase->destroyProxy(rigidBodies[index]->getBroadphaseHandle(),
+                               m_collisionDispatcher);
+    rigidBodies[index]->setBroadphaseHandle(nullptr);
+  }
+  if (pairCache != nullptr)
+    static_cast<btDbvtBroadphase *>(m_broadphase)->m_paircache = pairCache;
+
+  m_dynamicsWorld->removeRigidBodies(removedBodies);
+}
+
+// -----------------------------------------------------------------------------
+// The body is converted in place: taking it out of the world and back in
+// costs a linear search through all the bodies and all the pairs.
+void Engine::freezeRigidBody(btRigidBody *rigidBody) {
+  // A null mass marks the body as static.
+  rigidBody->setMassProps(0, btVector3(0, 0, 0));
+  rigidBody->setLinearVelocity(btVector3(0, 0, 0));
+  rigidBody->setAngularVelocity(btVector3(0, 0, 0));
+  rigidBody->updateInertiaTensor();
+  rigidBody->setActivationState(ISLAND_SLEEPING);
+}
+
+// -----------------------------------------------------------------------------
+void Engine::thawRigidBody(btRigidBody *rigidBody, btScalar mass,
+                           const btVector3 &inertia) {
+  // The gravity force follows the mass, the acceleration was kept.
+  rigidBody->setMassProps(mass, inertia);
+  rigidBody->updateInertiaTensor();
+  rigidBody->activate(true);
+}
+
+// -----------------------------------------------------------------------------
+void Engine::resetContacts() {
+  btOverlappingPairCache *pairCache = m_broadphase->getOverlappingPairCache();
+  btBroadphasePairArray &pairs = pairCache->getOverlappingPairArray();
+  for (int index = 0; index < pairs.size(); ++index)
+    pairCache->cleanOverlappingPair(pairs[index], m_collisionDispatcher);
+}
+
+// -----------------------------------------------------------------------------
+CollisionFilter Engine::getCollisionFilter(const btCollisionObject *object) {
+  const btBroadphaseProxy *proxy = object->getBroadphaseHandle();
+  assert(proxy != nullptr && "The body is not in a world");
+  return {proxy->m_collisionFilterGroup, proxy->m_collisionFilterMask};
+}
+
+// -----------------------------------------------------------------------------
+// The dbvt looks the proxies around a body up in its trees. The other
+// broadphases go through all their proxies for that: they drop the rejected
+// pairs in one pass over the pairs instead, and only look around the bodies
+// whose mask gained bits. Freezing a body narrows both its group and its
+// mask, only a thaw has pairs to add.
+void Engine::setCollisionFilters(btRigidBody *const *rigidBodies,
+                                 const CollisionFilter *filters,
+                                 int bodiesNumber) {
+  const bool dbvt = m_builtBroadphaseType == BroadphaseType::bpDbvt;
+  std::vector<btBroadphaseProxy *> lookedUpProxies;
+  bool narrowed = false;
+  for (int index = 0; index < bodiesNumber; ++index) {
+    btBroadphaseProxy *proxy = rigidBodies[index]->getBroadphaseHandle();
+    assert(proxy != nullptr && "The body is not in a world");
+    const CollisionFilter &filter = filters[index];
+    if (filter.group == proxy->m_collisionFilterGroup &&
+        filter.mask == proxy->m_collisionFilterMask)
+      continue;
+    if (dbvt || (filter.mask & ~proxy->m_collisionFilterMask) != 0)
+      lookedUpProxies.push_back(proxy);
+    else
+      narrowed = true;
+    proxy->m_collisionFilterGroup = filter.group;
+    proxy->m_collisionFilterMask = filter.mask;
+  }
+
+  btOverlappingPairCache *pairCache = m_broadphase->getOverlappingPairCache();
+  if (narrowed) {
+    RejectedPairsCallback rejectedPairs;
+    pairCache->processAllOverlappingPairs(&rejectedPairs,
+                                          m_collisionDispatcher);
+  }
+  for (auto proxy : lookedUpProxies) {
+    btVector3 aabbMin;
+    btVector3 aabbMax;
+    if (dbvt) {
+      const btDbvtNode *leaf = static_cast<btDbvtProxy *>(proxy)->leaf;
+      aabbMin = leaf->volume.Mins();
+      aabbMax = leaf->volume.Maxs();
+    } else {
+      m_broadphase->getAabb(proxy, aabbMin, aabbMax);
+    }
+    FilteredPairsCallback filteredPairs(proxy, pairCache,
+                                        m_collisionDispatcher);
+    m_broadphase->aabbTest(aabbMin, aabbMax, filteredPairs);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Count the dynamic bodies that Bullet has not put to sleep.
+int Engine::getActiveRigidBodiesNumber() const {
+  const btCollisionObjectArray &objectsArray =
+      m_dynamicsWorld->getCollisionObjectArray();
+  int activeNumber = 0;
+  for (int index = 0; index < objectsArray.size(); ++index) {
+    const btCollisionObject *obj = objectsArray[index];
+    if (obj->isActive() && !obj->isStaticOrKinematicObject())
+      ++activeNumber;
+  }
+  return activeNumber;
+}
+
+// -----------------------------------------------------------------------------
+int Engine::getManifoldsNumber() const {
+  return m_dynamicsWorld->getDispatcher()->getNumManifolds();
+}
+
+// -----------------------------------------------------------------------------
+// The step leaves the union find sorted by island, each island a run of
+// elements with the same id.
+int Engine::getAwakeIslandsNumber() const {
+  btSimulationIslandManager *islandManager =
+      m_dynamicsWorld->getSimulationIslandManager();
+  btUnionFind &unionFind = islandManager->getUnionFind();
+  const btCollisionObjectArray &objectsArray =
+      m_dynamicsWorld->getCollisionObjectArray();
+  int islandsNumber = 0;
+  int countedIsland = -1;
+  for (int index = 0; index < unionFind.getNumElements(); ++index) {
+    const btElement &element = unionFind.getElement(index);
+    if (element.m_id == countedIsland || element.m_sz >= objectsArray.size())
+      continue;
+    const btCollisionObject *object = objectsArray[element.m_sz];
+    if (object->isActive() && !object->isStaticOrKinematicObject()) {
+      countedIsland = element.m_id;
+      ++islandsNumber;
+    }
+  }
+  return islandsNumber;
+}
+
+// -----------------------------------------------------------------------------
+bool acceptsPair(const btBroadphaseProxy *proxy0,
+                 const btBroadphaseProxy *proxy1) {
+  return (proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) &&
+         (proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask);
+}
+
+// -----------------------------------------------------------------------------
+btDbvtNode *createDbvtNode(const btDbvtVolume &volume, void *data) {
+  btDbvtNode *node =
+      new (btAlignedAlloc(sizeof(btDbvtNode), 16)) btDbvtNode();
+  node->volume = volume;
+  node->parent = nullptr;
+  node->data = data;
+  node->childs[1] = nullptr;
+  return node;
+}
+
+// -----------------------------------------------------------------------------
+btDbvtNode *buildDbvtSubtree(DbvtLeaf *leaves, int leavesNumber) {
+  if (leavesNumber == 1)
+    return leaves[0].node;
+
+  btVector3 minCenter = leaves[0].center;
+  btVector3 maxCenter = minCenter;
+  for (int index = 1; index < leavesNumber; ++index) {
+    minCenter.setMin(leaves[index].center);
+    maxCenter.setMax(leaves[index].center);
+  }
+  const int axis = (maxCenter - minCenter).maxAxis();
+  const int half = leavesNumber / 2;
+  std::nth_element(leaves, leaves + half, leaves + leavesNumber,
+                   [axis](const DbvtLeaf &leaf0, const DbvtLeaf &leaf1) {
+                     return leaf0.center[axis] < leaf1.center[axis];
+                   });
+
+  btDbvtNode *children[2] = {buildDbvtSubtree(leaves, half),
+                             buildDbvtSubtree(leaves + half,
+                                              leavesNumber - half)};
+  btDbvtVolume volume;
+  Merge(children[0]->volume, children[1]->volume, volume);
+  btDbvtNode *node = createDbvtNode(volume, nullptr);
+  for (int child = 0; child < 2; ++child) {
+    node->childs[child] = children[child];
+    children[child]->parent = node;
+  }
+  return node;
 }
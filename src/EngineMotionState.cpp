@@ -0,0 +1,37 @@
+#include "EngineMotionState.h"
+
+#include "TransformBuffer.h"
+
+#include <BulletDynamics/Dynamics/btRigidBody.h>
+
+// -----------------------------------------------------------------------------
+EngineMotionState::EngineMotionState(const btTransform &startTransform)
+    : m_transform(startTransform) {}
+
+// -----------------------------------------------------------------------------
+void EngineMotionState::bind(TransformBuffer *buffer, int slot) {
+  m_buffer = buffer;
+  m_slot = slot;
+}
+
+// -----------------------------------------------------------------------------
+void EngineMotionState::getWorldTransform(btTransform &worldTransform) const {
+  worldTransform = m_transform;
+}
+
+// -----------------------------------------------------------------------------
+void EngineMotionState::setWorldTransform(const btTransform &worldTransform) {
+  m_transform = worldTransform;
+  if (m_buffer != nullptr)
+    m_buffer->setTransform(m_slot, worldTransform);
+}
+
+// -----------------------------------------------------------------------------
+// All the bodies of the world carry an EngineMotionState.
+int EngineMotionState::getBodySlot(const btCollisionObject *object) {
+  const btRigidBody *body = btRigidBody::upcast(object);
+  if (body == nullptr || body->getMotionState() == nullptr)
+    return -1;
+  return static_cast<const EngineMotionState *>(body->getMotionState())
+      ->getSlot();
+}
@@ -0,0 +1,192 @@
+#include "IslandDynamicsWorld.h"
+
+#include "ThreadPool.h"
+
+#include <BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
+#include <LinearMath/btQuickprof.h>
+
+#include <algorithm>
+
+// Support functions.
+// -----------------------------------------------------------------------------
+int getConstraintIslandId(const btTypedConstraint *constraint);
+bool touchesKinematic(const btPersistentManifold *manifold);
+bool touchesKinematic(const btTypedConstraint *constraint);
+
+// -----------------------------------------------------------------------------
+// Records the awake islands found by the island manager. Bodies are copied
+// since the manager reuses its body array for every island, manifolds and
+// constraints are referenced in place.
+class IslandDynamicsWorld::IslandCollector
+    : public btSimulationIslandManager::IslandCallback {
+public:
+  IslandCollector(IslandDynamicsWorld &world) : m_world(world) {}
+
+private:
+  IslandDynamicsWorld &m_world;
+  int m_constraintIndex = 0;
+
+public:
+  virtual void processIsland(btCollisionObject **bodies, int bodiesNumber,
+                             btPersistentManifold **manifolds,
+                             int manifoldsNumber, int islandId) override {
+    Island island;
+    island.bodiesBegin = m_world.m_islandBodies.size();
+    island.bodiesNumber = bodiesNumber;
+    for (int index = 0; index < bodiesNumber; ++index)
+      m_world.m_islandBodies.push_back(bodies[index]);
+    island.manifolds = manifolds;
+    island.manifoldsNumber = manifoldsNumber;
+
+    // Islands come in increasing id order, as the sorted constraints do.
+    btAlignedObjectArray<btTypedConstraint *> &constraints =
+        m_world.m_sortedConstraints;
+    while (m_constraintIndex < constraints.size() &&
+           getConstraintIslandId(constraints[m_constraintIndex]) < islandId)
+      ++m_constraintIndex;
+    int constraintsBegin = m_constraintIndex;
+    while (m_constraintIndex < constraints.size() &&
+           getConstraintIslandId(constraints[m_constraintIndex]) == islandId)
+      ++m_constraintIndex;
+    island.constraintsNumber = m_constraintIndex - constraintsBegin;
+    island.constraints =
+        island.constraintsNumber ? &constraints[constraintsBegin] : nullptr;
+
+    island.touchesKinematic =
+        std::any_of(manifolds, manifolds + manifoldsNumber,
+                    [](const btPersistentManifold *manifold) {
+                      return touchesKinematic(manifold);
+                    }) ||
+        std::any_of(island.constraints,
+                    island.constraints + island.constraintsNumber,
+                    [](const btTypedConstraint *constraint) {
+                      return touchesKinematic(constraint);
+                    });
+
+    m_world.m_islands.push_back(island);
+  }
+};
+
+// -----------------------------------------------------------------------------
+IslandDynamicsWorld::IslandDynamicsWorld(
+    btDispatcher *dispatcher, btBroadphaseInterface *broadphase,
+    btSequentialImpulseConstraintSolver *constraintSolver,
+    btCollisionConfiguration *collisionConfiguration, ThreadPool &threadPool)
+    : ParallelDynamicsWorld(dispatcher, broadphase, constraintSolver,
+                            collisionConfiguration, threadPool) {
+  m_solvers.push_back(constraintSolver);
+  for (int worker = 1; worker < threadPool.getThreadsNumber(); ++worker)
+    m_solvers.push_back(new btSequentialImpulseConstraintSolver());
+}
+
+// -----------------------------------------------------------------------------
+IslandDynamicsWorld::~IslandDynamicsWorld() {
+  // The first solver belongs to whoever created the world.
+  for (size_t worker = 1; worker < m_solvers.size(); ++worker)
+    delete m_solvers[worker];
+}
+
+// -----------------------------------------------------------------------------
+void IslandDynamicsWorld::solveConstraints(btContactSolverInfo &solverInfo) {
+  BT_PROFILE("solveConstraints");
+
+  m_sortedConstraints.resize(m_constraints.size());
+  for (int index = 0; index < m_constraints.size(); ++index)
+    m_sortedConstraints[index] = m_constraints[index];
+  std::stable_sort(&m_sortedConstraints[0],
+                   &m_sortedConstraints[0] + m_sortedConstraints.size(),
+                   [](const btTypedConstraint *lhs,
+                      const btTypedConstraint *rhs) {
+                     return getConstraintIslandId(lhs) <
+                            getConstraintIslandId(rhs);
+                   });
+
+  m_islandBodies.resize(0);
+  m_islands.clear();
+  IslandCollector collector(*this);
+  m_islandManager->buildAndProcessIslands(getDispatcher(), this, &collector);
+  buildTasks();
+
+  {
+    BT_PROFILE("solveIslands");
+    getThreadPool().run(m_tasks.size(), [&](int task, int worker) {
+      const IslandTask &islandTask = m_tasks[task];
+      for (int index = islandTask.islandsBegin; index < islandTask.islandsEnd;
+           ++index) {
+        if (!m_islands[index].touchesKinematic)
+          solveIsland(m_islands[index], solverInfo, m_solvers[worker]);
+      }
+    });
+  }
+
+  // A kinematic body can touch several islands and the solver tags it while
+  // solving, so these islands go one after the other.
+  for (const auto &island : m_islands) {
+    if (island.touchesKinematic)
+      solveIsland(island, solverInfo, m_solvers[0]);
+  }
+
+  m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
+}
+
+// -----------------------------------------------------------------------------
+// Group consecutive small islands so that a task is worth scheduling, then
+// put the most expensive tasks first.
+void IslandDynamicsWorld::buildTasks() {
+  m_tasks.clear();
+  IslandTask task{0, 0, 0};
+  for (size_t index = 0; index < m_islands.size(); ++index) {
+    const Island &island = m_islands[index];
+    task.cost +=
+        island.bodiesNumber + island.manifoldsNumber + island.constraintsNumber;
+    task.islandsEnd = index + 1;
+    if (task.cost >= MIN_TASK_COST) {
+      m_tasks.push_back(task);
+      task = IslandTask{task.islandsEnd, task.islandsEnd, 0};
+    }
+  }
+  if (task.cost > 0)
+    m_tasks.push_back(task);
+
+  std::stable_sort(m_tasks.begin(), m_tasks.end(),
+                   [](const IslandTask &lhs, const IslandTask &rhs) {
+                     return lhs.cost > rhs.cost;
+                   });
+}
+
+// -----------------------------------------------------------------------------
+// An island without contacts is solved too: the solver is what integrates the
+// forces, the gravity included.
+void IslandDynamicsWorld::solveIsland(
+    const Island &island, btContactSolverInfo &solverInfo,
+    btSequentialImpulseConstraintSolver *solver) {
+  // Start every island from the same random seed, whatever the worker
+  // solved before.
+  solver->reset();
+  solver->solveGroup(&m_islandBodies[island.bodiesBegin], island.bodiesNumber,
+                     island.manifolds, island.manifoldsNumber,
+                     island.constraints, island.constraintsNumber, solverInfo,
+                     m_debugDrawer, m_dispatcher1);
+}
+
+// -----------------------------------------------------------------------------
+// Same rule as btDiscreteDynamicsWorld: the island of the first non static
+// body.
+int getConstraintIslandId(const btTypedConstraint *constraint) {
+  const btCollisionObject &bodyA = constraint->getRigidBodyA();
+  const btCollisionObject &bodyB = constraint->getRigidBodyB();
+  return bodyA.getIslandTag() >= 0 ? bodyA.getIslandTag()
+                                   : bodyB.getIslandTag();
+}
+
+// -----------------------------------------------------------------------------
+bool touchesKinematic(const btPersistentManifold *manifold) {
+  return manifold->getBody0()->isKinematicObject() ||
+         manifold->getBody1()->isKinematicObject();
+}
+
+// -----------------------------------------------------------------------------
+bool touchesKinematic(const btTypedConstraint *constraint) {
+  return constraint->getRigidBodyA().isKinematicObject() ||
+         constraint->getRigidBodyB().isKinematicObject();
+}
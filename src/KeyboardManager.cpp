@@ -48,6 +48,18 @@ bool KeyboardManager::keyPressed(long key) {
     m_lightMask ^= 8;
     break;
   }
+  case SDLK_LEFTBRACKET: {
+    --m_playbackSkip;
+    break;
+  }
+  case SDLK_RIGHTBRACKET: {
+    ++m_playbackSkip;
+    break;
+  }
+  case SDLK_r: {
+    m_resetRequested = true;
+    break;
+  }
   }
   return false;
 }
@@ -88,3 +100,15 @@ bool KeyboardManager::isBackwardDown() const { return m_backwardDown; }
 int KeyboardManager::getLightMask() const { return m_lightMask; }
 
 void KeyboardManager::setLightMask(int lightMask) { m_lightMask = lightMask; }
+
+int KeyboardManager::takePlaybackSkip() {
+  int playbackSkip = m_playbackSkip;
+  m_playbackSkip = 0;
+  return playbackSkip;
+}
+
+bool KeyboardManager::takeResetRequest() {
+  bool resetRequested = m_resetRequested;
+  m_resetRequested = false;
+  return resetRequested;
+}
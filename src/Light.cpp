@@ -1,7 +1,5 @@
 #include "Light.h"
 
-#include "LightedObjectShader.h"
-
 #include <glm/glm.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
@@ -32,16 +30,6 @@ void Light::setSpecularColor(const glm::vec4 &color) { m_specularColor = color;
 
 const glm::vec4 &Light::getSpecularColor() const { return m_specularColor; }
 
-void Light::setUniforms(const LightedObjectShader &shader,
-                        const glm::mat4 &) const {
-  shader.setLightUniform(m_number, LightedObjectShader::lightAmbient,
-                        m_ambientColor);
-  shader.setLightUniform(m_number, LightedObjectShader::lightDiffuse,
-                        m_diffuseColor);
-  shader.setLightUniform(m_number, LightedObjectShader::lightSpecular,
-                          m_specularColor);
-}
-
 // -----------------------------------------------------------------------------
 DirectionalLight::DirectionalLight(const glm::vec3 &direction) : Light() {
   m_direction = glm::vec4(direction, 0.0f);
@@ -51,22 +39,7 @@ void DirectionalLight::setDirection(const glm::vec3 &direction) {
   m_direction = glm::vec4(direction, 0.0f);
 }
 
-const glm::vec4 &DirectionalLight::getDirection() { return m_direction; }
-
-void DirectionalLight::setUniforms(const LightedObjectShader &shader,
-                                   const glm::mat4 &modelView) const {
-  glm::mat4 modelViewRotation(modelView);
-  modelViewRotation[3][0] = 0.0f;
-  modelViewRotation[3][1] = 0.0f;
-  modelViewRotation[3][2] = 0.0f;
-
-  glm::vec4 screenSpaceDirection = modelViewRotation * m_direction;
-  glm::normalize(screenSpaceDirection);
-
-  Light::setUniforms(shader, modelView);
-  shader.setLightUniform(m_number, LightedObjectShader::lightPosition,
-                          screenSpaceDirection);
-}
+const glm::vec4 &DirectionalLight::getDirection() const { return m_direction; }
 
 // -----------------------------------------------------------------------------
 PositionalLight::PositionalLight(const glm::vec3 &position) : Light() {
@@ -77,45 +50,32 @@ void PositionalLight::setPosition(const glm::vec3 &position) {
   m_position = glm::vec4(position, 1.0f);
 }
 
-const glm::vec4 &PositionalLight::getPosition() { return m_position; }
+const glm::vec4 &PositionalLight::getPosition() const { return m_position; }
 
 void PositionalLight::setConstantAttenuation(float attenuation) {
   m_constantAttenuation = attenuation;
 }
 
-float PositionalLight::getConstantAttenuation() { return m_constantAttenuation; }
+float PositionalLight::getConstantAttenuation() const {
+  return m_constantAttenuation;
+}
 
 void PositionalLight::setLinearAttenuation(float attenuation) {
   m_linearAttenuation = attenuation;
 }
 
-float PositionalLight::getLinearAttenuation() { return m_linearAttenuation; }
+float PositionalLight::getLinearAttenuation() const {
+  return m_linearAttenuation;
+}
 
 void PositionalLight::setQuadraticAttenuation(float attenuation) {
   m_quadraticAttenuation = attenuation;
 }
 
-float PositionalLight::getQuadraticAttenuation() {
+float PositionalLight::getQuadraticAttenuation() const {
   return m_quadraticAttenuation;
 }
 
-void PositionalLight::setUniforms(const LightedObjectShader &shader,
-                                  const glm::mat4 &modelView) const {
-  Light::setUniforms(shader, modelView);
-  shader.setLightUniform(m_number,
-                         LightedObjectShader::lightConstantAttenuation,
-                         m_constantAttenuation);
-  shader.setLightUniform(m_number, LightedObjectShader::lightLinearAttenuation,
-                         m_linearAttenuation);
-  shader.setLightUniform(m_number,
-                         LightedObjectShader::lightQuadraticAttenuation,
-                         m_quadraticAttenuation);
-  shader.setLightUniform(m_number, LightedObjectShader::lightSpotCutOff,
-                         Light::DEFAULT_SPOT_CUTOFF);
-  shader.setLightUniform(m_number, LightedObjectShader::lightPosition,
-                         modelView * m_position);
-}
-
 // -----------------------------------------------------------------------------
 SpotLight::SpotLight(const glm::vec3 &position, const glm::vec3 &direction)
     : PositionalLight(position) {
@@ -126,35 +86,15 @@ void SpotLight::setDirection(const glm::vec3 &direction) {
   m_direction = glm::vec4(direction, 0.0f);
 }
 
-const glm::vec4 &SpotLight::getDirection() { return m_direction; }
+const glm::vec4 &SpotLight::getDirection() const { return m_direction; }
 
 void SpotLight::setCutOff(float cutOff) { m_cutOff = cutOff; }
 
-float SpotLight::getCutOff() { return m_cutOff; }
+float SpotLight::getCutOff() const { return m_cutOff; }
 
 void SpotLight::setExponent(float exponent) { m_exponent = exponent; }
 
-float SpotLight::getExponent() { return m_exponent; }
-
-void SpotLight::setUniforms(const LightedObjectShader &shader,
-                            const glm::mat4 &modelView) const {
-  glm::mat4 modelViewRotation(modelView);
-  modelViewRotation[3][0] = 0.0f;
-  modelViewRotation[3][1] = 0.0f;
-  modelViewRotation[3][2] = 0.0f;
-
-  glm::vec4 screenSpaceDirection = modelViewRotation * m_direction;
-  glm::normalize(screenSpaceDirection);
-
-  PositionalLight::setUniforms(shader, modelView);
-  shader.setLightUniform(m_number, LightedObjectShader::lightSpotCutOff, m_cutOff);
-  shader.setLightUniform(m_number, LightedObjectShader::lightSpotCosCutOff,
-                         glm::cos(glm::radians(m_cutOff)));
-  shader.setLightUniform(m_number, LightedObjectShader::lightSpotExponent,
-                         m_exponent);
-  shader.setLightUniform(m_number, LightedObjectShader::lightSpotDirection,
-                          glm::vec3(screenSpaceDirection));
-}
+float SpotLight::getExponent() const { return m_exponent; }
 
 // -----------------------------------------------------------------------------
 LightBuilder::LightBuilder() { setup(); }
@@ -3,6 +3,7 @@
 #include "Light.h"
 #include "MathUtils.h"
 #include "ObjParser.h"
+#include "ShapeCache.h"
 #include "SysDefines.h"
 
 #include <LinearMath/btVector3.h>
@@ -23,31 +24,28 @@ LightBulb::LightBulb(const btTransform &transform, const btScalar mass,
 
 //------------------------------------------------------------------------------
 void LightBulb::setupPoints() {
-  m_points.reserve(m_POINTS_NUMBER + 1);
+  m_geometry->points.reserve(m_POINTS_NUMBER + 1);
 
   // Generate 2D data for a unit circle.
-  m_points.emplace_back(0, 0, 0);
+  m_geometry->points.emplace_back(0, 0, 0);
 
   for (int index = 0; index < m_POINTS_NUMBER + 1; ++index) {
     auto angle = index * m_ANGLE;
     auto x = m_radius * glm::cos(angle);
     auto y = m_radius * glm::sin(angle);
-    m_points.emplace_back(x, y, 0);
+    m_geometry->points.emplace_back(x, y, 0);
   }
 
   for (auto index = 0u; index < m_POINTS_NUMBER; ++index) {
-    m_indices.insert(m_indices.end(), {0, index + 1, index + 2});
+    m_geometry->indices.insert(m_geometry->indices.end(),
+                               {0, index + 1, index + 2});
   }
 }
 
 //------------------------------------------------------------------------------
 void LightBulb::setupBulletShape() {
-  m_collisionShape = new btSphereShape(m_radius);
-  m_collisionShape->calculateLocalInertia(m_mass, m_inertia);
-  m_motionState = new btDefaultMotionState(m_transform);
-  m_constructionInfo = new btRigidBody::btRigidBodyConstructionInfo(
-      m_mass, m_motionState, m_collisionShape, m_inertia);
-  m_rigidBody = new btRigidBody(*m_constructionInfo);
+  m_collisionShape = ShapeCache::getInstance().acquireSphere(m_radius);
+  setupRigidBody();
 }
 
 //------------------------------------------------------------------------------
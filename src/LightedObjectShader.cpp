@@ -1,7 +1,11 @@
 #include "LightedObjectShader.h"
 
+#include "Light.h"
 #include "SceneManager.h"
 
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
 #include <iostream>
 
 std::vector<std::string> LightedObjectShader::uniformLightNames{
@@ -39,6 +43,85 @@ std::vector<int> LightedObjectShader::createLightUniformTable(
   return uniformLocations;
 }
 
+// -----------------------------------------------------------------------------
+void LightedObjectShader::setLightUniforms(const Light &light,
+                                           const glm::mat4 &modelView) const {
+  switch (light.getType()) {
+  case LightType::ltDirectional: {
+    setDirectionalLightUniforms(static_cast<const DirectionalLight &>(light),
+                                modelView);
+    break;
+  }
+  case LightType::ltPositional: {
+    setPositionalLightUniforms(static_cast<const PositionalLight &>(light),
+                               modelView);
+    break;
+  }
+  case LightType::ltSpot: {
+    setSpotLightUniforms(static_cast<const SpotLight &>(light), modelView);
+    break;
+  }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void LightedObjectShader::setBaseLightUniforms(const Light &light) const {
+  const int number = light.getNumber();
+  setLightUniform(number, lightAmbient, light.getAmbientColor());
+  setLightUniform(number, lightDiffuse, light.getDiffuseColor());
+  setLightUniform(number, lightSpecular, light.getSpecularColor());
+}
+
+// -----------------------------------------------------------------------------
+void LightedObjectShader::setDirectionalLightUniforms(
+    const DirectionalLight &light, const glm::mat4 &modelView) const {
+  glm::mat4 modelViewRotation(modelView);
+  modelViewRotation[3][0] = 0.0f;
+  modelViewRotation[3][1] = 0.0f;
+  modelViewRotation[3][2] = 0.0f;
+
+  glm::vec4 screenSpaceDirection = modelViewRotation * light.getDirection();
+  glm::normalize(screenSpaceDirection);
+
+  setBaseLightUniforms(light);
+  setLightUniform(light.getNumber(), lightPosition, screenSpaceDirection);
+}
+
+// -----------------------------------------------------------------------------
+void LightedObjectShader::setPositionalLightUniforms(
+    const PositionalLight &light, const glm::mat4 &modelView) const {
+  const int number = light.getNumber();
+  setBaseLightUniforms(light);
+  setLightUniform(number, lightConstantAttenuation,
+                  light.getConstantAttenuation());
+  setLightUniform(number, lightLinearAttenuation,
+                  light.getLinearAttenuation());
+  setLightUniform(number, lightQuadraticAttenuation,
+                  light.getQuadraticAttenuation());
+  setLightUniform(number, lightSpotCutOff, Light::DEFAULT_SPOT_CUTOFF);
+  setLightUniform(number, lightPosition, modelView * light.getPosition());
+}
+
+// -----------------------------------------------------------------------------
+void LightedObjectShader::setSpotLightUniforms(
+    const SpotLight &light, const glm::mat4 &modelView) const {
+  glm::mat4 modelViewRotation(modelView);
+  modelViewRotation[3][0] = 0.0f;
+  modelViewRotation[3][1] = 0.0f;
+  modelViewRotation[3][2] = 0.0f;
+
+  glm::vec4 screenSpaceDirection = modelViewRotation * light.getDirection();
+  glm::normalize(screenSpaceDirection);
+
+  const int number = light.getNumber();
+  setPositionalLightUniforms(light, modelView);
+  setLightUniform(number, lightSpotCutOff, light.getCutOff());
+  setLightUniform(number, lightSpotCosCutOff,
+                  glm::cos(glm::radians(light.getCutOff())));
+  setLightUniform(number, lightSpotExponent, light.getExponent());
+  setLightUniform(number, lightSpotDirection, glm::vec3(screenSpaceDirection));
+}
+
 // -----------------------------------------------------------------------------
 template void LightedObjectShader::setLightUniform(int, int,
                                                    const float &) const;
@@ -1,6 +1,8 @@
 #include "Mesh.h"
 
 #include "ObjParser.h"
+#include "ShapeCache.h"
+#include "ShapeFitter.h"
 #include "SysDefines.h"
 #include "SysUtils.h"
 
@@ -10,29 +12,38 @@
 #include <glm/ext.hpp>
 
 #include <algorithm>
+#include <cstdlib>
+#include <iostream>
 #include <map>
 
 template class ObjectBuilder<MeshBuilder>;
 
 //------------------------------------------------------------------------------
 Mesh::Mesh(const btTransform &transform, const btScalar mass,
-           btVector3 &inertia, const std::string &meshFile)
+           btVector3 &inertia, const std::string &meshFile,
+           btScalar shapeTolerance, bool triangleMesh)
     : Object(transform, mass, inertia) {
   ObjParser objParser;
   objParser.parse(meshFile);
   fillMesh(objParser);
-  setupBulletShape();
+  setupBulletShape(meshFile, shapeTolerance, triangleMesh);
 }
 
 //------------------------------------------------------------------------------
-void Mesh::setupBulletShape() {
-  m_collisionShape =
-      new btConvexHullShape(getPoints(), getPointsNumber(), sizeof(glm::vec3));
-  m_collisionShape->calculateLocalInertia(m_mass, m_inertia);
-  m_motionState = new btDefaultMotionState(m_transform);
-  m_constructionInfo = new btRigidBody::btRigidBodyConstructionInfo(
-      m_mass, m_motionState, m_collisionShape, m_inertia);
-  m_rigidBody = new btRigidBody(*m_constructionInfo);
+void Mesh::setupBulletShape(const std::string &meshFile,
+                            btScalar shapeTolerance, bool triangleMesh) {
+  if (!triangleMesh) {
+    m_collisionShape = ShapeCache::getInstance().acquireMesh(
+        meshFile, getPoints(), getPointsNumber(), shapeTolerance);
+  } else if (m_mass == 0) {
+    m_collisionShape = ShapeCache::getInstance().acquireTriangleMesh(
+        meshFile, getPoints(), getPointsNumber(), getIndices(),
+        getIndicesNumber());
+  } else {
+    std::cerr << "Triangle mesh " << meshFile << " must be static\n";
+    exit(1);
+  }
+  setupRigidBody();
 }
 
 //------------------------------------------------------------------------------
@@ -46,10 +57,10 @@ void Mesh::fillMesh(const ObjParser &parser) {
   // new index.
   std::map<ObjParser::FaceIndices, int> indexMap;
 
-  m_indices.reserve(parserIndices.size());
-  m_points.reserve(parserIndices.size() / 2);
-  m_normals.reserve(parserIndices.size() / 2);
-  m_textureCoos.reserve(parserIndices.size() / 2);
+  m_geometry->indices.reserve(parserIndices.size());
+  m_geometry->points.reserve(parserIndices.size() / 2);
+  m_geometry->normals.reserve(parserIndices.size() / 2);
+  m_geometry->textureCoos.reserve(parserIndices.size() / 2);
 
   int counter = 0;
 
@@ -59,26 +70,26 @@ void Mesh::fillMesh(const ObjParser &parser) {
     auto iterator = indexMap.find(faceIndices);
     // If yes the index of the touple to the output index buffer.     
     if (iterator != indexMap.end()) {
-      m_indices.push_back(iterator->second);
+      m_geometry->indices.push_back(iterator->second);
     } 
     // If not create a new instance.
     else {
       // Get the current point. 
       glm::vec3 vertex = parserPoints[std::get<0>(faceIndices) - 1];
-      m_points.push_back(vertex);
+      m_geometry->points.push_back(vertex);
 
       // If there is a texture coordinate add it.
       if(std::get<1>(faceIndices) != -1) {
         glm::vec2 textureCoo = parserTextureCoos[std::get<1>(faceIndices) - 1];
-        m_textureCoos.push_back(textureCoo);
+        m_geometry->textureCoos.push_back(textureCoo);
       }
 
       // Add normal.
       glm::vec3 normal = parserNormals[std::get<2>(faceIndices) - 1];
-      m_normals.push_back(normal);
+      m_geometry->normals.push_back(normal);
 
       // Create a new counter.
-      m_indices.push_back(counter);
+      m_geometry->indices.push_back(counter);
       indexMap[faceIndices] = counter;
       counter++;
     }
@@ -92,14 +103,26 @@ void Mesh::fillMesh(const ObjParser &parser) {
 }
 
 //------------------------------------------------------------------------------
-MeshBuilder::MeshBuilder() : ObjectBuilder() {}
+MeshBuilder::MeshBuilder()
+    : ObjectBuilder(), m_shapeTolerance(ShapeFitter::DEFAULT_TOLERANCE) {}
 
 MeshBuilder &MeshBuilder::setMeshFile(const std::string &meshFile) {
   m_meshFile = MESH_PATH + meshFile;
   return *this;
 }
 
+MeshBuilder &MeshBuilder::setShapeTolerance(btScalar shapeTolerance) {
+  m_shapeTolerance = shapeTolerance;
+  return *this;
+}
+
+MeshBuilder &MeshBuilder::setTriangleMesh(bool triangleMesh) {
+  m_triangleMesh = triangleMesh;
+  return *this;
+}
+
 Mesh *MeshBuilder::create() {
-  Mesh *mesh = new Mesh(m_transform, m_mass, m_inertia, m_meshFile);
+  Mesh *mesh = new Mesh(m_transform, m_mass, m_inertia, m_meshFile,
+                        m_shapeTolerance, m_triangleMesh);
   return mesh;
 }
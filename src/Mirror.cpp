@@ -8,8 +8,6 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/ext.hpp>
 
-#include <GL/glew.h>
-
 #include <glm/vec2.hpp>
 
 #include <iostream>
@@ -1,13 +1,13 @@
 #include "Object.h"
 
 #include "Box.h"
-#include "Drawer.h"
 #include "LightBulb.h"
 #include "MathUtils.h"
 #include "Mirror.h"
 #include "Mesh.h"
 #include "Plane.h"
-#include "ShaderProgram.h"
+#include "Pool.h"
+#include "ShapeCache.h"
 #include "SysDefines.h"
 
 #include <BulletCollision/CollisionShapes/btCollisionShape.h>
@@ -17,37 +17,62 @@
 
 #include <utility>
 
+// Support functions.
+// -----------------------------------------------------------------------------
+Pool<EngineMotionState> &getMotionStatePool();
+Pool<btRigidBody> &getRigidBodyPool();
+
 const glm::vec3 Object::DEFAULT_POSITION = {0.f, 0.f, 0.f};
 const glm::vec3 Object::DEFAULT_ROTATION = {0.f, 0.f, 0.f};
 const glm::vec4 Object::DEFAULT_AMBIENT_COLOR = {0.f, 0.f, 0.f, 1.f};
 const glm::vec4 Object::DEFAULT_DIFFUSE_COLOR = {0.f, 0.f, 0.f, 1.f};
 const glm::vec4 Object::DEFAULT_SPECULAR_COLOR = {0.f, 0.f, 0.f, 1.f};
 
-Object::Object(const btTransform &transform, btScalar mass, btVector3 &inertia)
-    : Entity(transform), m_mass(mass), m_inertia(inertia) {}
+Object::Object(const btTransform &transform, btScalar mass, btVector3 &inertia,
+               std::shared_ptr<Geometry> geometry)
+    : Entity(transform), m_mass(mass), m_inertia(inertia),
+      m_geometry(std::move(geometry)) {}
 
+// The body must be out of the world by now.
 Object::~Object() {
-  delete m_collisionShape;
-  delete m_motionState;
-  delete m_constructionInfo;
+  getRigidBodyPool().destroy(m_rigidBody);
+  getMotionStatePool().destroy(m_motionState);
+  // The shape may be shared with other objects.
+  ShapeCache::getInstance().release(m_collisionShape);
+}
+
+// -----------------------------------------------------------------------------
+// The construction info is only needed by the body constructor. Static
+// bodies have no inertia, and concave shapes cannot tell one.
+void Object::setupRigidBody() {
+  if (m_mass != 0)
+    m_collisionShape->calculateLocalInertia(m_mass, m_inertia);
+  else
+    m_inertia.setZero();
+  m_motionState = getMotionStatePool().create(m_transform);
+  btRigidBody::btRigidBodyConstructionInfo constructionInfo(
+      m_mass, m_motionState, m_collisionShape, m_inertia);
+  m_rigidBody = getRigidBodyPool().create(constructionInfo);
 }
 
 const float *Object::getPoints() const {
-  return reinterpret_cast<const float *>(m_points.data());
+  return reinterpret_cast<const float *>(m_geometry->points.data());
 }
-int Object::getPointsNumber() const { return m_points.size(); }
+int Object::getPointsNumber() const { return m_geometry->points.size(); }
 
 const float *Object::getNormals() const {
-  return reinterpret_cast<const float *>(m_normals.data());
+  return reinterpret_cast<const float *>(m_geometry->normals.data());
+}
+const unsigned int *Object::getIndices() const {
+  return m_geometry->indices.data();
 }
-const unsigned int *Object::getIndices() const { return m_indices.data(); }
 
 const float *Object::getTextureCoos() const {
-  return reinterpret_cast<const float *>(m_textureCoos.data());
+  return reinterpret_cast<const float *>(m_geometry->textureCoos.data());
 }
 
 const float *Object::getTangents() const {
-  return reinterpret_cast<const float *>(m_tangents.data());
+  return reinterpret_cast<const float *>(m_geometry->tangents.data());
 }
 
 void Object::setMass(btScalar mass) { m_mass = mass; }
@@ -64,25 +89,11 @@ void Object::setShininess(float shininess) { m_shininess = shininess; }
 
 btCollisionShape *Object::getCollisionShape() const { return m_collisionShape; }
 void Object::setCollisionShape(btCollisionShape *collisionShape) {
+  ShapeCache::getInstance().release(m_collisionShape);
   m_collisionShape = collisionShape;
 }
 
-void Object::setRigidBody(btRigidBody *rigidBody) {
-  m_rigidBody = rigidBody;
-}
-
-btDefaultMotionState *Object::getMotionState() const { return m_motionState; }
-void Object::setMotionState(btDefaultMotionState *motionState) {
-  m_motionState = motionState;
-}
-
-btRigidBody::btRigidBodyConstructionInfo *Object::getConstructionInfo() const {
-  return m_constructionInfo;
-}
-void Object::setConstructionInfo(
-    btRigidBody::btRigidBodyConstructionInfo *constructionInfo) {
-  m_constructionInfo = constructionInfo;
-}
+EngineMotionState *Object::getMotionState() const { return m_motionState; }
 
 //-----------------------------------------------------------------------------
 
@@ -160,3 +171,15 @@ template class ObjectBuilder<BoxBuilder>;
 template class ObjectBuilder<MirrorBuilder>;
 template class ObjectBuilder<MeshBuilder>;
 template class ObjectBuilder<LightBulbBuilder>;
+
+//-----------------------------------------------------------------------------
+// Bodies and motion states of all the objects, in creation order.
+Pool<EngineMotionState> &getMotionStatePool() {
+  static Pool<EngineMotionState> pool;
+  return pool;
+}
+
+Pool<btRigidBody> &getRigidBodyPool() {
+  static Pool<btRigidBody> pool;
+  return pool;
+}
@@ -0,0 +1,192 @@
+#include "ParallelDbvtBroadphase.h"
+
+#include "ThreadPool.h"
+
+#include <BulletCollision/BroadphaseCollision/btOverlappingPairCache.h>
+
+#include <algorithm>
+
+const int ParallelDbvtBroadphase::MIN_SUBTREE_PAIRS;
+const int ParallelDbvtBroadphase::NODE_PAIRS_CHUNK;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+bool splitNodes(const btDbvtNode *a, const btDbvtNode *b,
+                std::vector<const btDbvtNode *> &children);
+
+// -----------------------------------------------------------------------------
+// Collects the proxy pairs of a chunk, the pair cache takes them later.
+class ParallelDbvtBroadphase::PairCollector : public btDbvt::ICollide {
+public:
+  PairCollector(std::vector<ProxyPair> &pairs) : m_pairs(pairs) {}
+
+private:
+  std::vector<ProxyPair> &m_pairs;
+
+public:
+  virtual void Process(const btDbvtNode *a, const btDbvtNode *b) override {
+    if (a != b)
+      m_pairs.emplace_back(static_cast<btBroadphaseProxy *>(a->data),
+                           static_cast<btBroadphaseProxy *>(b->data));
+  }
+};
+
+// -----------------------------------------------------------------------------
+ParallelDbvtBroadphase::ParallelDbvtBroadphase(ThreadPool &threadPool)
+    : m_threadPool(threadPool) {}
+
+// -----------------------------------------------------------------------------
+// Proxies can move between two steps, when the bodies are restored.
+void ParallelDbvtBroadphase::destroyProxy(btBroadphaseProxy *proxy,
+                                          btDispatcher *dispatcher) {
+  if (!m_movedProxies.empty())
+    m_destroyedProxies.insert(proxy);
+  btDbvtBroadphase::destroyProxy(proxy, dispatcher);
+}
+
+// -----------------------------------------------------------------------------
+// The base broadphase pairs a proxy when it comes from the static tree, or
+// when its leaf is updated, and counts the updates.
+void ParallelDbvtBroadphase::setAabb(btBroadphaseProxy *proxy,
+                                     const btVector3 &aabbMin,
+                                     const btVector3 &aabbMax,
+                                     btDispatcher *dispatcher) {
+  if (m_deferedcollide) {
+    btDbvtBroadphase::setAabb(proxy, aabbMin, aabbMax, dispatcher);
+    return;
+  }
+
+  auto dbvtProxy = static_cast<btDbvtProxy *>(proxy);
+  const bool wasStatic = dbvtProxy->stage == STAGECOUNT;
+  const unsigned int updatesDone = m_updates_done;
+  m_deferedcollide = true;
+  btDbvtBroadphase::setAabb(proxy, aabbMin, aabbMax, dispatcher);
+  m_deferedcollide = false;
+  if (wasStatic || m_updates_done != updatesDone) {
+    // A new proxy may take the memory of a destroyed one.
+    if (!m_destroyedProxies.empty())
+      m_destroyedProxies.erase(proxy);
+    m_movedProxies.push_back(dbvtProxy);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// The moved proxies are paired with the static tree then the dynamic one, as
+// btDbvtBroadphase::setAabb does. The base broadphase then optimizes the
+// trees, moves the proxies that have stopped to the static tree and removes
+// the pairs that no longer overlap.
+void ParallelDbvtBroadphase::calculateOverlappingPairs(
+    btDispatcher *dispatcher) {
+  if (!m_destroyedProxies.empty()) {
+    m_movedProxies.erase(
+        std::remove_if(m_movedProxies.begin(), m_movedProxies.end(),
+                       [this](const btDbvtProxy *proxy) {
+                         return m_destroyedProxies.count(proxy) != 0;
+                       }),
+        m_movedProxies.end());
+    m_destroyedProxies.clear();
+  }
+
+  const bool deferredCollide = m_deferedcollide;
+  if (deferredCollide) {
+    splitTraversal();
+  } else {
+    m_nodePairs.clear();
+    for (const btDbvtProxy *proxy : m_movedProxies) {
+      if (m_sets[1].m_root != nullptr)
+        m_nodePairs.push_back({m_sets[1].m_root, proxy->leaf});
+      m_nodePairs.push_back({m_sets[0].m_root, proxy->leaf});
+    }
+  }
+  m_movedProxies.clear();
+
+  collideNodePairs();
+  for (const auto &pairs : m_chunkPairs) {
+    for (const auto &pair : pairs) {
+      m_paircache->addOverlappingPair(pair.first, pair.second);
+      ++m_newpairs;
+    }
+  }
+
+  m_deferedcollide = false;
+  btDbvtBroadphase::calculateOverlappingPairs(dispatcher);
+  m_deferedcollide = deferredCollide;
+}
+
+// -----------------------------------------------------------------------------
+// The pairs of subtrees of the dynamic tree with the static one and with
+// itself, split as btDbvt::collideTT would until there are enough of them.
+// Subtrees that do not overlap are dropped on the way.
+void ParallelDbvtBroadphase::splitTraversal() {
+  m_nodePairs.clear();
+  const btDbvtNode *dynamicRoot = m_sets[0].m_root;
+  const btDbvtNode *staticRoot = m_sets[1].m_root;
+  if (dynamicRoot == nullptr)
+    return;
+  if (staticRoot != nullptr)
+    m_nodePairs.push_back({dynamicRoot, staticRoot});
+  m_nodePairs.push_back({dynamicRoot, dynamicRoot});
+
+  std::vector<const btDbvtNode *> children;
+  bool split = true;
+  while (split &&
+         m_nodePairs.size() < static_cast<size_t>(MIN_SUBTREE_PAIRS)) {
+    split = false;
+    m_splitPairs.clear();
+    for (const auto &nodePair : m_nodePairs) {
+      if (splitNodes(nodePair.a, nodePair.b, children)) {
+        for (size_t child = 0; child < children.size(); child += 2)
+          m_splitPairs.push_back({children[child], children[child + 1]});
+        split = true;
+      } else if (nodePair.a != nodePair.b &&
+                 Intersect(nodePair.a->volume, nodePair.b->volume)) {
+        m_splitPairs.push_back(nodePair);
+      }
+    }
+    m_nodePairs.swap(m_splitPairs);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void ParallelDbvtBroadphase::collideNodePairs() {
+  const int nodePairsNumber = m_nodePairs.size();
+  const int chunksNumber =
+      (nodePairsNumber + NODE_PAIRS_CHUNK - 1) / NODE_PAIRS_CHUNK;
+  m_chunkPairs.resize(chunksNumber);
+  m_threadPool.run(chunksNumber, [this, nodePairsNumber](int chunk, int) {
+    std::vector<ProxyPair> &pairs = m_chunkPairs[chunk];
+    pairs.clear();
+    PairCollector collector(pairs);
+    const int end = std::min(nodePairsNumber, (chunk + 1) * NODE_PAIRS_CHUNK);
+    for (int index = chunk * NODE_PAIRS_CHUNK; index < end; ++index)
+      m_sets[0].collideTT(m_nodePairs[index].a, m_nodePairs[index].b,
+                          collector);
+  });
+}
+
+// -----------------------------------------------------------------------------
+// The children pairs btDbvt::collideTT pushes for two nodes, false when it
+// pushes none: the nodes are leaves, or do not overlap. A node is paired with
+// itself through the pairs of its children.
+bool splitNodes(const btDbvtNode *a, const btDbvtNode *b,
+                std::vector<const btDbvtNode *> &children) {
+  children.clear();
+  if (a == b) {
+    if (a->isleaf())
+      return false;
+    children = {a->childs[0], a->childs[0], a->childs[1],
+                a->childs[1], a->childs[0], a->childs[1]};
+    return true;
+  }
+  if ((a->isleaf() && b->isleaf()) || !Intersect(a->volume, b->volume))
+    return false;
+
+  if (a->isinternal() && b->isinternal())
+    children = {a->childs[0], b->childs[0], a->childs[1], b->childs[0],
+                a->childs[0], b->childs[1], a->childs[1], b->childs[1]};
+  else if (a->isinternal())
+    children = {a->childs[0], b, a->childs[1], b};
+  else
+    children = {a, b->childs[0], a, b->childs[1]};
+  return true;
+}
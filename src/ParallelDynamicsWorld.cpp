@@ -0,0 +1,124 @@
+#include "ParallelDynamicsWorld.h"
+
+#include "ThreadPool.h"
+
+#include <LinearMath/btQuickprof.h>
+
+#include <algorithm>
+
+const int ParallelDynamicsWorld::AABB_CHUNK;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+template <typename type>
+void compactArray(btAlignedObjectArray<type *> &array,
+                  const std::unordered_set<const btCollisionObject *> &removed);
+
+// -----------------------------------------------------------------------------
+ParallelDynamicsWorld::ParallelDynamicsWorld(
+    btDispatcher *dispatcher, btBroadphaseInterface *broadphase,
+    btConstraintSolver *constraintSolver,
+    btCollisionConfiguration *collisionConfiguration, ThreadPool &threadPool)
+    : btDiscreteDynamicsWorld(dispatcher, broadphase, constraintSolver,
+                              collisionConfiguration),
+      m_threadPool(threadPool) {}
+
+// -----------------------------------------------------------------------------
+// The broadphase trees are not safe to update concurrently, only the AABBs
+// are computed in parallel.
+void ParallelDynamicsWorld::updateAabbs() {
+  if (m_threadPool.getThreadsNumber() == 1) {
+    btDiscreteDynamicsWorld::updateAabbs();
+    return;
+  }
+  BT_PROFILE("updateAabbs");
+
+  const int objectsNumber = m_collisionObjects.size();
+  m_aabbMins.resize(objectsNumber);
+  m_aabbMaxs.resize(objectsNumber);
+  const int chunksNumber = (objectsNumber + AABB_CHUNK - 1) / AABB_CHUNK;
+  m_threadPool.run(chunksNumber, [this, objectsNumber](int chunk, int) {
+    const int end = std::min(objectsNumber, (chunk + 1) * AABB_CHUNK);
+    for (int index = chunk * AABB_CHUNK; index < end; ++index) {
+      if (needsAabb(m_collisionObjects[index]))
+        computeAabb(m_collisionObjects[index], m_aabbMins[index],
+                    m_aabbMaxs[index]);
+    }
+  });
+
+  for (int index = 0; index < objectsNumber; ++index) {
+    if (needsAabb(m_collisionObjects[index]))
+      setAabb(m_collisionObjects[index], m_aabbMins[index], m_aabbMaxs[index]);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void ParallelDynamicsWorld::removeRigidBodies(
+    const std::unordered_set<const btCollisionObject *> &rigidBodies) {
+  compactArray(m_collisionObjects, rigidBodies);
+  compactArray(m_nonStaticRigidBodies, rigidBodies);
+}
+
+// -----------------------------------------------------------------------------
+bool ParallelDynamicsWorld::needsAabb(const btCollisionObject *object) const {
+  return m_forceUpdateAllAabbs || object->isActive();
+}
+
+// -----------------------------------------------------------------------------
+// Grown by the contact breaking threshold, and by the motion of the step for
+// continuous collision.
+void ParallelDynamicsWorld::computeAabb(const btCollisionObject *object,
+                                        btVector3 &aabbMin,
+                                        btVector3 &aabbMax) const {
+  const btCollisionShape *shape = object->getCollisionShape();
+  shape->getAabb(object->getWorldTransform(), aabbMin, aabbMax);
+  const btVector3 threshold(gContactBreakingThreshold,
+                            gContactBreakingThreshold,
+                            gContactBreakingThreshold);
+  aabbMin -= threshold;
+  aabbMax += threshold;
+
+  if (getDispatchInfo().m_useContinuous &&
+      object->getInternalType() == btCollisionObject::CO_RIGID_BODY &&
+      !object->isStaticOrKinematicObject()) {
+    btVector3 motionMin, motionMax;
+    shape->getAabb(object->getInterpolationWorldTransform(), motionMin,
+                   motionMax);
+    aabbMin.setMin(motionMin - threshold);
+    aabbMax.setMax(motionMax + threshold);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// A moving body with a huge AABB has gone wrong, it leaves the simulation as
+// in btCollisionWorld::updateSingleAabb.
+void ParallelDynamicsWorld::setAabb(btCollisionObject *object,
+                                    const btVector3 &aabbMin,
+                                    const btVector3 &aabbMax) {
+  if (object->isStaticObject() ||
+      (aabbMax - aabbMin).length2() < btScalar(1e12)) {
+    getBroadphase()->setAabb(object->getBroadphaseHandle(), aabbMin, aabbMax,
+                             m_dispatcher1);
+    return;
+  }
+
+  object->setActivationState(DISABLE_SIMULATION);
+  static bool reported = false;
+  if (!reported && m_debugDrawer != nullptr) {
+    reported = true;
+    m_debugDrawer->reportErrorWarning(
+        "Overflow in AABB, object removed from simulation");
+  }
+}
+
+// -----------------------------------------------------------------------------
+template <typename type>
+void compactArray(btAlignedObjectArray<type *> &array,
+                  const std::unordered_set<const btCollisionObject *> &removed) {
+  int kept = 0;
+  for (int index = 0; index < array.size(); ++index) {
+    if (removed.count(array[index]) == 0)
+      array[kept++] = array[index];
+  }
+  array.resize(kept);
+}
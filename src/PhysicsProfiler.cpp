@@ -0,0 +1,112 @@
+#include "PhysicsProfiler.h"
+
+#include <LinearMath/btQuickprof.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// -----------------------------------------------------------------------------
+PhysicsProfiler::PhysicsProfiler(const std::string &csvFile) {
+  if (csvFile.empty())
+    return;
+  m_csv.open(csvFile);
+  if (!m_csv) {
+    std::cerr << "Could not create physics profile: " << csvFile << "\n";
+    exit(1);
+  }
+  m_csv << "step,broadphase_ms,narrowphase_ms,solver_ms,integration_ms,"
+           "total_ms,active_bodies,manifolds,awake_islands\n";
+}
+
+// -----------------------------------------------------------------------------
+void PhysicsProfiler::recordStep(unsigned int step, int activeBodies,
+                                 int manifolds, int awakeIslands) {
+  StepProfile profile;
+  profile.step = step;
+  profile.activeBodies = activeBodies;
+  profile.manifolds = manifolds;
+  profile.awakeIslands = awakeIslands;
+  readStages(profile);
+  if (m_csv.is_open())
+    writeCsv(profile);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_sum.step = step;
+  m_sum.broadphase += profile.broadphase;
+  m_sum.narrowphase += profile.narrowphase;
+  m_sum.solver += profile.solver;
+  m_sum.integration += profile.integration;
+  m_sum.total += profile.total;
+  m_sum.activeBodies += activeBodies;
+  m_sum.manifolds += manifolds;
+  m_sum.awakeIslands += awakeIslands;
+  ++m_stepsNumber;
+}
+
+// -----------------------------------------------------------------------------
+bool PhysicsProfiler::takeAverage(StepProfile &profile) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_stepsNumber > 0) {
+    m_average.step = m_sum.step;
+    m_average.broadphase = m_sum.broadphase / m_stepsNumber;
+    m_average.narrowphase = m_sum.narrowphase / m_stepsNumber;
+    m_average.solver = m_sum.solver / m_stepsNumber;
+    m_average.integration = m_sum.integration / m_stepsNumber;
+    m_average.total = m_sum.total / m_stepsNumber;
+    m_average.activeBodies = m_sum.activeBodies / m_stepsNumber;
+    m_average.manifolds = m_sum.manifolds / m_stepsNumber;
+    m_average.awakeIslands = m_sum.awakeIslands / m_stepsNumber;
+    m_sum = StepProfile();
+    m_stepsNumber = 0;
+  }
+  profile = m_average;
+  return m_average.step > 0;
+}
+
+// -----------------------------------------------------------------------------
+double PhysicsProfiler::getSampleTime(CProfileIterator *iterator,
+                                      const char *name) {
+  double time = 0.0;
+  int childrenNumber = 0;
+  for (iterator->First(); !iterator->Is_Done(); iterator->Next()) {
+    if (std::strcmp(iterator->Get_Current_Name(), name) == 0)
+      time += iterator->Get_Current_Total_Time();
+    ++childrenNumber;
+  }
+  for (int child = 0; child < childrenNumber; ++child) {
+    iterator->Enter_Child(child);
+    time += getSampleTime(iterator, name);
+    iterator->Enter_Parent();
+  }
+  return time;
+}
+
+// -----------------------------------------------------------------------------
+// The samples are the ones btDiscreteDynamicsWorld opens for its stages.
+void PhysicsProfiler::readStages(StepProfile &profile) {
+#ifndef BT_NO_PROFILE
+  CProfileIterator *iterator = CProfileManager::Get_Iterator();
+  profile.broadphase = getSampleTime(iterator, "updateAabbs") +
+                       getSampleTime(iterator, "calculateOverlappingPairs");
+  profile.narrowphase = getSampleTime(iterator, "dispatchAllCollisionPairs");
+  profile.solver = getSampleTime(iterator, "calculateSimulationIslands") +
+                   getSampleTime(iterator, "solveConstraints");
+  profile.integration = getSampleTime(iterator, "predictUnconstraintMotion") +
+                        getSampleTime(iterator, "createPredictiveContacts") +
+                        getSampleTime(iterator, "integrateTransforms");
+  profile.total = getSampleTime(iterator, "stepSimulation");
+  CProfileManager::Release_Iterator(iterator);
+#else
+  (void)profile;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+void PhysicsProfiler::writeCsv(const StepProfile &profile) {
+  m_csv << profile.step << ',' << profile.broadphase << ','
+        << profile.narrowphase << ',' << profile.solver << ','
+        << profile.integration << ',' << profile.total << ','
+        << profile.activeBodies << ',' << profile.manifolds << ','
+        << profile.awakeIslands << '\n';
+}
@@ -1,7 +1,7 @@
 #include "Plane.h"
 
-#include "Drawer.h"
 #include "MathUtils.h"
+#include "ShapeCache.h"
 
 #include <glm/ext.hpp>
 #include <iostream>
@@ -15,7 +15,7 @@ Plane::Plane(const btTransform &transform, const btScalar mass, btVector3 &inert
              const btScalar side, const int textureRepetitions)
     : Object(transform, mass, inertia), m_textureRepetitions(textureRepetitions) {
   computePoints(side);
-  setupBulletShape();
+  setupBulletShape(side);
 }
 
 //-----------------------------------------------------------------------------
@@ -27,31 +27,26 @@ void Plane::computePoints(const btScalar side) {
   glm::vec3 third(halfSide, 0.f, -1.f * halfSide);
   glm::vec3 fourth(-1.f * halfSide, 0.f, -1.f * halfSide);
 
-  m_points = { first, second, third, fourth };
+  m_geometry->points = { first, second, third, fourth };
 
-  m_indices = { 0, 1, 2, 2, 3, 0 };
+  m_geometry->indices = { 0, 1, 2, 2, 3, 0 };
 
-  m_textureCoos = {{0, m_textureRepetitions},
-                 {m_textureRepetitions, m_textureRepetitions},
-                 {m_textureRepetitions, 0},
-                 {0, 0}};
+  m_geometry->textureCoos = {{0, m_textureRepetitions},
+                             {m_textureRepetitions, m_textureRepetitions},
+                             {m_textureRepetitions, 0},
+                             {0, 0}};
 
   glm::vec3 normal = computeNormal(first, second, third);
 
-  m_normals = { normal, normal, normal, normal }; 
+  m_geometry->normals = { normal, normal, normal, normal }; 
 
-  m_tangents.assign(4, {1, 0, 0});
+  m_geometry->tangents.assign(4, {1, 0, 0});
 }
 
 //-----------------------------------------------------------------------------
-void Plane::setupBulletShape() {
-  m_collisionShape =
-      new btConvexHullShape(getPoints(), getPointsNumber(), sizeof(glm::vec3));
-  m_collisionShape->calculateLocalInertia(m_mass, m_inertia);
-  m_motionState = new btDefaultMotionState(m_transform);
-  m_constructionInfo = new btRigidBody::btRigidBodyConstructionInfo(
-      m_mass, m_motionState, m_collisionShape, m_inertia);
-  m_rigidBody = new btRigidBody(*m_constructionInfo);
+void Plane::setupBulletShape(const btScalar side) {
+  m_collisionShape = ShapeCache::getInstance().acquirePlane(side);
+  setupRigidBody();
 }
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,336 @@
+#include "Recording.h"
+
+#include "TransformBuffer.h"
+
+#include <LinearMath/btQuaternion.h>
+#include <LinearMath/btTransform.h>
+#include <LinearMath/btVector3.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+const float RecordingCodec::POSITION_QUANTUM = 1.0f / 4096;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+uint32_t encodeZigzag(int32_t value);
+int32_t decodeZigzag(uint32_t value);
+bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value);
+void exitCorrupted(int frame);
+int16_t quantizeOrientation(btScalar component);
+
+const std::size_t INITIAL_CAPACITY = 1 << 20;
+
+// -----------------------------------------------------------------------------
+void RecordingCodec::resetState(int slotsNumber) {
+  m_positions.assign(3 * slotsNumber, 0);
+  m_orientations.assign(4 * slotsNumber, 0);
+  m_frozenFlags.assign(slotsNumber, false);
+}
+
+// -----------------------------------------------------------------------------
+Recorder::Recorder(const std::string &fileName, float stepsPerSecond)
+    : m_stepsPerSecond(stepsPerSecond) {
+  m_fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (m_fileDescriptor < 0) {
+    std::cerr << "Could not create recording: " << fileName << "\n";
+    exit(1);
+  }
+  reserve(INITIAL_CAPACITY);
+  m_size = HEADER_SIZE;
+}
+
+// -----------------------------------------------------------------------------
+Recorder::~Recorder() { close(); }
+
+// -----------------------------------------------------------------------------
+bool Recorder::recordFrame(const TransformBuffer &transforms) {
+  const int slotsNumber = transforms.getSize();
+  const bool keyframe = m_framesNumber % KEYFRAME_INTERVAL == 0;
+  if (m_framesNumber == 0) {
+    resetState(slotsNumber);
+    writeHeader();
+  }
+  // The header holds the slots number of every frame.
+  if (static_cast<int>(m_frozenFlags.size()) != slotsNumber)
+    return false;
+
+  m_slots.clear();
+  if (keyframe) {
+    resetState(slotsNumber);
+    for (int slot = 0; slot < slotsNumber; ++slot)
+      m_slots.push_back(slot);
+  } else {
+    // Increasing slots keep their deltas small.
+    m_slots = transforms.getDirtySlots();
+    std::sort(m_slots.begin(), m_slots.end());
+  }
+
+  reserve(m_size + FRAME_HEADER_SIZE + m_slots.size() * MAX_ENTRY_SIZE);
+  const std::size_t frameOffset = m_size;
+  m_size += FRAME_HEADER_SIZE;
+
+  int previousSlot = -1;
+  for (auto slot : m_slots) {
+    int32_t position[3];
+    for (int component = 0; component < 3; ++component)
+      position[component] = static_cast<int32_t>(std::lround(
+          transforms.getPositions(component)[slot] / m_positionQuantum));
+
+    // q and -q are the same rotation, a positive w keeps the deltas small.
+    const btScalar sign = transforms.getOrientations(3)[slot] < 0 ? -1 : 1;
+    int16_t orientation[4];
+    for (int component = 0; component < 4; ++component)
+      orientation[component] = quantizeOrientation(
+          sign * transforms.getOrientations(component)[slot]);
+
+    const bool frozen = transforms.isFrozen(slot);
+    if (!keyframe && frozen == m_frozenFlags[slot] &&
+        std::equal(position, position + 3, &m_positions[3 * slot]) &&
+        std::equal(orientation, orientation + 4, &m_orientations[4 * slot]))
+      continue;
+
+    writeEntry(slot, previousSlot, position, orientation, frozen);
+    std::copy(position, position + 3, &m_positions[3 * slot]);
+    std::copy(orientation, orientation + 4, &m_orientations[4 * slot]);
+    m_frozenFlags[slot] = frozen;
+    previousSlot = slot;
+  }
+
+  const uint32_t frameSize = m_size - frameOffset;
+  std::memcpy(m_data + frameOffset, &frameSize, sizeof(frameSize));
+  m_data[frameOffset + sizeof(frameSize)] = keyframe;
+  ++m_framesNumber;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+void Recorder::close() {
+  if (m_fileDescriptor < 0)
+    return;
+
+  writeHeader();
+  munmap(m_data, m_capacity);
+  if (ftruncate(m_fileDescriptor, m_size) != 0)
+    std::cerr << "Could not trim the recording\n";
+  ::close(m_fileDescriptor);
+  m_fileDescriptor = -1;
+  m_data = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Written with the first frame already, a recording cut short by a crash can
+// still be played.
+void Recorder::writeHeader() {
+  Header header = {MAGIC,
+                   VERSION,
+                   static_cast<uint32_t>(m_frozenFlags.size()),
+                   m_stepsPerSecond,
+                   m_positionQuantum,
+                   m_framesNumber};
+  std::memcpy(m_data, &header, HEADER_SIZE);
+}
+
+// -----------------------------------------------------------------------------
+// The file grows by doubling, it is mapped again every time.
+void Recorder::reserve(std::size_t size) {
+  if (size <= m_capacity)
+    return;
+
+  std::size_t capacity = std::max(2 * m_capacity, size);
+  if (m_data != nullptr)
+    munmap(m_data, m_capacity);
+  void *data = MAP_FAILED;
+  if (ftruncate(m_fileDescriptor, capacity) == 0)
+    data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                m_fileDescriptor, 0);
+  if (data == MAP_FAILED) {
+    std::cerr << "Could not map the recording\n";
+    exit(1);
+  }
+  m_data = static_cast<uint8_t *>(data);
+  m_capacity = capacity;
+}
+
+// -----------------------------------------------------------------------------
+void Recorder::writeVarint(uint32_t value) {
+  while (value >= 0x80) {
+    m_data[m_size++] = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  m_data[m_size++] = static_cast<uint8_t>(value);
+}
+
+// -----------------------------------------------------------------------------
+// Deltas from the last quantized state of the slot.
+void Recorder::writeEntry(int slot, int previousSlot, const int32_t *position,
+                          const int16_t *orientation, bool frozen) {
+  writeVarint(static_cast<uint32_t>(slot - previousSlot - 1) << 1 | frozen);
+  for (int component = 0; component < 3; ++component)
+    writeVarint(encodeZigzag(position[component] -
+                             m_positions[3 * slot + component]));
+  for (int component = 0; component < 4; ++component)
+    writeVarint(encodeZigzag(orientation[component] -
+                             m_orientations[4 * slot + component]));
+}
+
+// -----------------------------------------------------------------------------
+Player::Player(const std::string &fileName) {
+  m_fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if (m_fileDescriptor < 0 || fstat(m_fileDescriptor, &fileStat) != 0) {
+    std::cerr << "Could not open recording: " << fileName << "\n";
+    exit(1);
+  }
+
+  m_size = fileStat.st_size;
+  void *data = MAP_FAILED;
+  if (m_size >= HEADER_SIZE)
+    data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+  if (data != MAP_FAILED) {
+    m_data = static_cast<const uint8_t *>(data);
+    std::memcpy(&m_header, m_data, HEADER_SIZE);
+  }
+  if (data == MAP_FAILED || m_header.magic != MAGIC ||
+      m_header.version != VERSION) {
+    std::cerr << "Not a recording: " << fileName << "\n";
+    exit(1);
+  }
+  m_positionQuantum = m_header.positionQuantum;
+
+  // A recording cut short ends with the last whole frame.
+  std::size_t offset = HEADER_SIZE;
+  while (offset + FRAME_HEADER_SIZE <= m_size) {
+    uint32_t frameSize;
+    std::memcpy(&frameSize, m_data + offset, sizeof(frameSize));
+    if (frameSize < FRAME_HEADER_SIZE || offset + frameSize > m_size)
+      break;
+    m_frameOffsets.push_back(offset);
+    offset += frameSize;
+  }
+  resetState(m_header.slotsNumber);
+}
+
+// -----------------------------------------------------------------------------
+Player::~Player() {
+  if (m_data != nullptr)
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+  if (m_fileDescriptor >= 0)
+    close(m_fileDescriptor);
+}
+
+// -----------------------------------------------------------------------------
+bool Player::readFrame(TransformBuffer &transforms) {
+  if (isOver())
+    return false;
+  decodeFrame(m_frame++, &transforms);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+void Player::seek(int frame, TransformBuffer &transforms) {
+  if (m_frameOffsets.empty())
+    return;
+
+  frame = std::max(0, std::min(frame, getFramesNumber() - 1));
+  for (int index = frame / KEYFRAME_INTERVAL * KEYFRAME_INTERVAL;
+       index <= frame; ++index)
+    decodeFrame(index, nullptr);
+  for (int slot = 0; slot < getSlotsNumber(); ++slot)
+    writeSlot(slot, transforms);
+  m_frame = frame + 1;
+}
+
+// -----------------------------------------------------------------------------
+// Update the quantized state with the frame, and the transforms if any. A
+// frame running past its end or listing a slot past the last one is corrupted.
+void Player::decodeFrame(int frame, TransformBuffer *transforms) {
+  const uint8_t *data = m_data + m_frameOffsets[frame];
+  uint32_t frameSize;
+  std::memcpy(&frameSize, data, sizeof(frameSize));
+  const uint8_t *frameEnd = data + frameSize;
+  if (data[sizeof(frameSize)] != 0)
+    resetState(getSlotsNumber());
+
+  data += FRAME_HEADER_SIZE;
+  int slot = -1;
+  while (data < frameEnd) {
+    uint32_t slotDelta;
+    if (!readVarint(data, frameEnd, slotDelta) ||
+        (slotDelta >> 1) >= static_cast<uint32_t>(getSlotsNumber() - slot - 1))
+      exitCorrupted(frame);
+    slot += (slotDelta >> 1) + 1;
+    m_frozenFlags[slot] = slotDelta & 1;
+    uint32_t delta;
+    for (int component = 0; component < 3; ++component) {
+      if (!readVarint(data, frameEnd, delta))
+        exitCorrupted(frame);
+      m_positions[3 * slot + component] += decodeZigzag(delta);
+    }
+    for (int component = 0; component < 4; ++component) {
+      if (!readVarint(data, frameEnd, delta))
+        exitCorrupted(frame);
+      m_orientations[4 * slot + component] += decodeZigzag(delta);
+    }
+
+    if (transforms != nullptr)
+      writeSlot(slot, *transforms);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void Player::writeSlot(int slot, TransformBuffer &transforms) const {
+  const int32_t *position = &m_positions[3 * slot];
+  const int16_t *orientation = &m_orientations[4 * slot];
+  btQuaternion rotation(orientation[0], orientation[1], orientation[2],
+                        orientation[3]);
+  btVector3 origin(position[0], position[1], position[2]);
+  transforms.setTransform(
+      slot, btTransform(rotation.normalized(), origin * m_positionQuantum));
+  if (transforms.isFrozen(slot) != m_frozenFlags[slot])
+    transforms.setFrozen(slot, m_frozenFlags[slot]);
+}
+
+// -----------------------------------------------------------------------------
+uint32_t encodeZigzag(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+// -----------------------------------------------------------------------------
+int32_t decodeZigzag(uint32_t value) {
+  return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+// -----------------------------------------------------------------------------
+// False when the varint runs past end, or is longer than five bytes.
+bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 35 && data < end; shift += 7) {
+    const uint8_t byte = *data++;
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+void exitCorrupted(int frame) {
+  std::cerr << "Corrupted recording at frame " << frame << "\n";
+  exit(1);
+}
+
+// -----------------------------------------------------------------------------
+int16_t quantizeOrientation(btScalar component) {
+  const long scale = RecordingCodec::ORIENTATION_SCALE;
+  const long value = std::lround(component * scale);
+  return static_cast<int16_t>(std::max(-scale, std::min(value, scale)));
+}
@@ -0,0 +1,446 @@
+#include "RegionGrid.h"
+
+#include <BulletDynamics/Dynamics/btRigidBody.h>
+#include <LinearMath/btQuickprof.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+const btScalar RegionGrid::DEFAULT_OVERLAP = 4;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+btScalar getMass(const btRigidBody *body);
+btVector3 getInertia(const btRigidBody *body);
+
+// -----------------------------------------------------------------------------
+RegionGrid::RegionGrid(const Engine &settings, int columns, int rows,
+                       btScalar overlap, int threadsNumber)
+    : m_columns(columns), m_rows(rows), m_overlap(overlap),
+      m_worldMin(settings.getWorldMin()), m_threadPool(threadsNumber) {
+  assert(columns > 0 && rows > 0 && "A grid needs at least one region");
+  assert(overlap >= 0 && "The overlap cannot be negative");
+  const btVector3 &worldMax = settings.getWorldMax();
+  m_cellWidth = (worldMax.x() - m_worldMin.x()) / columns;
+  m_cellDepth = (worldMax.z() - m_worldMin.z()) / rows;
+
+  // The sweep and prune bounds of a region take in its ghosts.
+  for (int row = 0; row < rows; ++row) {
+    for (int column = 0; column < columns; ++column) {
+      btVector3 cellMin(m_worldMin.x() + column * m_cellWidth - overlap,
+                        m_worldMin.y(),
+                        m_worldMin.z() + row * m_cellDepth - overlap);
+      btVector3 cellMax(cellMin.x() + m_cellWidth + 2 * overlap, worldMax.y(),
+                        cellMin.z() + m_cellDepth + 2 * overlap);
+      m_engines.emplace_back(new Engine());
+      m_engines.back()->setWorldBounds(cellMin, cellMax);
+    }
+  }
+  configure(settings);
+}
+
+// -----------------------------------------------------------------------------
+// The engines give the proxies back before the ghosts go.
+RegionGrid::~RegionGrid() {
+  m_engines.clear();
+  for (const auto &body : m_bodies) {
+    for (const auto &ghost : body.ghosts)
+      delete ghost.body;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::configure(const Engine &settings) {
+  const btVector3 gravity = settings.getDynamicsWorld()->getGravity();
+  for (auto &engine : m_engines) {
+    engine->setSolverType(settings.getSolverType());
+    engine->setBroadphaseType(settings.getBroadphaseType());
+    engine->setSolverIterations(settings.getMinSolverIterations(),
+                                settings.getMaxSolverIterations(),
+                                settings.getStepBudget());
+    engine->setGravity(gravity);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::addRigidBody(btRigidBody *rigidBody,
+                              const CollisionFilter &filter, bool dynamic) {
+  btVector3 center;
+  btScalar radius;
+  rigidBody->getCollisionShape()->getBoundingSphere(center, radius);
+  const btVector3 &position = rigidBody->getWorldTransform().getOrigin();
+
+  m_bodyIndices[rigidBody] = m_bodies.size();
+  m_bodies.push_back({rigidBody, center.length() + radius,
+                      findRegion(position), dynamic, filter, {}});
+  Body &body = m_bodies.back();
+  m_engines[body.region]->addRigidBody(rigidBody, filter, body.dynamic);
+  updateBody(body);
+}
+
+// -----------------------------------------------------------------------------
+// Every region takes its bodies in bulk, then the ghosts are made.
+void RegionGrid::addRigidBodies(btRigidBody *const *rigidBodies,
+                                const CollisionFilter *filters,
+                                const bool *dynamic, int bodiesNumber) {
+  const int firstBody = m_bodies.size();
+  m_bodies.reserve(firstBody + bodiesNumber);
+  m_bodyIndices.reserve(firstBody + bodiesNumber);
+  std::vector<std::vector<int>> regionIndices(m_engines.size());
+  for (int index = 0; index < bodiesNumber; ++index) {
+    btRigidBody *rigidBody = rigidBodies[index];
+    btVector3 center;
+    btScalar radius;
+    rigidBody->getCollisionShape()->getBoundingSphere(center, radius);
+    const btVector3 &position = rigidBody->getWorldTransform().getOrigin();
+
+    m_bodyIndices[rigidBody] = m_bodies.size();
+    m_bodies.push_back({rigidBody, center.length() + radius,
+                        findRegion(position), dynamic[index], filters[index],
+                        {}});
+    regionIndices[m_bodies.back().region].push_back(m_bodies.size() - 1);
+  }
+
+  std::vector<btRigidBody *> regionBodies;
+  std::vector<CollisionFilter> regionFilters;
+  std::unique_ptr<bool[]> regionDynamic(new bool[bodiesNumber]);
+  for (int region = 0; region < getRegionsNumber(); ++region) {
+    if (regionIndices[region].empty())
+      continue;
+    regionBodies.clear();
+    regionFilters.clear();
+    for (auto index : regionIndices[region]) {
+      regionDynamic[regionBodies.size()] = m_bodies[index].dynamic;
+      regionBodies.push_back(m_bodies[index].body);
+      regionFilters.push_back(m_bodies[index].filter);
+    }
+    m_engines[region]->addRigidBodies(regionBodies.data(),
+                                      regionFilters.data(),
+                                      regionDynamic.get(),
+                                      regionBodies.size());
+  }
+  for (int body = firstBody; body < static_cast<int>(m_bodies.size()); ++body)
+    updateBody(m_bodies[body]);
+}
+
+// -----------------------------------------------------------------------------
+// The last body takes the place of every body removed.
+void RegionGrid::removeRigidBodies(btRigidBody *const *rigidBodies,
+                                   int bodiesNumber) {
+  std::vector<std::vector<btRigidBody *>> regionBodies(m_engines.size());
+  std::vector<btRigidBody *> ghosts;
+  for (int index = 0; index < bodiesNumber; ++index) {
+    auto bodyIndex = m_bodyIndices.find(rigidBodies[index]);
+    assert(bodyIndex != m_bodyIndices.end() && "The body is not in the grid");
+    Body &body = m_bodies[bodyIndex->second];
+    regionBodies[body.region].push_back(body.body);
+    for (const auto &ghost : body.ghosts) {
+      regionBodies[ghost.region].push_back(ghost.body);
+      ghosts.push_back(ghost.body);
+    }
+
+    if (bodyIndex->second != static_cast<int>(m_bodies.size()) - 1) {
+      body = std::move(m_bodies.back());
+      m_bodyIndices[body.body] = bodyIndex->second;
+    }
+    m_bodies.pop_back();
+    m_bodyIndices.erase(bodyIndex);
+  }
+
+  for (int region = 0; region < getRegionsNumber(); ++region)
+    m_engines[region]->removeRigidBodies(regionBodies[region].data(),
+                                         regionBodies[region].size());
+  for (auto ghost : ghosts)
+    delete ghost;
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::setCollisionFilters(btRigidBody *const *rigidBodies,
+                                     const CollisionFilter *filters,
+                                     int bodiesNumber) {
+  std::vector<std::vector<btRigidBody *>> regionBodies(m_engines.size());
+  std::vector<std::vector<CollisionFilter>> regionFilters(m_engines.size());
+  for (int index = 0; index < bodiesNumber; ++index) {
+    auto bodyIndex = m_bodyIndices.find(rigidBodies[index]);
+    assert(bodyIndex != m_bodyIndices.end() && "The body is not in the grid");
+    Body &body = m_bodies[bodyIndex->second];
+    body.filter = filters[index];
+    regionBodies[body.region].push_back(body.body);
+    regionFilters[body.region].push_back(body.filter);
+    for (const auto &ghost : body.ghosts) {
+      regionBodies[ghost.region].push_back(ghost.body);
+      regionFilters[ghost.region].push_back(body.filter);
+    }
+  }
+
+  for (int region = 0; region < getRegionsNumber(); ++region) {
+    if (!regionBodies[region].empty())
+      m_engines[region]->setCollisionFilters(regionBodies[region].data(),
+                                             regionFilters[region].data(),
+                                             regionBodies[region].size());
+  }
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::stepSimulation(btScalar timeStep) {
+  // A ghost at rest next to a body at rest has nothing to catch up with.
+  for (auto &body : m_bodies) {
+    for (auto &ghost : body.ghosts) {
+      if (body.body->isActive() || ghost.body->isActive() ||
+          body.body->getInvMass() != ghost.body->getInvMass())
+        syncGhost(body.body, ghost.body);
+    }
+  }
+
+  // Only the calling thread records the profile, across all the regions it
+  // steps.
+#ifndef BT_NO_PROFILE
+  CProfileManager::Reset();
+  CProfileManager::Hold_Reset(true);
+#endif
+  m_threadPool.run(m_engines.size(), [&](int region, int) {
+    m_engines[region]->stepSimulation(timeStep);
+  });
+#ifndef BT_NO_PROFILE
+  CProfileManager::Hold_Reset(false);
+#endif
+
+  // Sleeping and static bodies did not move.
+  for (auto &body : m_bodies) {
+    if (body.body->isActive() && !body.body->isStaticOrKinematicObject())
+      updateBody(body);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::resetBodies() {
+  for (auto &body : m_bodies) {
+    updateBody(body);
+    for (auto &ghost : body.ghosts)
+      syncGhost(body.body, ghost.body);
+  }
+  for (auto &engine : m_engines) {
+    btDiscreteDynamicsWorld *dynamicsWorld = engine->getDynamicsWorld();
+    btCollisionObjectArray &objects = dynamicsWorld->getCollisionObjectArray();
+    for (int index = 0; index < objects.size(); ++index)
+      dynamicsWorld->updateSingleAabb(objects[index]);
+    engine->resetContacts();
+  }
+}
+
+// -----------------------------------------------------------------------------
+int RegionGrid::getActiveRigidBodiesNumber() const {
+  int activeNumber = 0;
+  for (const auto &body : m_bodies) {
+    if (body.body->isActive() && !body.body->isStaticOrKinematicObject())
+      ++activeNumber;
+  }
+  return activeNumber;
+}
+
+// -----------------------------------------------------------------------------
+int RegionGrid::getGhostsNumber() const {
+  int ghostsNumber = 0;
+  for (const auto &body : m_bodies)
+    ghostsNumber += body.ghosts.size();
+  return ghostsNumber;
+}
+
+// -----------------------------------------------------------------------------
+int RegionGrid::getManifoldsNumber() const {
+  int manifoldsNumber = 0;
+  for (const auto &engine : m_engines)
+    manifoldsNumber += engine->getManifoldsNumber();
+  return manifoldsNumber;
+}
+
+// -----------------------------------------------------------------------------
+int RegionGrid::getAwakeIslandsNumber() const {
+  int islandsNumber = 0;
+  for (const auto &engine : m_engines)
+    islandsNumber += engine->getAwakeIslandsNumber();
+  return islandsNumber;
+}
+
+// -----------------------------------------------------------------------------
+int RegionGrid::getSolverIterations() const {
+  int iterations = 0;
+  for (const auto &engine : m_engines)
+    iterations = std::max(iterations, engine->getSolverIterations());
+  return iterations;
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::getDispatchers(
+    std::vector<btDispatcher *> &dispatchers) const {
+  for (const auto &engine : m_engines)
+    dispatchers.push_back(engine->getDynamicsWorld()->getDispatcher());
+}
+
+// -----------------------------------------------------------------------------
+const btCollisionObject *
+RegionGrid::getOwner(const btCollisionObject *object) {
+  if (object->getUserPointer() == nullptr)
+    return object;
+  return static_cast<const btCollisionObject *>(object->getUserPointer());
+}
+
+// -----------------------------------------------------------------------------
+// Bodies outside the bounds belong to the regions on the border.
+int RegionGrid::findRegion(const btVector3 &position) const {
+  return findRow(position.z()) * m_columns + findColumn(position.x());
+}
+
+// -----------------------------------------------------------------------------
+int RegionGrid::findColumn(btScalar x) const {
+  int column = static_cast<int>(std::floor((x - m_worldMin.x()) / m_cellWidth));
+  return std::max(0, std::min(column, m_columns - 1));
+}
+
+// -----------------------------------------------------------------------------
+int RegionGrid::findRow(btScalar z) const {
+  int row = static_cast<int>(std::floor((z - m_worldMin.z()) / m_cellDepth));
+  return std::max(0, std::min(row, m_rows - 1));
+}
+
+// -----------------------------------------------------------------------------
+// Hand the body off once it is half the overlap past the border of its
+// region, so that a body resting on the border stays where it is. Then give
+// it a ghost in every other region within overlap, and none elsewhere.
+void RegionGrid::updateBody(Body &body) {
+  const btVector3 &position = body.body->getWorldTransform().getOrigin();
+  const btScalar margin = m_overlap / 2;
+  const int regionColumn = body.region % m_columns;
+  const int regionRow = body.region / m_columns;
+  if (regionColumn < findColumn(position.x() - margin) ||
+      regionColumn > findColumn(position.x() + margin) ||
+      regionRow < findRow(position.z() - margin) ||
+      regionRow > findRow(position.z() + margin))
+    handOff(body, findRegion(position));
+
+  const btScalar reach = body.radius + m_overlap;
+  m_ghostRegions.clear();
+  for (int row = findRow(position.z() - reach);
+       row <= findRow(position.z() + reach); ++row) {
+    for (int column = findColumn(position.x() - reach);
+         column <= findColumn(position.x() + reach); ++column) {
+      if (row * m_columns + column != body.region)
+        m_ghostRegions.push_back(row * m_columns + column);
+    }
+  }
+
+  // Swap and pop the ghosts out of reach.
+  for (size_t index = 0; index < body.ghosts.size();) {
+    const Ghost &ghost = body.ghosts[index];
+    if (std::find(m_ghostRegions.begin(), m_ghostRegions.end(),
+                  ghost.region) != m_ghostRegions.end()) {
+      ++index;
+      continue;
+    }
+    destroyGhost(ghost);
+    body.ghosts[index] = body.ghosts.back();
+    body.ghosts.pop_back();
+  }
+
+  for (auto ghostRegion : m_ghostRegions) {
+    if (std::none_of(body.ghosts.begin(), body.ghosts.end(),
+                     [ghostRegion](const Ghost &ghost) {
+                       return ghost.region == ghostRegion;
+                     }))
+      createGhost(body, ghostRegion);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// The ghost the body may have in its new region is in the way.
+void RegionGrid::handOff(Body &body, int region) {
+  for (size_t index = 0; index < body.ghosts.size(); ++index) {
+    if (body.ghosts[index].region == region) {
+      destroyGhost(body.ghosts[index]);
+      body.ghosts[index] = body.ghosts.back();
+      body.ghosts.pop_back();
+      break;
+    }
+  }
+
+  m_engines[body.region]->removeRigidBody(body.body);
+  addToRegion(body.body, region, body);
+  body.region = region;
+  ++m_handOffsNumber;
+}
+
+// -----------------------------------------------------------------------------
+// The body or its ghost goes in with the filter of the body, and as a dynamic
+// body if the body is one, frozen or not.
+void RegionGrid::addToRegion(btRigidBody *rigidBody, int region,
+                             const Body &body) {
+  m_engines[region]->addRigidBody(rigidBody, body.filter, body.dynamic);
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::createGhost(Body &body, int region) {
+  btRigidBody *owner = body.body;
+  btRigidBody::btRigidBodyConstructionInfo constructionInfo(
+      getMass(owner), nullptr, owner->getCollisionShape(), getInertia(owner));
+  constructionInfo.m_startWorldTransform = owner->getWorldTransform();
+  constructionInfo.m_linearDamping = owner->getLinearDamping();
+  constructionInfo.m_angularDamping = owner->getAngularDamping();
+  constructionInfo.m_friction = owner->getFriction();
+  constructionInfo.m_rollingFriction = owner->getRollingFriction();
+  constructionInfo.m_restitution = owner->getRestitution();
+  constructionInfo.m_linearSleepingThreshold =
+      owner->getLinearSleepingThreshold();
+  constructionInfo.m_angularSleepingThreshold =
+      owner->getAngularSleepingThreshold();
+
+  btRigidBody *ghost = new btRigidBody(constructionInfo);
+  ghost->setCcdMotionThreshold(owner->getCcdMotionThreshold());
+  ghost->setCcdSweptSphereRadius(owner->getCcdSweptSphereRadius());
+  ghost->setUserPointer(owner);
+  addToRegion(ghost, region, body);
+  syncGhost(owner, ghost);
+  body.ghosts.push_back({region, ghost});
+}
+
+// -----------------------------------------------------------------------------
+void RegionGrid::destroyGhost(const Ghost &ghost) {
+  m_engines[ghost.region]->removeRigidBody(ghost.body);
+  delete ghost.body;
+}
+
+// -----------------------------------------------------------------------------
+// Frozen bodies turn static and back, the ghost follows the mass.
+void RegionGrid::syncGhost(const btRigidBody *owner, btRigidBody *ghost) {
+  if (owner->getInvMass() != ghost->getInvMass()) {
+    ghost->setMassProps(getMass(owner), getInertia(owner));
+    ghost->updateInertiaTensor();
+  }
+  ghost->setWorldTransform(owner->getWorldTransform());
+  ghost->setInterpolationWorldTransform(
+      owner->getInterpolationWorldTransform());
+  ghost->setLinearVelocity(owner->getLinearVelocity());
+  ghost->setAngularVelocity(owner->getAngularVelocity());
+  ghost->setInterpolationLinearVelocity(
+      owner->getInterpolationLinearVelocity());
+  ghost->setInterpolationAngularVelocity(
+      owner->getInterpolationAngularVelocity());
+  ghost->forceActivationState(owner->getActivationState());
+  ghost->setDeactivationTime(owner->getDeactivationTime());
+}
+
+// -----------------------------------------------------------------------------
+btScalar getMass(const btRigidBody *body) {
+  return body->getInvMass() == 0 ? 0 : 1 / body->getInvMass();
+}
+
+// -----------------------------------------------------------------------------
+btVector3 getInertia(const btRigidBody *body) {
+  const btVector3 &inverse = body->getInvInertiaDiagLocal();
+  btVector3 inertia(0, 0, 0);
+  for (int axis = 0; axis < 3; ++axis) {
+    if (inverse[axis] != 0)
+      inertia[axis] = 1 / inverse[axis];
+  }
+  return inertia;
+}
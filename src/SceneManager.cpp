@@ -10,6 +10,8 @@
 #include "World.h"
 
 #include <algorithm>
+#include <iomanip>
+#include <sstream>
 #include <thread>
 
 #include <glm/vec2.hpp>
@@ -24,6 +26,7 @@ const std::string SceneManager::FONT_FILE = "VeraMono.ttf";
 SceneManager::SceneManager(const glm::ivec2 screenSize,
                            SceneContainer *container)
     : m_world(container->getWorld()), m_camera(container->getCamera()),
+      m_simulation(m_world),
       #ifndef WINDOWS
       m_textManager(TextManager(FONT_PATH + FONT_FILE, FONT_HEIGHT, screenSize)),
       #endif
@@ -62,6 +65,7 @@ void SceneManager::initGPU(SceneContainer *container) {
 
 // -----------------------------------------------------------------------------
 SceneManager::~SceneManager() {
+  m_simulation.stop();
   delete m_world;
   delete m_camera;
   glUseProgram(0);
@@ -71,6 +75,11 @@ SceneManager::~SceneManager() {
 // -----------------------------------------------------------------------------
 void SceneManager::drawScene() { 
 //  auto begin = std::chrono::system_clock::now();
+  // Every pass of the frame draws the objects at the same simulation step.
+  m_simulation.syncWorld();
+  drainContactEvents();
+  m_hasStepProfile = m_world->takeStepProfile(m_stepProfile);
+  m_drawer.updateStaticBatches(m_world);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   m_mirrorPass(this);
   //shadowRenderingPass();
@@ -162,11 +171,38 @@ void SceneManager::drawText() {
   #ifndef WINDOWS
   glDisable(GL_DEPTH_TEST);
   m_textManager.addText("Frames per second: " + std::to_string(m_fps), { 0, 780 });
+  if (m_world->hasContactEvents())
+    m_textManager.addText("Hits: " + std::to_string(m_contactHits), {0, 760});
+  if (m_hasStepProfile) {
+    std::ostringstream stages;
+    stages << std::fixed << std::setprecision(2)
+           << "Step " << m_stepProfile.total << " ms: broadphase "
+           << m_stepProfile.broadphase << ", narrowphase "
+           << m_stepProfile.narrowphase << ", solver " << m_stepProfile.solver
+           << ", integration " << m_stepProfile.integration;
+    m_textManager.addText(stages.str(), {0, 740});
+    m_textManager.addText(
+        "Active: " + std::to_string(m_stepProfile.activeBodies) +
+            ", manifolds: " + std::to_string(m_stepProfile.manifolds) +
+            ", islands: " + std::to_string(m_stepProfile.awakeIslands),
+        {0, 720});
+  }
   m_textManager.renderText();
   glEnable(GL_DEPTH_TEST);
   #endif
 }
 
+// -----------------------------------------------------------------------------
+// Empty the queue every frame, the simulation drops the events that do not
+// fit.
+void SceneManager::drainContactEvents() {
+  ContactEvent event;
+  while (m_world->popContactEvent(event)) {
+    if (event.type == ContactEvent::Type::ceBegin)
+      ++m_contactHits;
+  }
+}
+
 // -----------------------------------------------------------------------------
 void SceneManager::setFps(int fps) { m_fps = fps; }
 
@@ -215,4 +251,20 @@ void SceneManager::updateLightMask(int lightMask) {
 }
 
 // -----------------------------------------------------------------------------
-void SceneManager::stepSimulation() { m_world->stepSimulation(); }
+void SceneManager::startSimulation() {
+  m_world->snapshot();
+  m_simulation.start();
+}
+
+// -----------------------------------------------------------------------------
+void SceneManager::stopSimulation() { m_simulation.stop(); }
+
+// -----------------------------------------------------------------------------
+void SceneManager::skipPlayback(int seconds) {
+  if (seconds != 0 && m_world->isPlayingBack())
+    m_world->skipPlayback(
+        static_cast<int>(seconds * m_world->getStepsPerSecond()));
+}
+
+// -----------------------------------------------------------------------------
+void SceneManager::resetWorld() { m_world->requestRestore(); }
@@ -5,6 +5,7 @@
 
 #include "Box.h"
 #include "Camera.h"
+#include "DominoLayout.h"
 #include "Light.h"
 #include "LightBulb.h"
 #include "Mesh.h"
@@ -16,12 +17,18 @@
 
 #include <iostream>
 
+// Support functions.
+// -----------------------------------------------------------------------------
+int checkCollisionLayer(lua_State *luaState, int index,
+                        const ScriptEngine *engine);
+
 SceneContainer *tmpContainer = nullptr;
 
 static luaL_Reg ScriptEngineTable[] = {{nullptr, nullptr}};
 
 static luaL_Reg ScriptEngineMetatable[] = {
     {"_addBox", addBox},
+    {"_addDominoes", addDominoes},
     {"_addLightBulb", addLightBulb},
     {"_addDirectionalLight", addDirectionalLight},
     {"_addMesh", addMesh},
@@ -32,6 +39,19 @@ static luaL_Reg ScriptEngineMetatable[] = {
     {"_setBackgroundColor", setBackgroundColor},
     {"_setCamera", setCamera},
     {"_setGravity", setGravity},
+    {"_setPhysicsRate", setPhysicsRate},
+    {"_setPhysicsSolver", setPhysicsSolver},
+    {"_setSolverIterations", setSolverIterations},
+    {"_setPhysicsBroadphase", setPhysicsBroadphase},
+    {"_setWorldBounds", setWorldBounds},
+    {"_setPhysicsThreads", setPhysicsThreads},
+    {"_setSettleTime", setSettleTime},
+    {"_setContactEvents", setContactEvents},
+    {"_setPhysicsProfile", setPhysicsProfile},
+    {"_setPhysicsRegions", setPhysicsRegions},
+    {"_setCollisionLayer", setCollisionLayer},
+    {"_recordSimulation", recordSimulation},
+    {"_playRecording", playRecording},
     {nullptr, nullptr}};
 
 ScriptEngine *NewScriptEngine(lua_State *) {
@@ -80,6 +100,172 @@ int setGravity(lua_State *m_luaState) {
   return 0;
 }
 
+// -----------------------------------------------------------------------------
+int setPhysicsSolver(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  std::string solverName = luaL_checkstring(m_luaState, 2);
+
+  SolverType solverType = SolverType::stSequential;
+  if (solverName == "islands")
+    solverType = SolverType::stIslands;
+  else if (solverName == "batches")
+    solverType = SolverType::stBatches;
+  else if (solverName == "dantzig")
+    solverType = SolverType::stDantzig;
+  else if (solverName == "pgs")
+    solverType = SolverType::stProjectedGaussSeidel;
+  else if (solverName == "simd")
+    solverType = SolverType::stSimd;
+  else if (solverName != "sequential") {
+    std::cerr << "Unknown physics solver: " << solverName << "\n";
+    exit(1);
+  }
+
+  engine->m_container->setPhysicsSolver(solverType);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setSolverIterations(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  int minIterations = static_cast<int>(luaL_checkinteger(m_luaState, 2));
+  int maxIterations = static_cast<int>(luaL_checkinteger(m_luaState, 3));
+  double stepBudget = luaL_checknumber(m_luaState, 4);
+
+  engine->m_container->setSolverIterations(minIterations, maxIterations,
+                                           stepBudget);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setPhysicsBroadphase(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  std::string broadphaseName = luaL_checkstring(m_luaState, 2);
+
+  BroadphaseType broadphaseType = BroadphaseType::bpDbvt;
+  if (broadphaseName == "sap")
+    broadphaseType = BroadphaseType::bpAxisSweep;
+  else if (broadphaseName == "sap32")
+    broadphaseType = BroadphaseType::bpAxisSweep32;
+  else if (broadphaseName == "simple")
+    broadphaseType = BroadphaseType::bpSimple;
+  else if (broadphaseName != "dbvt") {
+    std::cerr << "Unknown physics broadphase: " << broadphaseName << "\n";
+    exit(1);
+  }
+
+  engine->m_container->setPhysicsBroadphase(broadphaseType);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setWorldBounds(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  float minX = static_cast<float>(luaL_checknumber(m_luaState, 2));
+  float minY = static_cast<float>(luaL_checknumber(m_luaState, 3));
+  float minZ = static_cast<float>(luaL_checknumber(m_luaState, 4));
+  float maxX = static_cast<float>(luaL_checknumber(m_luaState, 5));
+  float maxY = static_cast<float>(luaL_checknumber(m_luaState, 6));
+  float maxZ = static_cast<float>(luaL_checknumber(m_luaState, 7));
+
+  engine->m_container->setWorldBounds({minX, minY, minZ}, {maxX, maxY, maxZ});
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setPhysicsRate(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  float stepsPerSecond = static_cast<float>(luaL_checknumber(m_luaState, 2));
+  int maxSubsteps = static_cast<int>(luaL_checkinteger(m_luaState, 3));
+
+  engine->m_container->setPhysicsRate(stepsPerSecond, maxSubsteps);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setPhysicsThreads(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  int threadsNumber = static_cast<int>(luaL_checkinteger(m_luaState, 2));
+
+  engine->m_container->setPhysicsThreads(threadsNumber);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setSettleTime(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  float settleTime = static_cast<float>(luaL_checknumber(m_luaState, 2));
+
+  engine->m_container->setSettleTime(settleTime);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setContactEvents(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  bool enabled = lua_toboolean(m_luaState, 2);
+
+  engine->m_container->setContactEvents(enabled);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setPhysicsProfile(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  bool enabled = lua_toboolean(m_luaState, 2);
+  std::string csvFile = luaL_optstring(m_luaState, 3, "");
+
+  engine->m_container->setPhysicsProfile(enabled, csvFile);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int setPhysicsRegions(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  int columns = static_cast<int>(luaL_checkinteger(m_luaState, 2));
+  int rows = static_cast<int>(luaL_checkinteger(m_luaState, 3));
+  float overlap = static_cast<float>(luaL_checknumber(m_luaState, 4));
+
+  engine->m_container->setPhysicsRegions(columns, rows, overlap);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// The colliding layers come as a table of names.
+int setCollisionLayer(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  std::string name = luaL_checkstring(m_luaState, 2);
+  luaL_checktype(m_luaState, 3, LUA_TTABLE);
+  std::vector<std::string> collidingLayers;
+  const int layersNumber = static_cast<int>(lua_rawlen(m_luaState, 3));
+  for (int index = 1; index <= layersNumber; ++index) {
+    lua_rawgeti(m_luaState, 3, index);
+    collidingLayers.push_back(luaL_checkstring(m_luaState, -1));
+    lua_pop(m_luaState, 1);
+  }
+
+  engine->m_container->setCollisionLayer(name, collidingLayers);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int recordSimulation(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  std::string fileName = luaL_checkstring(m_luaState, 2);
+
+  engine->m_container->recordSimulation(fileName);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int playRecording(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  std::string fileName = luaL_checkstring(m_luaState, 2);
+
+  engine->m_container->playRecording(fileName);
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 int setBackgroundColor(lua_State *m_luaState) {
   ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
@@ -141,6 +327,7 @@ int addLightBulb(lua_State *m_luaState) {
       static_cast<float>(luaL_checknumber(m_luaState, 24));
   const char *textureFile = luaL_checkstring(m_luaState, 25);
   const char *shaderFile = luaL_checkstring(m_luaState, 26);
+  int layer = checkCollisionLayer(m_luaState, 27, engine);
 
   PositionalLight *light =
       engine->m_lightBuilder.setPosition(
@@ -167,6 +354,7 @@ int addLightBulb(lua_State *m_luaState) {
           .setLight(light)
           .setTextureFile(textureFile)
           .create();
+  bulb->setCollisionLayer(layer);
 
   engine->m_container->addShader(bulb, std::string(shaderFile));
   engine->m_container->addLightBulb(bulb);
@@ -294,6 +482,7 @@ int addPlane(lua_State *m_luaState) {
   const char *normalTextureFile = luaL_checkstring(m_luaState, 23);
   int textureRepetitions = static_cast<int>(luaL_checknumber(m_luaState, 24));
   const char *shaderFile = luaL_checkstring(m_luaState, 25);
+  int layer = checkCollisionLayer(m_luaState, 26, engine);
 
   PlaneBuilder planeBuilder;
   btQuaternion rotation(rotationX, rotationY, rotationZ);
@@ -313,6 +502,7 @@ int addPlane(lua_State *m_luaState) {
           .setNormalTextureFile(normalTextureFile)
           .setTextureRepetitions(textureRepetitions)
           .create();
+  plane->setCollisionLayer(layer);
 
   engine->m_container->addShader(plane, std::string(shaderFile));
   engine->m_container->addObject(plane);
@@ -331,6 +521,7 @@ int addMirror(lua_State *m_luaState) {
   float positionZ = static_cast<float>(luaL_checknumber(m_luaState, 8));
   float rotationX = static_cast<float>(luaL_checknumber(m_luaState, 9));
   float rotationY = static_cast<float>(luaL_checknumber(m_luaState, 10));
+  int layer = checkCollisionLayer(m_luaState, 11, engine);
 
   MirrorBuilder mirrorBuilder;
   btQuaternion rotation(rotationX, rotationY, 0.f);
@@ -341,6 +532,7 @@ int addMirror(lua_State *m_luaState) {
           .setSides({sideX, sideY, sideZ})
           .setMass(mass)
           .create();
+  mirror->setCollisionLayer(layer);
 
   engine->m_container->addShader(mirror, "mirror");
   engine->m_container->setMirror(mirror);
@@ -375,8 +567,16 @@ int addBox(lua_State *m_luaState) {
   const char *textureFile = luaL_checkstring(m_luaState, 24);
   const char *normalTextureFile = luaL_checkstring(m_luaState, 25);
   const char *shaderFile = luaL_checkstring(m_luaState, 26);
+  int layer = checkCollisionLayer(m_luaState, 29, engine);
 
   BoxBuilder boxBuilder;
+  // Left to the builder unless given.
+  if (!lua_isnoneornil(m_luaState, 27))
+    boxBuilder.setCcdMotionThreshold(
+        static_cast<float>(luaL_checknumber(m_luaState, 27)));
+  if (!lua_isnoneornil(m_luaState, 28))
+    boxBuilder.setCcdSweptSphereRadius(
+        static_cast<float>(luaL_checknumber(m_luaState, 28)));
   btQuaternion rotation(rotationX, rotationY, rotationZ);
   Box *box = boxBuilder.setTransform(btTransform(rotation,
                                                  btVector3(positionX, positionY,
@@ -392,12 +592,93 @@ int addBox(lua_State *m_luaState) {
                  .setTextureFile(textureFile)
                  .setNormalTextureFile(normalTextureFile)
                  .create();
+  box->setCollisionLayer(layer);
 
   engine->m_container->addShader(box, std::string(shaderFile));
   engine->m_container->addObject(box);
   return 0;
 }
 
+// -----------------------------------------------------------------------------
+// The path comes as its name and twelve numbers, the ones it does not use are
+// ignored. The boxes are added to the world in bulk.
+int addDominoes(lua_State *m_luaState) {
+  ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
+  std::string pathName = luaL_checkstring(m_luaState, 2);
+  btScalar path[12];
+  for (int index = 0; index < 12; ++index)
+    path[index] =
+        static_cast<btScalar>(luaL_checknumber(m_luaState, 3 + index));
+  float sideX = static_cast<float>(luaL_checknumber(m_luaState, 15));
+  float sideY = static_cast<float>(luaL_checknumber(m_luaState, 16));
+  float sideZ = static_cast<float>(luaL_checknumber(m_luaState, 17));
+  float spacing = static_cast<float>(luaL_checknumber(m_luaState, 18));
+  float tipAngle = static_cast<float>(luaL_checknumber(m_luaState, 19));
+  float mass = static_cast<float>(luaL_checknumber(m_luaState, 20));
+  float ambientColorR = static_cast<float>(luaL_checknumber(m_luaState, 21));
+  float ambientColorG = static_cast<float>(luaL_checknumber(m_luaState, 22));
+  float ambientColorB = static_cast<float>(luaL_checknumber(m_luaState, 23));
+  float ambientColorA = static_cast<float>(luaL_checknumber(m_luaState, 24));
+  float diffuseColorR = static_cast<float>(luaL_checknumber(m_luaState, 25));
+  float diffuseColorG = static_cast<float>(luaL_checknumber(m_luaState, 26));
+  float diffuseColorB = static_cast<float>(luaL_checknumber(m_luaState, 27));
+  float diffuseColorA = static_cast<float>(luaL_checknumber(m_luaState, 28));
+  float specularColorR = static_cast<float>(luaL_checknumber(m_luaState, 29));
+  float specularColorG = static_cast<float>(luaL_checknumber(m_luaState, 30));
+  float specularColorB = static_cast<float>(luaL_checknumber(m_luaState, 31));
+  float specularColorA = static_cast<float>(luaL_checknumber(m_luaState, 32));
+  const char *textureFile = luaL_checkstring(m_luaState, 33);
+  const char *normalTextureFile = luaL_checkstring(m_luaState, 34);
+  const char *shaderFile = luaL_checkstring(m_luaState, 35);
+  int layer = checkCollisionLayer(m_luaState, 38, engine);
+
+  DominoLayout layout({sideX, sideY, sideZ}, spacing);
+  layout.setTipAngle(tipAngle);
+  const btVector3 point0(path[0], path[1], path[2]);
+  if (pathName == "line") {
+    layout.traceLine(point0, btVector3(path[3], path[4], path[5]));
+  } else if (pathName == "arc") {
+    layout.traceArc(point0, path[3], path[4], path[5]);
+  } else if (pathName == "spiral") {
+    layout.traceSpiral(point0, path[3], path[4], path[5]);
+  } else if (pathName == "bezier") {
+    layout.traceBezier(point0, btVector3(path[3], path[4], path[5]),
+                       btVector3(path[6], path[7], path[8]),
+                       btVector3(path[9], path[10], path[11]));
+  } else if (pathName == "grid") {
+    layout.traceGrid(point0, static_cast<int>(path[3]),
+                     static_cast<int>(path[4]), path[5]);
+  } else {
+    std::cerr << "Unknown domino path: " << pathName << "\n";
+    exit(1);
+  }
+
+  BoxBuilder boxBuilder;
+  // Left to the builder unless given, the same for every domino.
+  if (!lua_isnoneornil(m_luaState, 36))
+    boxBuilder.setCcdMotionThreshold(
+        static_cast<float>(luaL_checknumber(m_luaState, 36)));
+  if (!lua_isnoneornil(m_luaState, 37))
+    boxBuilder.setCcdSweptSphereRadius(
+        static_cast<float>(luaL_checknumber(m_luaState, 37)));
+  boxBuilder.setMass(mass)
+      .setAmbientColor(
+          {ambientColorR, ambientColorG, ambientColorB, ambientColorA})
+      .setDiffuseColor(
+          {diffuseColorR, diffuseColorG, diffuseColorB, diffuseColorA})
+      .setSpecularColor(
+          {specularColorR, specularColorG, specularColorB, specularColorA})
+      .setTextureFile(textureFile)
+      .setNormalTextureFile(normalTextureFile);
+  std::vector<Object *> dominoes;
+  layout.createDominoes(boxBuilder, dominoes);
+  for (auto domino : dominoes)
+    domino->setCollisionLayer(layer);
+
+  engine->m_container->addObjects(dominoes, std::string(shaderFile));
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 int addMesh(lua_State *m_luaState) {
   ScriptEngine *engine = luaW_check<ScriptEngine>(m_luaState, 1);
@@ -422,8 +703,14 @@ int addMesh(lua_State *m_luaState) {
   float specularColorB = static_cast<float>(luaL_checknumber(m_luaState, 20));
   float specularColorA = static_cast<float>(luaL_checknumber(m_luaState, 21));
   const char *shaderFile = luaL_checkstring(m_luaState, 22);
+  int layer = checkCollisionLayer(m_luaState, 23, engine);
 
   MeshBuilder meshBuilder;
+  // Left to the builder unless given.
+  if (!lua_isnoneornil(m_luaState, 24))
+    meshBuilder.setShapeTolerance(
+        static_cast<float>(luaL_checknumber(m_luaState, 24)));
+  meshBuilder.setTriangleMesh(lua_toboolean(m_luaState, 25) != 0);
   btQuaternion rotation(rotationX, rotationY, rotationZ);
   Mesh *mesh = meshBuilder.setMeshFile(meshFile)
                    .setTransform(btTransform(
@@ -436,6 +723,7 @@ int addMesh(lua_State *m_luaState) {
                    .setSpecularColor({specularColorR, specularColorG,
                                       specularColorB, specularColorA})
                    .create();
+  mesh->setCollisionLayer(layer);
 
   engine->m_container->addShader(mesh, std::string(shaderFile));
   engine->m_container->addObject(mesh);
@@ -444,3 +732,18 @@ int addMesh(lua_State *m_luaState) {
 
 // -----------------------------------------------------------------------------
 int addSphere(lua_State *) { return 0; }
+
+// -----------------------------------------------------------------------------
+// Objects name their layer, the default one when they do not. The layer must
+// have been set up before.
+int checkCollisionLayer(lua_State *luaState, int index,
+                        const ScriptEngine *engine) {
+  std::string name =
+      luaL_optstring(luaState, index, CollisionLayers::DEFAULT_LAYER_NAME);
+  int layer = engine->m_container->findCollisionLayer(name);
+  if (layer == -1) {
+    std::cerr << "Unknown collision layer: " << name << "\n";
+    exit(1);
+  }
+  return layer;
+}
@@ -0,0 +1,377 @@
+#include "ShapeCache.h"
+
+#include "ShapeFitter.h"
+
+#include <BulletCollision/CollisionShapes/btBoxShape.h>
+#include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btCompoundShape.h>
+#include <BulletCollision/CollisionShapes/btConvexHullShape.h>
+#include <BulletCollision/CollisionShapes/btSphereShape.h>
+#include <BulletCollision/CollisionShapes/btTriangleIndexVertexArray.h>
+#include <LinearMath/btConvexHull.h>
+
+#include <glm/vec3.hpp>
+
+#include <sys/stat.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+const int ShapeCache::MAX_HULL_VERTICES;
+
+// Copies of the triangles of a mesh, which outlive the objects made of it.
+struct TriangleMesh {
+  std::vector<float> points;
+  std::vector<unsigned int> indices;
+  btTriangleIndexVertexArray vertexArray;
+  // The tree read back from the cache lives in it, nullptr when built.
+  void *bvhBuffer = nullptr;
+
+  ~TriangleMesh() { btAlignedFree(bvhBuffer); }
+};
+
+// Leads a .bvh file, the tree only fits the same triangles in the same
+// precision.
+struct BvhHeader {
+  char tag[4];
+  std::uint32_t scalarSize;
+  std::uint32_t trianglesNumber;
+  std::uint32_t bufferSize;
+};
+
+static const char BVH_TAG[4] = {'#', 'b', 'v', 'h'};
+// The layout Bullet serializes the tree in is aligned to 16 bytes.
+static const int BVH_ALIGNMENT = 16;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+btCollisionShape *createMeshShape(const std::string &meshFile,
+                                  btScalar tolerance, const float *points,
+                                  int pointsNumber);
+btConvexHullShape *createMeshHull(const std::string &meshFile,
+                                  const std::vector<btVector3> &meshPoints);
+btBvhTriangleMeshShape *createTriangleMeshShape(
+    const std::string &meshFile, const float *points, int pointsNumber,
+    const unsigned int *indices, int indicesNumber,
+    TriangleMesh &triangleMesh);
+void deleteShape(btCollisionShape *shape);
+bool loadHull(const std::string &hullFile, const std::string &meshFile,
+              std::vector<btVector3> &hullPoints);
+void saveHull(const std::string &hullFile,
+              const std::vector<btVector3> &hullPoints);
+btOptimizedBvh *loadBvh(const std::string &bvhFile,
+                        const std::string &meshFile, int trianglesNumber,
+                        void *&bvhBuffer);
+void saveBvh(const std::string &bvhFile, int trianglesNumber,
+             const btOptimizedBvh &bvh);
+
+// -----------------------------------------------------------------------------
+ShapeCache &ShapeCache::getInstance() {
+  static ShapeCache cache;
+  return cache;
+}
+
+// -----------------------------------------------------------------------------
+ShapeCache::~ShapeCache() {
+  for (auto &entry : m_shapes)
+    deleteShape(entry.second.shape);
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeCache::acquireBox(const btVector3 &halfSides) {
+  return acquire(ShapeKey(ShapeKind::skBox, halfSides.x(), halfSides.y(),
+                          halfSides.z(), std::string()),
+                 nullptr, 0);
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeCache::acquireSphere(btScalar radius) {
+  return acquire(ShapeKey(ShapeKind::skSphere, radius, 0, 0, std::string()),
+                 nullptr, 0);
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeCache::acquirePlane(btScalar side) {
+  return acquire(ShapeKey(ShapeKind::skPlane, side, 0, 0, std::string()),
+                 nullptr, 0);
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeCache::acquireMesh(const std::string &meshFile,
+                                          const float *points,
+                                          int pointsNumber,
+                                          btScalar tolerance) {
+  return acquire(ShapeKey(ShapeKind::skMesh, tolerance, 0, 0, meshFile),
+                 points, pointsNumber);
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeCache::acquireTriangleMesh(const std::string &meshFile,
+                                                  const float *points,
+                                                  int pointsNumber,
+                                                  const unsigned int *indices,
+                                                  int indicesNumber) {
+  return acquire(ShapeKey(ShapeKind::skTriangleMesh, 0, 0, 0, meshFile),
+                 points, pointsNumber, indices, indicesNumber);
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeCache::acquire(const ShapeKey &key, const float *points,
+                                      int pointsNumber,
+                                      const unsigned int *indices,
+                                      int indicesNumber) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  CachedShape &cached = m_shapes[key];
+  if (cached.shape == nullptr) {
+    switch (std::get<0>(key)) {
+    case ShapeKind::skBox:
+      cached.shape = new btBoxShape(
+          btVector3(std::get<1>(key), std::get<2>(key), std::get<3>(key)));
+      break;
+    case ShapeKind::skSphere:
+      cached.shape = new btSphereShape(std::get<1>(key));
+      break;
+    case ShapeKind::skPlane:
+      // The same slab as the hull of its corners within the margin, without
+      // the cost of a hull.
+      cached.shape = new btBoxShape(btVector3(std::get<1>(key) / 2,
+                                              CONVEX_DISTANCE_MARGIN,
+                                              std::get<1>(key) / 2));
+      break;
+    case ShapeKind::skMesh:
+      cached.shape = createMeshShape(std::get<4>(key), std::get<1>(key),
+                                     points, pointsNumber);
+      break;
+    case ShapeKind::skTriangleMesh:
+      cached.triangleMesh = std::make_shared<TriangleMesh>();
+      cached.shape = createTriangleMeshShape(std::get<4>(key), points,
+                                             pointsNumber, indices,
+                                             indicesNumber,
+                                             *cached.triangleMesh);
+      break;
+    }
+    m_shapeKeys[cached.shape] = key;
+  }
+
+  ++cached.references;
+  return cached.shape;
+}
+
+// -----------------------------------------------------------------------------
+void ShapeCache::release(btCollisionShape *shape) {
+  if (shape == nullptr)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto keyIter = m_shapeKeys.find(shape);
+  assert(keyIter != m_shapeKeys.end() && "Shape not from the cache");
+  auto shapeIter = m_shapes.find(keyIter->second);
+  if (--shapeIter->second.references > 0)
+    return;
+
+  deleteShape(shape);
+  m_shapes.erase(shapeIter);
+  m_shapeKeys.erase(keyIter);
+}
+
+// -----------------------------------------------------------------------------
+int ShapeCache::getShapesNumber() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_shapes.size();
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *createMeshShape(const std::string &meshFile,
+                                  btScalar tolerance, const float *points,
+                                  int pointsNumber) {
+  auto vertices = reinterpret_cast<const glm::vec3 *>(points);
+  std::vector<btVector3> meshPoints;
+  meshPoints.reserve(pointsNumber);
+  for (int point = 0; point < pointsNumber; ++point)
+    meshPoints.push_back(
+        btVector3(vertices[point].x, vertices[point].y, vertices[point].z));
+
+  btCollisionShape *primitive =
+      ShapeFitter(meshPoints, tolerance).createShape();
+  if (primitive != nullptr)
+    return primitive;
+  return createMeshHull(meshFile, meshPoints);
+}
+
+// -----------------------------------------------------------------------------
+// Hull of at most MAX_HULL_VERTICES vertices, grown from the mesh points by
+// quickhull. It is saved next to the mesh and read back as long as the mesh
+// is not newer.
+btConvexHullShape *createMeshHull(const std::string &meshFile,
+                                  const std::vector<btVector3> &meshPoints) {
+  const std::string hullFile = meshFile + ".hull";
+  std::vector<btVector3> hullPoints;
+  if (!loadHull(hullFile, meshFile, hullPoints)) {
+    HullDesc description(QF_TRIANGLES, meshPoints.size(), meshPoints.data(),
+                         sizeof(btVector3));
+    description.mMaxVertices = ShapeCache::MAX_HULL_VERTICES;
+    HullLibrary hullLibrary;
+    HullResult result;
+    if (hullLibrary.CreateConvexHull(description, result) == QE_OK) {
+      for (unsigned int point = 0; point < result.mNumOutputVertices; ++point)
+        hullPoints.push_back(result.m_OutputVertices[point]);
+      hullLibrary.ReleaseResult(result);
+      saveHull(hullFile, hullPoints);
+    } else {
+      // Degenerate meshes keep all their points.
+      hullPoints = meshPoints;
+    }
+  }
+
+  btConvexHullShape *shape = new btConvexHullShape();
+  for (const auto &point : hullPoints)
+    shape->addPoint(point, false);
+  shape->recalcLocalAabb();
+  return shape;
+}
+
+// -----------------------------------------------------------------------------
+// The first line tells the vertex budget the hull was built with.
+bool loadHull(const std::string &hullFile, const std::string &meshFile,
+              std::vector<btVector3> &hullPoints) {
+  struct stat hullStat;
+  struct stat meshStat;
+  if (stat(hullFile.c_str(), &hullStat) != 0 ||
+      stat(meshFile.c_str(), &meshStat) != 0 ||
+      hullStat.st_mtime < meshStat.st_mtime)
+    return false;
+
+  std::ifstream input(hullFile);
+  std::string header;
+  int maxVertices = 0;
+  input >> header >> maxVertices;
+  if (header != "#hull" || maxVertices != ShapeCache::MAX_HULL_VERTICES)
+    return false;
+
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream lineStream(line);
+    std::string type;
+    btScalar x, y, z;
+    if (lineStream >> type >> x >> y >> z && type == "v")
+      hullPoints.push_back(btVector3(x, y, z));
+  }
+  return hullPoints.size() >= 4;
+}
+
+// -----------------------------------------------------------------------------
+// Written as obj vertices. Failing to write, say in a read only mesh
+// directory, only loses the cache.
+void saveHull(const std::string &hullFile,
+              const std::vector<btVector3> &hullPoints) {
+  std::ofstream output(hullFile);
+  output << "#hull " << ShapeCache::MAX_HULL_VERTICES << "\n";
+  for (const auto &point : hullPoints)
+    output << "v " << point.x() << " " << point.y() << " " << point.z()
+           << "\n";
+}
+
+// -----------------------------------------------------------------------------
+// The shape points into the copies of the triangles. Its tree is read from
+// the .bvh file next to the mesh as long as the mesh is not newer, built and
+// saved otherwise.
+btBvhTriangleMeshShape *createTriangleMeshShape(
+    const std::string &meshFile, const float *points, int pointsNumber,
+    const unsigned int *indices, int indicesNumber,
+    TriangleMesh &triangleMesh) {
+  assert(indicesNumber % 3 == 0 && "The mesh is not made of triangles");
+  triangleMesh.points.assign(points, points + 3 * pointsNumber);
+  triangleMesh.indices.assign(indices, indices + indicesNumber);
+
+  btIndexedMesh indexedMesh;
+  indexedMesh.m_numTriangles = indicesNumber / 3;
+  indexedMesh.m_triangleIndexBase =
+      reinterpret_cast<const unsigned char *>(triangleMesh.indices.data());
+  indexedMesh.m_triangleIndexStride = 3 * sizeof(unsigned int);
+  indexedMesh.m_numVertices = pointsNumber;
+  indexedMesh.m_vertexBase =
+      reinterpret_cast<const unsigned char *>(triangleMesh.points.data());
+  indexedMesh.m_vertexStride = 3 * sizeof(float);
+  triangleMesh.vertexArray.addIndexedMesh(indexedMesh);
+
+  const std::string bvhFile = meshFile + ".bvh";
+  btOptimizedBvh *bvh = loadBvh(bvhFile, meshFile, indexedMesh.m_numTriangles,
+                                triangleMesh.bvhBuffer);
+  if (bvh != nullptr) {
+    auto shape =
+        new btBvhTriangleMeshShape(&triangleMesh.vertexArray, true, false);
+    shape->setOptimizedBvh(bvh);
+    return shape;
+  }
+
+  auto shape = new btBvhTriangleMeshShape(&triangleMesh.vertexArray, true);
+  saveBvh(bvhFile, indexedMesh.m_numTriangles, *shape->getOptimizedBvh());
+  return shape;
+}
+
+// -----------------------------------------------------------------------------
+// Bullet fixes up the pointers of the tree within the buffer, which has to
+// live as long as the shape.
+btOptimizedBvh *loadBvh(const std::string &bvhFile,
+                        const std::string &meshFile, int trianglesNumber,
+                        void *&bvhBuffer) {
+  struct stat bvhStat;
+  struct stat meshStat;
+  if (stat(bvhFile.c_str(), &bvhStat) != 0 ||
+      stat(meshFile.c_str(), &meshStat) != 0 ||
+      bvhStat.st_mtime < meshStat.st_mtime)
+    return nullptr;
+
+  std::ifstream input(bvhFile, std::ios::binary);
+  BvhHeader header;
+  if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      std::memcmp(header.tag, BVH_TAG, sizeof(BVH_TAG)) != 0 ||
+      header.scalarSize != sizeof(btScalar) ||
+      header.trianglesNumber != static_cast<std::uint32_t>(trianglesNumber))
+    return nullptr;
+
+  void *buffer = btAlignedAlloc(header.bufferSize, BVH_ALIGNMENT);
+  btOptimizedBvh *bvh = nullptr;
+  if (input.read(static_cast<char *>(buffer), header.bufferSize))
+    bvh = btOptimizedBvh::deSerializeInPlace(buffer, header.bufferSize, false);
+  if (bvh == nullptr) {
+    btAlignedFree(buffer);
+    return nullptr;
+  }
+  bvhBuffer = buffer;
+  return bvh;
+}
+
+// -----------------------------------------------------------------------------
+// Failing to write only loses the cache, as for hulls.
+void saveBvh(const std::string &bvhFile, int trianglesNumber,
+             const btOptimizedBvh &bvh) {
+  BvhHeader header;
+  std::memcpy(header.tag, BVH_TAG, sizeof(BVH_TAG));
+  header.scalarSize = sizeof(btScalar);
+  header.trianglesNumber = trianglesNumber;
+  header.bufferSize = bvh.calculateSerializeBufferSize();
+
+  void *buffer = btAlignedAlloc(header.bufferSize, BVH_ALIGNMENT);
+  if (bvh.serializeInPlace(buffer, header.bufferSize, false)) {
+    std::ofstream output(bvhFile, std::ios::binary);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(static_cast<const char *>(buffer), header.bufferSize);
+  }
+  btAlignedFree(buffer);
+}
+
+// -----------------------------------------------------------------------------
+// A compound from the ShapeFitter owns its child.
+void deleteShape(btCollisionShape *shape) {
+  if (shape->isCompound()) {
+    auto compound = static_cast<btCompoundShape *>(shape);
+    for (int child = 0; child < compound->getNumChildShapes(); ++child)
+      delete compound->getChildShape(child);
+  }
+  delete shape;
+}
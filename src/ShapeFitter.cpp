@@ -0,0 +1,184 @@
+#include "ShapeFitter.h"
+
+#include <BulletCollision/CollisionShapes/btBoxShape.h>
+#include <BulletCollision/CollisionShapes/btCapsuleShape.h>
+#include <BulletCollision/CollisionShapes/btCompoundShape.h>
+#include <BulletCollision/CollisionShapes/btCylinderShape.h>
+#include <BulletCollision/CollisionShapes/btSphereShape.h>
+
+#include <algorithm>
+#include <cassert>
+
+const btScalar ShapeFitter::DEFAULT_TOLERANCE = 0.05;
+const int ShapeFitter::DIRECTIONS_NUMBER;
+
+// -----------------------------------------------------------------------------
+// The directions spread evenly over the sphere along a Fibonacci spiral.
+ShapeFitter::ShapeFitter(const std::vector<btVector3> &points,
+                         btScalar tolerance) {
+  assert(!points.empty() && "Nothing to fit a shape to");
+  btVector3 minimum = points[0];
+  btVector3 maximum = points[0];
+  for (const auto &point : points) {
+    minimum.setMin(point);
+    maximum.setMax(point);
+  }
+  m_center = (minimum + maximum) / 2;
+  m_halfSides = (maximum - minimum) / 2;
+  m_tolerance = tolerance * m_halfSides[m_halfSides.maxAxis()];
+
+  m_axisRadii.setZero();
+  m_radius = 0;
+  for (const auto &point : points) {
+    const btVector3 offset = point - m_center;
+    for (int axis = 0; axis < 3; ++axis)
+      m_axisRadii[axis] =
+          std::max(m_axisRadii[axis],
+                   btSqrt(offset.length2() - offset[axis] * offset[axis]));
+    m_radius = std::max(m_radius, offset.length());
+  }
+
+  m_directions.reserve(DIRECTIONS_NUMBER + 6);
+  for (int axis = 0; axis < 3; ++axis) {
+    btVector3 direction(0, 0, 0);
+    direction[axis] = 1;
+    m_directions.push_back(direction);
+    m_directions.push_back(-direction);
+  }
+  const btScalar goldenAngle = SIMD_PI * (3 - btSqrt(btScalar(5)));
+  for (int index = 0; index < DIRECTIONS_NUMBER; ++index) {
+    const btScalar y = 1 - 2 * (index + btScalar(0.5)) / DIRECTIONS_NUMBER;
+    const btScalar radius = btSqrt(1 - y * y);
+    const btScalar angle = goldenAngle * index;
+    m_directions.push_back(
+        btVector3(radius * btCos(angle), y, radius * btSin(angle)));
+  }
+
+  m_supports.assign(m_directions.size(), -BT_LARGE_FLOAT);
+  for (const auto &point : points) {
+    const btVector3 offset = point - m_center;
+    for (size_t direction = 0; direction < m_directions.size(); ++direction)
+      m_supports[direction] = std::max(m_supports[direction],
+                                       offset.dot(m_directions[direction]));
+  }
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeFitter::createShape() const {
+  btCollisionShape *primitive = createPrimitive();
+  if (primitive == nullptr || m_center.fuzzyZero())
+    return primitive;
+
+  // Two compounds collide through the trees of their children, even of one.
+  btCompoundShape *compound = new btCompoundShape();
+  compound->addChildShape(btTransform(btQuaternion::getIdentity(), m_center),
+                          primitive);
+  return compound;
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeFitter::createPrimitive() const {
+  PrimitiveType bestType = PrimitiveType::ptSphere;
+  int bestAxis = -1;
+  btScalar bestDistance = m_tolerance;
+  auto consider = [&](PrimitiveType type, int axis, btScalar distance) {
+    if (distance < bestDistance ||
+        (bestAxis == -1 && distance <= bestDistance)) {
+      bestType = type;
+      bestAxis = axis;
+      bestDistance = distance;
+    }
+  };
+
+  consider(PrimitiveType::ptSphere, 0,
+           getDistance([this](const btVector3 &) { return m_radius; }));
+  const btVector3 boxHalfSides = getBoxHalfSides();
+  consider(PrimitiveType::ptBox, 0,
+           getDistance([&boxHalfSides](const btVector3 &direction) {
+             return direction.absolute().dot(boxHalfSides);
+           }));
+  for (int axis = 0; axis < 3; ++axis) {
+    const btScalar radius = m_axisRadii[axis];
+    const btScalar halfLength = m_halfSides[axis] - radius;
+    auto capsuleSupport = [axis, radius,
+                           halfLength](const btVector3 &direction) {
+      return halfLength * btFabs(direction[axis]) + radius;
+    };
+    if (halfLength > 0)
+      consider(PrimitiveType::ptCapsule, axis, getDistance(capsuleSupport));
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    const btScalar radius = getCylinderRadius(axis);
+    const btScalar halfLength = getCylinderHalfLength(axis);
+    auto cylinderSupport = [axis, radius,
+                            halfLength](const btVector3 &direction) {
+      const btScalar along = direction[axis];
+      return halfLength * btFabs(along) +
+             radius * btSqrt(std::max(btScalar(0), 1 - along * along));
+    };
+    consider(PrimitiveType::ptCylinder, axis, getDistance(cylinderSupport));
+  }
+
+  if (bestAxis == -1)
+    return nullptr;
+  return createPrimitive(bestType, bestAxis);
+}
+
+// -----------------------------------------------------------------------------
+btCollisionShape *ShapeFitter::createPrimitive(PrimitiveType type,
+                                               int axis) const {
+  switch (type) {
+  case PrimitiveType::ptSphere:
+    return new btSphereShape(m_radius);
+  case PrimitiveType::ptBox:
+    return new btBoxShape(getBoxHalfSides());
+  case PrimitiveType::ptCapsule: {
+    const btScalar radius = m_axisRadii[axis];
+    const btScalar height = 2 * (m_halfSides[axis] - radius);
+    if (axis == 0)
+      return new btCapsuleShapeX(radius, height);
+    if (axis == 1)
+      return new btCapsuleShape(radius, height);
+    return new btCapsuleShapeZ(radius, height);
+  }
+  case PrimitiveType::ptCylinder: {
+    const btScalar radius = getCylinderRadius(axis);
+    btVector3 halfExtents(radius, radius, radius);
+    halfExtents[axis] = getCylinderHalfLength(axis);
+    if (axis == 0)
+      return new btCylinderShapeX(halfExtents);
+    if (axis == 1)
+      return new btCylinderShape(halfExtents);
+    return new btCylinderShapeZ(halfExtents);
+  }
+  }
+  return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Boxes and cylinders keep room for the collision margin Bullet takes from
+// their sides.
+btVector3 ShapeFitter::getBoxHalfSides() const {
+  const btScalar margin = CONVEX_DISTANCE_MARGIN;
+  btVector3 halfSides = m_halfSides;
+  halfSides.setMax(btVector3(margin, margin, margin));
+  return halfSides;
+}
+btScalar ShapeFitter::getCylinderRadius(int axis) const {
+  return std::max(m_axisRadii[axis], btScalar(CONVEX_DISTANCE_MARGIN));
+}
+btScalar ShapeFitter::getCylinderHalfLength(int axis) const {
+  return std::max(m_halfSides[axis], btScalar(CONVEX_DISTANCE_MARGIN));
+}
+
+// -----------------------------------------------------------------------------
+// For two convex shapes, the largest difference of their supports is their
+// Hausdorff distance.
+template <typename Support>
+btScalar ShapeFitter::getDistance(const Support &support) const {
+  btScalar distance = 0;
+  for (size_t direction = 0; direction < m_directions.size(); ++direction)
+    distance = std::max(distance, btFabs(support(m_directions[direction]) -
+                                         m_supports[direction]));
+  return distance;
+}
@@ -0,0 +1,535 @@
+#include "SimdContactSolver.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if !defined(BT_USE_DOUBLE_PRECISION) && (defined(__AVX__) || defined(__SSE__))
+#define SIMD_CONTACT_KERNEL
+#include <immintrin.h>
+#endif
+
+const int SimdContactSolver::ROWS_PER_PACKET;
+const int SimdContactSolver::OPEN_PACKETS;
+
+static const int LANES = SimdContactSolver::ROWS_PER_PACKET;
+static const std::uint64_t ALL_SLOTS = ~std::uint64_t(0);
+static_assert(SimdContactSolver::OPEN_PACKETS == 64,
+              "Open packets are the bits of a 64 bit mask");
+
+// The rows of a packet in SIMD registers, a lane each.
+#ifdef SIMD_CONTACT_KERNEL
+#ifdef __AVX__
+typedef __m256 Lanes;
+inline Lanes loadLanes(const float *values) { return _mm256_loadu_ps(values); }
+inline void storeLanes(float *values, Lanes lanes) {
+  _mm256_storeu_ps(values, lanes);
+}
+inline Lanes broadcastLanes(float value) { return _mm256_set1_ps(value); }
+inline Lanes minLanes(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+inline Lanes maxLanes(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+inline Lanes greaterLanes(Lanes a, Lanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+inline Lanes selectLanes(Lanes mask, Lanes ifTrue, Lanes ifFalse) {
+  return _mm256_blendv_ps(ifFalse, ifTrue, mask);
+}
+inline Lanes joinQuads(const __m128 *quads) {
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(quads[0]), quads[1], 1);
+}
+inline void splitQuads(Lanes lanes, __m128 *quads) {
+  quads[0] = _mm256_castps256_ps128(lanes);
+  quads[1] = _mm256_extractf128_ps(lanes, 1);
+}
+#else
+typedef __m128 Lanes;
+inline Lanes loadLanes(const float *values) { return _mm_loadu_ps(values); }
+inline void storeLanes(float *values, Lanes lanes) {
+  _mm_storeu_ps(values, lanes);
+}
+inline Lanes broadcastLanes(float value) { return _mm_set1_ps(value); }
+inline Lanes minLanes(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+inline Lanes maxLanes(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+inline Lanes greaterLanes(Lanes a, Lanes b) { return _mm_cmpgt_ps(a, b); }
+inline Lanes selectLanes(Lanes mask, Lanes ifTrue, Lanes ifFalse) {
+  return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+inline Lanes joinQuads(const __m128 *quads) { return quads[0]; }
+inline void splitQuads(Lanes lanes, __m128 *quads) { quads[0] = lanes; }
+#endif
+
+// Lanes come in quads of 4, a btVector3 each before a transpose.
+static const int QUADS = LANES / 4;
+
+// The x, y and z of the vectors of the lanes, and their w in quads to put
+// them back.
+inline void loadVectors(btScalar *const *vectors, Lanes (&xyz)[3],
+                        __m128 (&w)[QUADS]) {
+  __m128 quads[3][QUADS];
+  for (int quad = 0; quad < QUADS; ++quad) {
+    __m128 x = _mm_loadu_ps(vectors[4 * quad]);
+    __m128 y = _mm_loadu_ps(vectors[4 * quad + 1]);
+    __m128 z = _mm_loadu_ps(vectors[4 * quad + 2]);
+    w[quad] = _mm_loadu_ps(vectors[4 * quad + 3]);
+    _MM_TRANSPOSE4_PS(x, y, z, w[quad]);
+    quads[0][quad] = x;
+    quads[1][quad] = y;
+    quads[2][quad] = z;
+  }
+  for (int axis = 0; axis < 3; ++axis)
+    xyz[axis] = joinQuads(quads[axis]);
+}
+
+// Lanes sharing a vector must all write the same value.
+inline void storeVectors(btScalar *const *vectors, const Lanes (&xyz)[3],
+                         const __m128 (&w)[QUADS]) {
+  __m128 quads[3][QUADS];
+  for (int axis = 0; axis < 3; ++axis)
+    splitQuads(xyz[axis], quads[axis]);
+  for (int quad = 0; quad < QUADS; ++quad) {
+    __m128 x = quads[0][quad];
+    __m128 y = quads[1][quad];
+    __m128 z = quads[2][quad];
+    __m128 quadW = w[quad];
+    _MM_TRANSPOSE4_PS(x, y, z, quadW);
+    _mm_storeu_ps(vectors[4 * quad], x);
+    _mm_storeu_ps(vectors[4 * quad + 1], y);
+    _mm_storeu_ps(vectors[4 * quad + 2], z);
+    _mm_storeu_ps(vectors[4 * quad + 3], quadW);
+  }
+}
+#endif
+
+// Support functions.
+// -----------------------------------------------------------------------------
+void gatherVelocities(const btAlignedObjectArray<btSolverBody> &bodies,
+                      const int *bodyA, const int *bodyB,
+                      btScalar (*velocities)[LANES]);
+void scatterVelocities(btAlignedObjectArray<btSolverBody> &bodies,
+                       const int *bodyA, const int *bodyB,
+                       const btScalar (*velocities)[LANES]);
+
+// -----------------------------------------------------------------------------
+SimdContactSolver::SimdContactSolver(Kernel kernel)
+    : m_kernel(hasSimdKernel() ? kernel : Kernel::kScalar) {}
+
+// -----------------------------------------------------------------------------
+const char *SimdContactSolver::getSimdName() {
+#if !defined(SIMD_CONTACT_KERNEL)
+  return "scalar";
+#elif defined(__AVX__)
+  return "avx";
+#else
+  return "sse";
+#endif
+}
+
+// -----------------------------------------------------------------------------
+bool SimdContactSolver::hasSimdKernel() {
+#ifdef SIMD_CONTACT_KERNEL
+  return true;
+#else
+  return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// The rows are packed once the base solver has set them up and warm started
+// the bodies.
+btScalar SimdContactSolver::solveGroupCacheFriendlySetup(
+    btCollisionObject **bodies, int bodiesNumber,
+    btPersistentManifold **manifolds, int manifoldsNumber,
+    btTypedConstraint **constraints, int constraintsNumber,
+    const btContactSolverInfo &solverInfo, btIDebugDraw *debugDrawer) {
+  btScalar result =
+      btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(
+          bodies, bodiesNumber, manifolds, manifoldsNumber, constraints,
+          constraintsNumber, solverInfo, debugDrawer);
+
+  const int reorderingModes =
+      SOLVER_RANDMIZE_ORDER | SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS;
+  m_packed = (solverInfo.m_solverMode & reorderingModes) == 0 &&
+             m_tmpSolverContactRollingFrictionConstraintPool.size() == 0;
+  if (m_packed) {
+    m_packedBodies.resize(m_tmpSolverBodyPool.size());
+    for (int body = 0; body < m_tmpSolverBodyPool.size(); ++body)
+      m_packedBodies[body] = getPackedBody(body);
+    m_contactSlots.resize(m_tmpSolverContactConstraintPool.size());
+    packRows(m_tmpSolverContactConstraintPool, m_orderTmpConstraintPool, false,
+             m_contactPackets);
+    packRows(m_tmpSolverContactFrictionConstraintPool,
+             m_orderFrictionConstraintPool, true, m_frictionPackets);
+  }
+  return result;
+}
+
+// -----------------------------------------------------------------------------
+// The joints as the base solver does, then the contact packets, then the
+// friction ones.
+btScalar SimdContactSolver::solveSingleIteration(
+    int iteration, btCollisionObject **bodies, int bodiesNumber,
+    btPersistentManifold **manifolds, int manifoldsNumber,
+    btTypedConstraint **constraints, int constraintsNumber,
+    const btContactSolverInfo &solverInfo, btIDebugDraw *debugDrawer) {
+  if (!m_packed)
+    return btSequentialImpulseConstraintSolver::solveSingleIteration(
+        iteration, bodies, bodiesNumber, manifolds, manifoldsNumber,
+        constraints, constraintsNumber, solverInfo, debugDrawer);
+
+  for (int index = 0; index < m_tmpSolverNonContactConstraintPool.size();
+       ++index) {
+    btSolverConstraint &constraint =
+        m_tmpSolverNonContactConstraintPool[m_orderNonContactConstraintPool
+                                                [index]];
+    if (iteration >= constraint.m_overrideNumSolverIterations)
+      continue;
+    btSolverBody &bodyA = m_tmpSolverBodyPool[constraint.m_solverBodyIdA];
+    btSolverBody &bodyB = m_tmpSolverBodyPool[constraint.m_solverBodyIdB];
+    if (solverInfo.m_solverMode & SOLVER_SIMD)
+      resolveSingleConstraintRowGenericSIMD(bodyA, bodyB, constraint);
+    else
+      resolveSingleConstraintRowGeneric(bodyA, bodyB, constraint);
+  }
+  if (iteration >= solverInfo.m_numIterations)
+    return 0;
+
+  for (int index = 0; index < constraintsNumber; ++index) {
+    if (!constraints[index]->isEnabled())
+      continue;
+    int bodyA = getOrInitSolverBody(constraints[index]->getRigidBodyA(),
+                                    solverInfo.m_timeStep);
+    int bodyB = getOrInitSolverBody(constraints[index]->getRigidBodyB(),
+                                    solverInfo.m_timeStep);
+    constraints[index]->solveConstraintObsolete(m_tmpSolverBodyPool[bodyA],
+                                                m_tmpSolverBodyPool[bodyB],
+                                                solverInfo.m_timeStep);
+  }
+  solvePackets(m_contactPackets, false);
+  solvePackets(m_frictionPackets, true);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+btScalar SimdContactSolver::solveGroupCacheFriendlyFinish(
+    btCollisionObject **bodies, int bodiesNumber,
+    const btContactSolverInfo &solverInfo) {
+  if (m_packed) {
+    unpackRows(m_contactPackets, m_tmpSolverContactConstraintPool);
+    unpackRows(m_frictionPackets, m_tmpSolverContactFrictionConstraintPool);
+    m_packed = false;
+  }
+  return btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyFinish(
+      bodies, bodiesNumber, solverInfo);
+}
+
+// -----------------------------------------------------------------------------
+// Each row goes to the first open packet holding neither of its bodies, or
+// opens a new one. Packets close when full, and when all of them are open the
+// one opened longest ago makes room.
+void SimdContactSolver::packRows(const btConstraintArray &rows,
+                                 const btAlignedObjectArray<int> &order,
+                                 bool friction,
+                                 btAlignedObjectArray<RowPacket> &packets) {
+  packets.resize(0);
+  m_bodyPackets.assign(m_tmpSolverBodyPool.size(), 0);
+  int slotPackets[OPEN_PACKETS];
+  std::uint64_t openSlots = 0;
+  int oldestSlot = 0;
+
+  RowPacket emptyPacket = RowPacket();
+  std::fill(emptyPacket.bodyA, emptyPacket.bodyA + LANES, -1);
+  std::fill(emptyPacket.bodyB, emptyPacket.bodyB + LANES, -1);
+  std::fill(emptyPacket.rows, emptyPacket.rows + LANES, -1);
+  std::fill(emptyPacket.contactSlots, emptyPacket.contactSlots + LANES, -1);
+
+  for (int index = 0; index < rows.size(); ++index) {
+    const int row = order[index];
+    const btSolverConstraint &constraint = rows[row];
+    const int bodyA = m_packedBodies[constraint.m_solverBodyIdA];
+    const int bodyB = m_packedBodies[constraint.m_solverBodyIdB];
+    std::uint64_t busySlots = 0;
+    if (bodyA >= 0)
+      busySlots |= m_bodyPackets[bodyA];
+    if (bodyB >= 0)
+      busySlots |= m_bodyPackets[bodyB];
+
+    int slot;
+    const std::uint64_t freeSlots = openSlots & ~busySlots;
+    if (freeSlots != 0) {
+      slot = __builtin_ctzll(freeSlots);
+    } else {
+      if (openSlots == ALL_SLOTS) {
+        slot = oldestSlot;
+        oldestSlot = (oldestSlot + 1) % OPEN_PACKETS;
+        closePacket(packets[slotPackets[slot]], slot);
+        openSlots &= ~(std::uint64_t(1) << slot);
+      } else {
+        slot = __builtin_ctzll(~openSlots);
+      }
+      slotPackets[slot] = packets.size();
+      packets.push_back(emptyPacket);
+      openSlots |= std::uint64_t(1) << slot;
+    }
+
+    RowPacket &packet = packets[slotPackets[slot]];
+    const int lane = addRow(packet, row, constraint, bodyA, bodyB, friction);
+    if (friction)
+      packet.contactSlots[lane] = m_contactSlots[constraint.m_frictionIndex];
+    else
+      m_contactSlots[row] = slotPackets[slot] * LANES + lane;
+    if (bodyA >= 0)
+      m_bodyPackets[bodyA] |= std::uint64_t(1) << slot;
+    if (bodyB >= 0)
+      m_bodyPackets[bodyB] |= std::uint64_t(1) << slot;
+
+    if (packet.rowsNumber == LANES) {
+      closePacket(packet, slot);
+      openSlots &= ~(std::uint64_t(1) << slot);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// The velocity change per unit of impulse is what internalApplyImpulse adds.
+int SimdContactSolver::addRow(RowPacket &packet, int row,
+                              const btSolverConstraint &constraint, int bodyA,
+                              int bodyB, bool friction) {
+  assert(packet.rowsNumber < LANES && "The packet is full");
+  const int lane = packet.rowsNumber++;
+  for (int axis = 0; axis < 3; ++axis) {
+    packet.normalA[axis][lane] = constraint.m_contactNormal1[axis];
+    packet.torqueA[axis][lane] = constraint.m_relpos1CrossNormal[axis];
+    packet.normalB[axis][lane] = constraint.m_contactNormal2[axis];
+    packet.torqueB[axis][lane] = constraint.m_relpos2CrossNormal[axis];
+    if (bodyA >= 0) {
+      const btSolverBody &body = m_tmpSolverBodyPool[bodyA];
+      packet.linearA[axis][lane] = constraint.m_contactNormal1[axis] *
+                                   body.m_invMass[axis] *
+                                   body.m_linearFactor[axis];
+      packet.angularA[axis][lane] =
+          constraint.m_angularComponentA[axis] * body.m_angularFactor[axis];
+    }
+    if (bodyB >= 0) {
+      const btSolverBody &body = m_tmpSolverBodyPool[bodyB];
+      packet.linearB[axis][lane] = constraint.m_contactNormal2[axis] *
+                                   body.m_invMass[axis] *
+                                   body.m_linearFactor[axis];
+      packet.angularB[axis][lane] =
+          constraint.m_angularComponentB[axis] * body.m_angularFactor[axis];
+    }
+  }
+  packet.rhs[lane] = constraint.m_rhs;
+  packet.cfm[lane] = constraint.m_cfm;
+  packet.jacobianInverse[lane] = constraint.m_jacDiagABInv;
+  packet.limit[lane] = friction ? constraint.m_friction : constraint.m_lowerLimit;
+  packet.appliedImpulse[lane] = btScalar(constraint.m_appliedImpulse);
+  packet.bodyA[lane] = bodyA;
+  packet.bodyB[lane] = bodyB;
+  packet.rows[lane] = row;
+  return lane;
+}
+
+// -----------------------------------------------------------------------------
+// The fixed body and kinematic ones take no impulse, any number of rows of a
+// packet may share them.
+int SimdContactSolver::getPackedBody(int solverBody) const {
+  const btSolverBody &body = m_tmpSolverBodyPool[solverBody];
+  if (body.m_originalBody == nullptr || body.m_originalBody->getInvMass() == 0)
+    return -1;
+  return solverBody;
+}
+
+// -----------------------------------------------------------------------------
+void SimdContactSolver::closePacket(const RowPacket &packet, int slot) {
+  const std::uint64_t mask = ~(std::uint64_t(1) << slot);
+  for (int lane = 0; lane < packet.rowsNumber; ++lane) {
+    if (packet.bodyA[lane] >= 0)
+      m_bodyPackets[packet.bodyA[lane]] &= mask;
+    if (packet.bodyB[lane] >= 0)
+      m_bodyPackets[packet.bodyB[lane]] &= mask;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// The base solver warm starts the next step from the impulses of the rows.
+void SimdContactSolver::unpackRows(
+    const btAlignedObjectArray<RowPacket> &packets,
+    btConstraintArray &rows) const {
+  for (int index = 0; index < packets.size(); ++index) {
+    const RowPacket &packet = packets[index];
+    for (int lane = 0; lane < packet.rowsNumber; ++lane)
+      rows[packet.rows[lane]].m_appliedImpulse = packet.appliedImpulse[lane];
+  }
+}
+
+// -----------------------------------------------------------------------------
+void SimdContactSolver::solvePackets(btAlignedObjectArray<RowPacket> &packets,
+                                     bool friction) {
+  if (m_kernel == Kernel::kSimd) {
+    for (int index = 0; index < packets.size(); ++index)
+      solvePacketSimd(packets[index], friction);
+  } else {
+    for (int index = 0; index < packets.size(); ++index)
+      solvePacketScalar(packets[index], friction);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// resolveSingleConstraintRowLowerLimit for contacts and
+// resolveSingleConstraintRowGeneric for friction, a lane at a time. Friction
+// is bounded by the impulse of its contact row, and skipped without one.
+void SimdContactSolver::solvePacketScalar(RowPacket &packet, bool friction) {
+  btScalar velocities[12][LANES];
+  gatherVelocities(m_tmpSolverBodyPool, packet.bodyA, packet.bodyB,
+                   velocities);
+
+  for (int lane = 0; lane < packet.rowsNumber; ++lane) {
+    btScalar velocity = 0;
+    for (int axis = 0; axis < 3; ++axis)
+      velocity += packet.normalA[axis][lane] * velocities[axis][lane] +
+                  packet.torqueA[axis][lane] * velocities[3 + axis][lane] +
+                  packet.normalB[axis][lane] * velocities[6 + axis][lane] +
+                  packet.torqueB[axis][lane] * velocities[9 + axis][lane];
+    const btScalar applied = packet.appliedImpulse[lane];
+    btScalar impulse = applied + packet.rhs[lane] -
+                       applied * packet.cfm[lane] -
+                       velocity * packet.jacobianInverse[lane];
+    if (!friction) {
+      impulse = std::max(impulse, packet.limit[lane]);
+    } else {
+      const int slot = packet.contactSlots[lane];
+      const btScalar contactImpulse =
+          m_contactPackets[slot / LANES].appliedImpulse[slot % LANES];
+      if (contactImpulse <= 0)
+        continue;
+      const btScalar bound = packet.limit[lane] * contactImpulse;
+      impulse = std::min(std::max(impulse, -bound), bound);
+    }
+
+    packet.appliedImpulse[lane] = impulse;
+    const btScalar delta = impulse - applied;
+    for (int axis = 0; axis < 3; ++axis) {
+      velocities[axis][lane] += packet.linearA[axis][lane] * delta;
+      velocities[3 + axis][lane] += packet.angularA[axis][lane] * delta;
+      velocities[6 + axis][lane] += packet.linearB[axis][lane] * delta;
+      velocities[9 + axis][lane] += packet.angularB[axis][lane] * delta;
+    }
+  }
+
+  scatterVelocities(m_tmpSolverBodyPool, packet.bodyA, packet.bodyB,
+                    velocities);
+}
+
+// -----------------------------------------------------------------------------
+// The same as the scalar kernel on all the lanes at once, the lanes without
+// a row or without a contact impulse keep theirs. Lanes without a body read
+// and write zeros of their own.
+void SimdContactSolver::solvePacketSimd(RowPacket &packet, bool friction) {
+#ifdef SIMD_CONTACT_KERNEL
+  btScalar noBody[4] = {0, 0, 0, 0};
+  btScalar *linearVectors[2][LANES];
+  btScalar *angularVectors[2][LANES];
+  for (int lane = 0; lane < LANES; ++lane) {
+    for (int side = 0; side < 2; ++side) {
+      const int body = side == 0 ? packet.bodyA[lane] : packet.bodyB[lane];
+      linearVectors[side][lane] =
+          body < 0 ? noBody
+                   : m_tmpSolverBodyPool[body].m_deltaLinearVelocity.m_floats;
+      angularVectors[side][lane] =
+          body < 0 ? noBody
+                   : m_tmpSolverBodyPool[body].m_deltaAngularVelocity.m_floats;
+    }
+  }
+  Lanes linear[2][3];
+  Lanes angular[2][3];
+  __m128 linearW[2][QUADS];
+  __m128 angularW[2][QUADS];
+  for (int side = 0; side < 2; ++side) {
+    loadVectors(linearVectors[side], linear[side], linearW[side]);
+    loadVectors(angularVectors[side], angular[side], angularW[side]);
+  }
+
+  Lanes velocity = broadcastLanes(0);
+  for (int axis = 0; axis < 3; ++axis)
+    velocity += loadLanes(packet.normalA[axis]) * linear[0][axis] +
+                loadLanes(packet.torqueA[axis]) * angular[0][axis] +
+                loadLanes(packet.normalB[axis]) * linear[1][axis] +
+                loadLanes(packet.torqueB[axis]) * angular[1][axis];
+  const Lanes applied = loadLanes(packet.appliedImpulse);
+  Lanes impulse = applied + loadLanes(packet.rhs) -
+                  applied * loadLanes(packet.cfm) -
+                  velocity * loadLanes(packet.jacobianInverse);
+  if (!friction) {
+    impulse = maxLanes(impulse, loadLanes(packet.limit));
+  } else {
+    alignas(32) btScalar contactImpulses[LANES];
+    for (int lane = 0; lane < LANES; ++lane) {
+      const int slot = packet.contactSlots[lane];
+      contactImpulses[lane] =
+          slot < 0
+              ? 0
+              : m_contactPackets[slot / LANES].appliedImpulse[slot % LANES];
+    }
+    const Lanes contactImpulse = loadLanes(contactImpulses);
+    const Lanes bound = loadLanes(packet.limit) * contactImpulse;
+    impulse = minLanes(maxLanes(impulse, -bound), bound);
+    impulse = selectLanes(greaterLanes(contactImpulse, broadcastLanes(0)),
+                          impulse, applied);
+  }
+
+  storeLanes(packet.appliedImpulse, impulse);
+  const Lanes delta = impulse - applied;
+  for (int axis = 0; axis < 3; ++axis) {
+    linear[0][axis] += loadLanes(packet.linearA[axis]) * delta;
+    angular[0][axis] += loadLanes(packet.angularA[axis]) * delta;
+    linear[1][axis] += loadLanes(packet.linearB[axis]) * delta;
+    angular[1][axis] += loadLanes(packet.angularB[axis]) * delta;
+  }
+
+  for (int side = 0; side < 2; ++side) {
+    storeVectors(linearVectors[side], linear[side], linearW[side]);
+    storeVectors(angularVectors[side], angular[side], angularW[side]);
+  }
+#else
+  solvePacketScalar(packet, friction);
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Linear then angular velocity changes, of body A in the first six arrays
+// and of body B in the last six. Lanes without a body read zeros.
+void gatherVelocities(const btAlignedObjectArray<btSolverBody> &bodies,
+                      const int *bodyA, const int *bodyB,
+                      btScalar (*velocities)[LANES]) {
+  for (int lane = 0; lane < LANES; ++lane) {
+    for (int side = 0; side < 2; ++side) {
+      const int body = side == 0 ? bodyA[lane] : bodyB[lane];
+      btScalar(*sideVelocities)[LANES] = velocities + 6 * side;
+      for (int axis = 0; axis < 3; ++axis) {
+        sideVelocities[axis][lane] =
+            body < 0 ? 0 : bodies[body].m_deltaLinearVelocity[axis];
+        sideVelocities[3 + axis][lane] =
+            body < 0 ? 0 : bodies[body].m_deltaAngularVelocity[axis];
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// The bodies of a packet are distinct, no lane overwrites another.
+void scatterVelocities(btAlignedObjectArray<btSolverBody> &bodies,
+                       const int *bodyA, const int *bodyB,
+                       const btScalar (*velocities)[LANES]) {
+  for (int lane = 0; lane < LANES; ++lane) {
+    for (int side = 0; side < 2; ++side) {
+      const int body = side == 0 ? bodyA[lane] : bodyB[lane];
+      if (body < 0)
+        continue;
+      const btScalar(*sideVelocities)[LANES] = velocities + 6 * side;
+      for (int axis = 0; axis < 3; ++axis) {
+        bodies[body].m_deltaLinearVelocity[axis] = sideVelocities[axis][lane];
+        bodies[body].m_deltaAngularVelocity[axis] =
+            sideVelocities[3 + axis][lane];
+      }
+    }
+  }
+}
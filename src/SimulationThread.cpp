@@ -0,0 +1,169 @@
+#include "SimulationThread.h"
+
+#include "World.h"
+
+#include <algorithm>
+
+typedef std::chrono::duration<double> Seconds;
+
+const int SimulationThread::DIRTY_HISTORY;
+
+// -----------------------------------------------------------------------------
+SimulationThread::SimulationThread(World *world) : m_world(world) {}
+
+// -----------------------------------------------------------------------------
+SimulationThread::~SimulationThread() { stop(); }
+
+// -----------------------------------------------------------------------------
+void SimulationThread::start() {
+  if (m_running)
+    return;
+  m_world->setLayoutQueued(true);
+  m_running = true;
+  m_thread = std::thread(&SimulationThread::simulationLoop, this);
+}
+
+// -----------------------------------------------------------------------------
+void SimulationThread::stop() {
+  m_running = false;
+  if (!m_thread.joinable())
+    return;
+  m_thread.join();
+  m_world->setLayoutQueued(false);
+}
+
+// -----------------------------------------------------------------------------
+void SimulationThread::syncWorld() {
+  m_world->deleteRemovedObjects();
+  bool newFrame = pickUpFrame();
+  const SimulationFrame &frame = m_frames.getReadBuffer();
+  if (frame.sequence == 0 || (!newFrame && m_landed) ||
+      frame.layoutVersion != m_world->getLayoutVersion())
+    return;
+
+  // Spread the move between the two frames over the time it took to
+  // simulate it.
+  double span = Seconds(frame.time - m_previousTime).count();
+  double elapsed = Seconds(Clock::now() - frame.time).count();
+  btScalar alpha = span > 0 ? std::min(elapsed / span, 1.0) : 1;
+  m_world->interpolateObjects(frame.objects, m_previousTransforms,
+                              frame.transforms, alpha, m_allSlotsMoved);
+  m_landed = alpha >= 1;
+}
+
+// -----------------------------------------------------------------------------
+bool SimulationThread::pickUpFrame() {
+  if (!m_frames.isFresh())
+    return false;
+
+  // The frame being replaced becomes the start of the next interpolation.
+  // Land the objects still on their way to it first, the next frame only
+  // lists the objects it moved.
+  const SimulationFrame &oldFrame = m_frames.getReadBuffer();
+  if (!m_landed && oldFrame.layoutVersion == m_world->getLayoutVersion())
+    m_world->interpolateObjects(oldFrame.objects, oldFrame.transforms,
+                                oldFrame.transforms, 1, m_allSlotsMoved);
+  updatePreviousTransforms(oldFrame);
+  m_previousTime = oldFrame.time;
+  const unsigned int previousLayout = oldFrame.layoutVersion;
+
+  m_frames.update();
+  const SimulationFrame &frame = m_frames.getReadBuffer();
+  // The dirty slots are enough only when no frame has been skipped, the
+  // first frame has nothing to start from, and neither has a frame after
+  // objects were added or removed.
+  const bool newLayout =
+      previousLayout != frame.layoutVersion ||
+      m_previousTransforms.getSize() != frame.transforms.getSize();
+  m_allSlotsMoved = frame.sequence != m_syncedSequence + 1 || newLayout;
+  if (newLayout) {
+    updatePreviousTransforms(frame);
+    m_previousTime = frame.time;
+  }
+  m_syncedSequence = frame.sequence;
+  m_landed = false;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// Move the previous transforms to frame. From the frame just before, the
+// slots frame moved are enough.
+void SimulationThread::updatePreviousTransforms(const SimulationFrame &frame) {
+  if (frame.sequence == m_previousSequence)
+    return;
+  if (frame.sequence == m_previousSequence + 1 &&
+      frame.layoutVersion == m_previousLayout &&
+      frame.transforms.getSize() == m_previousTransforms.getSize())
+    m_previousTransforms.copyDirtySlots(frame.transforms);
+  else
+    m_previousTransforms = frame.transforms;
+  m_previousSequence = frame.sequence;
+  m_previousLayout = frame.layoutVersion;
+}
+
+// -----------------------------------------------------------------------------
+void SimulationThread::simulationLoop() {
+  // The world may have changed since the last run. A sequence is skipped for
+  // the renderer to sync the first frame whole, and the frames of the last
+  // run are copied whole.
+  if (m_sequence > 0)
+    ++m_sequence;
+  m_firstSequence = m_sequence + 1;
+
+  Clock::time_point lastTime = Clock::now();
+  double accumulator = 0;
+  publishFrame(lastTime);
+
+  while (m_running) {
+    const double timeStep = m_world->getTimeStep();
+    const Clock::time_point now = Clock::now();
+    accumulator += Seconds(now - lastTime).count();
+    lastTime = now;
+
+    // Past the budget the simulation time slows down, rather than taking ever
+    // more steps to catch up with the wall clock.
+    accumulator = std::min(accumulator, m_world->getMaxSubsteps() * timeStep);
+    int steps = static_cast<int>(accumulator / timeStep);
+    if (steps > 0) {
+      accumulator -= steps * timeStep;
+      m_world->stepPhysics(steps);
+      publishFrame(Clock::now());
+    }
+
+    std::this_thread::sleep_for(Seconds(timeStep - accumulator));
+  }
+}
+
+// -----------------------------------------------------------------------------
+void SimulationThread::publishFrame(Clock::time_point time) {
+  const TransformBuffer &transforms = m_world->getTransforms();
+  const unsigned int layoutVersion = m_world->getLayoutVersion();
+  ++m_sequence;
+  m_dirtyHistory[m_sequence % DIRTY_HISTORY] = transforms.getDirtySlots();
+
+  // The write buffer holds an earlier frame, only the slots moved since are
+  // copied into it when it is recent enough. The objects only change with
+  // the layout.
+  SimulationFrame &frame = m_frames.getWriteBuffer();
+  if (frame.sequence < m_firstSequence ||
+      frame.layoutVersion != layoutVersion ||
+      m_sequence - frame.sequence > DIRTY_HISTORY) {
+    frame.transforms = transforms;
+    frame.objects = m_world->getObjects();
+    frame.layoutVersion = layoutVersion;
+  } else {
+    m_changedSlots.clear();
+    for (unsigned int sequence = frame.sequence + 1; sequence < m_sequence;
+         ++sequence) {
+      const std::vector<int> &dirtySlots =
+          m_dirtyHistory[sequence % DIRTY_HISTORY];
+      m_changedSlots.insert(m_changedSlots.end(), dirtySlots.begin(),
+                            dirtySlots.end());
+    }
+    frame.transforms.copySlots(transforms, m_changedSlots);
+    frame.transforms.copyDirtySlots(transforms);
+  }
+  frame.sequence = m_sequence;
+  frame.time = time;
+  m_frames.publish();
+}
@@ -0,0 +1,153 @@
+#include "StaticBatch.h"
+
+#include "Object.h"
+#include "ShaderProgram.h"
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+
+// Support functions.
+// -----------------------------------------------------------------------------
+template <typename type>
+void uploadBuffer(GLenum target, GLuint bufferId,
+                  const std::vector<type> &data);
+
+// -----------------------------------------------------------------------------
+StaticBatch::StaticBatch(const Object *material, GLuint texture,
+                         const ShaderProgram &shader)
+    : m_material(material), m_texture(texture), m_shader(shader) {}
+
+// -----------------------------------------------------------------------------
+StaticBatch::~StaticBatch() {
+  for (auto &chunk : m_chunks) {
+    if (chunk.vaoId == 0)
+      continue;
+    glDeleteVertexArrays(1, &chunk.vaoId);
+    glDeleteBuffers(4, chunk.vboIds);
+  }
+}
+
+// -----------------------------------------------------------------------------
+bool StaticBatch::accepts(const Object *object, GLuint texture) const {
+  return texture == m_texture &&
+         object->getAmbientColor() == m_material->getAmbientColor() &&
+         object->getSpecularColor() == m_material->getSpecularColor() &&
+         object->getShininess() == m_material->getShininess();
+}
+
+// -----------------------------------------------------------------------------
+void StaticBatch::add(const Object *object) {
+  if (m_freeChunks.empty()) {
+    m_freeChunks.push_back(m_chunks.size());
+    m_chunks.emplace_back();
+  }
+  const int chunkIndex = m_freeChunks.back();
+  Chunk &chunk = m_chunks[chunkIndex];
+  chunk.objects.push_back(object);
+  chunk.dirty = true;
+  m_objectChunks[object] = chunkIndex;
+  if (static_cast<int>(chunk.objects.size()) == CHUNK_OBJECTS)
+    m_freeChunks.pop_back();
+}
+
+// -----------------------------------------------------------------------------
+void StaticBatch::remove(const Object *object) {
+  auto chunkIter = m_objectChunks.find(object);
+  if (chunkIter == m_objectChunks.end())
+    return;
+
+  Chunk &chunk = m_chunks[chunkIter->second];
+  if (static_cast<int>(chunk.objects.size()) == CHUNK_OBJECTS)
+    m_freeChunks.push_back(chunkIter->second);
+  auto objectIter =
+      std::find(chunk.objects.begin(), chunk.objects.end(), object);
+  *objectIter = chunk.objects.back();
+  chunk.objects.pop_back();
+  chunk.dirty = true;
+  m_objectChunks.erase(chunkIter);
+  if (object == m_material && !m_objectChunks.empty())
+    m_material = m_objectChunks.begin()->first;
+}
+
+// -----------------------------------------------------------------------------
+void StaticBatch::update() {
+  for (auto &chunk : m_chunks) {
+    if (chunk.dirty)
+      rebuildChunk(chunk);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void StaticBatch::draw() const {
+  for (const auto &chunk : m_chunks) {
+    if (chunk.indicesNumber == 0)
+      continue;
+    glBindVertexArray(chunk.vaoId);
+    glDrawElements(GL_TRIANGLES, chunk.indicesNumber, GL_UNSIGNED_INT,
+                   nullptr);
+  }
+  glBindVertexArray(0);
+}
+
+// -----------------------------------------------------------------------------
+void StaticBatch::rebuildChunk(Chunk &chunk) {
+  std::vector<glm::vec3> points;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> textureCoos;
+  std::vector<unsigned int> indices;
+
+  for (auto object : chunk.objects) {
+    btScalar transform[16];
+    object->getOpenGLMatrix(transform);
+    glm::mat4 model = glm::make_mat4x4(transform);
+    glm::mat3 rotation(model);
+
+    auto objectPoints = reinterpret_cast<const glm::vec3 *>(object->getPoints());
+    auto objectNormals =
+        reinterpret_cast<const glm::vec3 *>(object->getNormals());
+    auto objectTextureCoos =
+        reinterpret_cast<const glm::vec2 *>(object->getTextureCoos());
+    unsigned int firstPoint = points.size();
+    for (int point = 0; point < object->getPointsNumber(); ++point) {
+      points.push_back(glm::vec3(model * glm::vec4(objectPoints[point], 1.f)));
+      normals.push_back(rotation * objectNormals[point]);
+      textureCoos.push_back(objectTextureCoos[point]);
+    }
+
+    const unsigned int *objectIndices = object->getIndices();
+    for (int index = 0; index < object->getIndicesNumber(); ++index)
+      indices.push_back(firstPoint + objectIndices[index]);
+  }
+
+  if (chunk.vaoId == 0) {
+    glGenVertexArrays(1, &chunk.vaoId);
+    glGenBuffers(4, chunk.vboIds);
+  }
+  glBindVertexArray(chunk.vaoId);
+  uploadBuffer(GL_ARRAY_BUFFER, chunk.vboIds[0], points);
+  m_shader.setAttribute("vertexPosition", 3, GL_FLOAT);
+  uploadBuffer(GL_ARRAY_BUFFER, chunk.vboIds[1], normals);
+  m_shader.setAttribute("vertexNormal", 3, GL_FLOAT);
+  uploadBuffer(GL_ARRAY_BUFFER, chunk.vboIds[2], textureCoos);
+  m_shader.setAttribute("vertexTextureCoordinates", 2, GL_FLOAT);
+  uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.vboIds[3], indices);
+  glBindVertexArray(0);
+  checkOpenGLError("StaticBatch: rebuildChunk");
+
+  chunk.indicesNumber = indices.size();
+  chunk.dirty = false;
+}
+
+// -----------------------------------------------------------------------------
+template <typename type>
+void uploadBuffer(GLenum target, GLuint bufferId,
+                  const std::vector<type> &data) {
+  glBindBuffer(target, bufferId);
+  glBufferData(target, data.size() * sizeof(type), data.data(),
+               GL_STATIC_DRAW);
+}
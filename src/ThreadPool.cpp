@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+
+#include <cassert>
+
+// -----------------------------------------------------------------------------
+ThreadPool::ThreadPool(int threadsNumber) {
+  assert(threadsNumber > 0 && "A thread pool needs at least one worker");
+  for (int worker = 0; worker < threadsNumber; ++worker)
+    m_queues.emplace_back(new TaskQueue());
+  for (int worker = 1; worker < threadsNumber; ++worker)
+    m_threads.emplace_back(&ThreadPool::workerLoop, this, worker);
+}
+
+// -----------------------------------------------------------------------------
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_startCondition.notify_all();
+  for (auto &thread : m_threads)
+    thread.join();
+}
+
+// -----------------------------------------------------------------------------
+void ThreadPool::run(int tasksNumber, const TaskFunction &function) {
+  if (tasksNumber <= 0)
+    return;
+
+  const int workersNumber = getThreadsNumber();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_function = &function;
+    m_pendingTasks = tasksNumber;
+    for (int task = 0; task < tasksNumber; ++task) {
+      TaskQueue &queue = *m_queues[task % workersNumber];
+      std::lock_guard<std::mutex> queueLock(queue.mutex);
+      queue.tasks.push_back(task);
+    }
+    ++m_generation;
+  }
+  m_startCondition.notify_all();
+
+  int task;
+  while (popTask(0, task))
+    runTask(task, 0);
+
+  // Wait for the tasks stolen by the other workers.
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_doneCondition.wait(lock, [this] { return m_pendingTasks == 0; });
+  m_function = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+void ThreadPool::workerLoop(int worker) {
+  unsigned int generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_startCondition.wait(
+          lock, [&] { return m_stop || m_generation != generation; });
+      if (m_stop)
+        return;
+      generation = m_generation;
+    }
+
+    int task;
+    while (popTask(worker, task))
+      runTask(task, worker);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Take from the front of the own queue, steal from the back of the others.
+bool ThreadPool::popTask(int worker, int &task) {
+  const int workersNumber = getThreadsNumber();
+  for (int offset = 0; offset < workersNumber; ++offset) {
+    TaskQueue &queue = *m_queues[(worker + offset) % workersNumber];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    if (offset == 0) {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+    } else {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+    }
+    return true;
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+void ThreadPool::runTask(int task, int worker) {
+  (*m_function)(task, worker);
+  if (--m_pendingTasks == 0) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_doneCondition.notify_one();
+  }
+}
@@ -0,0 +1,133 @@
+#include "TransformBuffer.h"
+
+#include <LinearMath/btQuaternion.h>
+#include <LinearMath/btVector3.h>
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------
+TransformBuffer::TransformBuffer() {}
+
+// -----------------------------------------------------------------------------
+int TransformBuffer::addSlot(const btTransform &transform) {
+  int slot = getSize();
+  for (auto &component : m_positions)
+    component.push_back(0);
+  for (auto &component : m_orientations)
+    component.push_back(0);
+  m_dirtyFlags.push_back(false);
+  m_frozenFlags.push_back(false);
+
+  setTransform(slot, transform);
+  return slot;
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::reserve(int slotsNumber) {
+  for (auto &component : m_positions)
+    component.reserve(slotsNumber);
+  for (auto &component : m_orientations)
+    component.reserve(slotsNumber);
+  m_dirtySlots.reserve(slotsNumber);
+  m_dirtyFlags.reserve(slotsNumber);
+  m_frozenFlags.reserve(slotsNumber);
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::removeSlot(int slot) {
+  const int lastSlot = getSize() - 1;
+  for (auto &component : m_positions) {
+    component[slot] = component[lastSlot];
+    component.pop_back();
+  }
+  for (auto &component : m_orientations) {
+    component[slot] = component[lastSlot];
+    component.pop_back();
+  }
+  m_frozenFlags[slot] = m_frozenFlags[lastSlot];
+  m_frozenFlags.pop_back();
+  m_dirtyFlags.pop_back();
+  if (slot < lastSlot)
+    markDirty(slot);
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::pruneDirtySlots() {
+  const int size = getSize();
+  m_dirtySlots.erase(std::remove_if(m_dirtySlots.begin(), m_dirtySlots.end(),
+                                    [size](int slot) { return slot >= size; }),
+                     m_dirtySlots.end());
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::setTransform(int slot, const btTransform &transform) {
+  const btVector3 &origin = transform.getOrigin();
+  const btQuaternion rotation = transform.getRotation();
+  for (int component = 0; component < 3; ++component)
+    m_positions[component][slot] = origin[component];
+  for (int component = 0; component < 4; ++component)
+    m_orientations[component][slot] = rotation[component];
+
+  markDirty(slot);
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::setFrozen(int slot, bool frozen) {
+  m_frozenFlags[slot] = frozen;
+  markDirty(slot);
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::markDirty(int slot) {
+  if (!m_dirtyFlags[slot]) {
+    m_dirtyFlags[slot] = true;
+    m_dirtySlots.push_back(slot);
+  }
+}
+
+// -----------------------------------------------------------------------------
+btTransform TransformBuffer::getTransform(int slot) const {
+  return btTransform(
+      btQuaternion(m_orientations[0][slot], m_orientations[1][slot],
+                   m_orientations[2][slot], m_orientations[3][slot]),
+      btVector3(m_positions[0][slot], m_positions[1][slot],
+                m_positions[2][slot]));
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::getOpenGLMatrix(int slot, btScalar *matrix) const {
+  getTransform(slot).getOpenGLMatrix(matrix);
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::clearDirtySlots() {
+  for (auto slot : m_dirtySlots)
+    m_dirtyFlags[slot] = false;
+  m_dirtySlots.clear();
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::copySlots(const TransformBuffer &source,
+                                const std::vector<int> &slots) {
+  for (int component = 0; component < 3; ++component) {
+    const btScalar *positions = source.m_positions[component].data();
+    for (auto slot : slots)
+      m_positions[component][slot] = positions[slot];
+  }
+  for (int component = 0; component < 4; ++component) {
+    const btScalar *orientations = source.m_orientations[component].data();
+    for (auto slot : slots)
+      m_orientations[component][slot] = orientations[slot];
+  }
+  for (auto slot : slots)
+    m_frozenFlags[slot] = source.m_frozenFlags[slot];
+}
+
+// -----------------------------------------------------------------------------
+void TransformBuffer::copyDirtySlots(const TransformBuffer &source) {
+  copySlots(source, source.m_dirtySlots);
+  clearDirtySlots();
+  for (auto slot : source.m_dirtySlots)
+    m_dirtyFlags[slot] = true;
+  m_dirtySlots = source.m_dirtySlots;
+}
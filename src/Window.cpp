@@ -64,7 +64,9 @@ void Window::startRendering() {
   keyboardManager.setLightMask(scene->getLightMask());
 
   attachTimers();
+  scene->startSimulation();
   renderingLoop();
+  scene->stopSimulation();
 }
 
 // -----------------------------------------------------------------------------
@@ -124,6 +126,9 @@ Uint32 eventHandler(Uint32 interval, void *windowPtr) {
       if (kill)
         return 0;
       scene->updateLightMask(window->keyboardManager.getLightMask());
+      scene->skipPlayback(window->keyboardManager.takePlaybackSkip());
+      if (window->keyboardManager.takeResetRequest())
+        scene->resetWorld();
       break;
     }
 
@@ -149,8 +154,6 @@ Uint32 eventHandler(Uint32 interval, void *windowPtr) {
   }
 
   window->updateCurrentCameraPosition();
-  // This makes the update of the scene independent of the frame-rate.
-  scene->stepSimulation(); 
   return interval;
 }
 
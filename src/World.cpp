@@ -1,6 +1,11 @@
 #include "World.h"
 
 #include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "Box.h"
 #include "Light.h"
@@ -14,7 +19,14 @@
 
 #include <LinearMath/btVector3.h>
 
-const float World::STEPS_PER_SECOND = 70.0f;
+const float World::DEFAULT_STEPS_PER_SECOND = 70.0f;
+const float World::DEFAULT_SETTLE_TIME = 1.0f;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+btTransform interpolateTransform(const TransformBuffer &previous,
+                                 const TransformBuffer &current, int slot,
+                                 btScalar alpha);
 
 // -----------------------------------------------------------------------------
 World::World() { 
@@ -23,30 +35,189 @@ World::World() {
 
 // -----------------------------------------------------------------------------
 World::~World() {
-  // Here I delete objects but not their rigid body.
+  // The objects delete their rigid body, which must be out of the engine
+  // first.
+  m_regions.reset();
+  m_engine.removeAllRigidBodies();
   for (auto object : m_objects)
     delete object;
+  for (const auto &change : m_layoutChanges) {
+    if (!change.removal)
+      for (auto object : change.objects)
+        delete object;
+  }
+  deleteRemovedObjects();
 
   for (auto light : m_lights)
     delete light;
-
-  // Rigid bodies are deleted by engine.
-  // In case there are troubles, convert the engine to a pointer and move its
-  // desctruction before the destruction of the objects.
 }
 
 // -----------------------------------------------------------------------------
 void World::addObject(Object *object) {
-  m_objects.push_back(object);
-  m_engine.addRigidBody(object->getRigidBody());
+  addObjects(std::vector<Object *>(1, object));
 }
 
 // -----------------------------------------------------------------------------
+void World::addObjects(const std::vector<Object *> &objects) {
+  if (objects.empty())
+    return;
+  if (m_layoutQueued) {
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    m_layoutChanges.push_back({objects, false});
+    return;
+  }
+  insertObjects(objects);
+}
+
+// -----------------------------------------------------------------------------
+// The lights are only seen by the thread changing the objects.
 void World::addLightBulb(LightBulb *lightBulb) {
-  m_objects.push_back(lightBulb);
-  m_engine.addRigidBody(lightBulb->getRigidBody());
   m_bulbs.push_back(lightBulb);
   m_lights.push_back(lightBulb->getLight());
+  addObject(lightBulb);
+}
+
+// -----------------------------------------------------------------------------
+void World::removeObject(Object *object) {
+  removeObjects(std::vector<Object *>(1, object));
+}
+
+// -----------------------------------------------------------------------------
+void World::removeObjects(const std::vector<Object *> &objects) {
+  if (objects.empty())
+    return;
+  if (!m_frozenChanges.empty()) {
+    std::unordered_set<const Object *> removedObjects(objects.begin(),
+                                                      objects.end());
+    m_frozenChanges.erase(
+        std::remove_if(m_frozenChanges.begin(), m_frozenChanges.end(),
+                       [&](const Object *object) {
+                         return removedObjects.count(object) != 0;
+                       }),
+        m_frozenChanges.end());
+  }
+  for (auto object : objects) {
+    assert(object != m_mirror && "The mirror cannot be removed");
+    // The world owns the light of a bulb.
+    auto bulb = std::find(m_bulbs.begin(), m_bulbs.end(), object);
+    if (bulb != m_bulbs.end()) {
+      Light *light = (*bulb)->getLight();
+      m_lights.erase(std::find(m_lights.begin(), m_lights.end(), light));
+      m_bulbs.erase(bulb);
+      delete light;
+    }
+  }
+
+  if (m_layoutQueued) {
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    m_layoutChanges.push_back({objects, true});
+    return;
+  }
+  eraseObjects(objects);
+  for (auto object : objects)
+    delete object;
+}
+
+// -----------------------------------------------------------------------------
+void World::setLayoutQueued(bool queued) {
+  m_layoutQueued = queued;
+  if (!queued) {
+    applyLayoutChanges();
+    deleteRemovedObjects();
+  }
+}
+
+// -----------------------------------------------------------------------------
+void World::deleteRemovedObjects() {
+  std::lock_guard<std::mutex> lock(m_layoutMutex);
+  for (auto object : m_removedObjects)
+    delete object;
+  m_removedObjects.clear();
+}
+
+// -----------------------------------------------------------------------------
+// The objects removed may still be synced by the thread that removed them,
+// until it calls deleteRemovedObjects.
+void World::applyLayoutChanges() {
+  {
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    m_appliedChanges.swap(m_layoutChanges);
+  }
+  for (const auto &change : m_appliedChanges) {
+    if (!change.removal) {
+      insertObjects(change.objects);
+      continue;
+    }
+    eraseObjects(change.objects);
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    m_removedObjects.insert(m_removedObjects.end(), change.objects.begin(),
+                            change.objects.end());
+  }
+  m_appliedChanges.clear();
+}
+
+// -----------------------------------------------------------------------------
+// The world makes room for all the objects first, the engine takes their
+// bodies in bulk.
+void World::insertObjects(const std::vector<Object *> &objects) {
+  assert(!isLayoutFixed() && "A recording keeps the same objects throughout");
+  ++m_layoutVersion;
+  const std::size_t objectsNumber = m_objects.size() + objects.size();
+  m_objects.reserve(objectsNumber);
+  m_transforms.reserve(objectsNumber);
+  m_sleepingSince.reserve(objectsNumber);
+  m_dynamicIndices.reserve(objectsNumber);
+  m_dynamicSlots.reserve(objectsNumber);
+
+  for (auto object : objects) {
+    m_objects.push_back(object);
+    bindTransformSlot(object);
+  }
+  if (objects.size() == 1)
+    addRigidBody(objects.front());
+  else
+    addRigidBodies(objects.data(), objects.size());
+}
+
+// -----------------------------------------------------------------------------
+// The contact events follow the bodies from the slot they had before the
+// removals to the one they end up in, through every swap.
+void World::eraseObjects(const std::vector<Object *> &objects) {
+  assert(!isLayoutFixed() && "A recording keeps the same objects throughout");
+  ++m_layoutVersion;
+
+  std::vector<btRigidBody *> rigidBodies;
+  rigidBodies.reserve(objects.size());
+  for (auto object : objects)
+    rigidBodies.push_back(object->getRigidBody());
+  removeRigidBodies(rigidBodies);
+
+  // Slot before the removals of the objects moved so far, and slot after
+  // them of the objects moved or removed.
+  std::unordered_map<int, int> originSlots;
+  std::unordered_map<int, int> movedSlots;
+  for (auto object : objects) {
+    const int slot = object->getTransformSlot();
+    const int lastSlot = m_objects.size() - 1;
+    assert(slot >= 0 && m_objects[slot] == object &&
+           "The object is not in the world");
+    if (m_contactEvents) {
+      auto origin = originSlots.find(slot);
+      movedSlots[origin != originSlots.end() ? origin->second : slot] = -1;
+      if (slot < lastSlot) {
+        auto lastOrigin = originSlots.find(lastSlot);
+        const int lastOriginSlot =
+            lastOrigin != originSlots.end() ? lastOrigin->second : lastSlot;
+        originSlots[slot] = lastOriginSlot;
+        movedSlots[lastOriginSlot] = slot;
+      }
+      originSlots.erase(lastSlot);
+    }
+    removeSlot(slot);
+  }
+  m_transforms.pruneDirtySlots();
+  if (m_contactEvents)
+    m_contactEvents->remapSlots(movedSlots, m_stepsNumber);
 }
 
 // -----------------------------------------------------------------------------
@@ -56,82 +227,584 @@ void World::addDirectionalLight(DirectionalLight *light) {
 
 // -----------------------------------------------------------------------------
 void World::stepSimulation() {
-  int steps = m_engine.getDynamicsWorld()->stepSimulation(
-      1 / World::STEPS_PER_SECOND, World::MAX_STEPS);
+  stepPhysics(1);
+  syncObjects(m_transforms);
+}
+
+// -----------------------------------------------------------------------------
+void World::stepPhysics(int steps) {
+  applyLayoutChanges();
+  if (m_player) {
+    playSteps(steps);
+    return;
+  }
+
+  if (m_recorder && m_recorder->getFramesNumber() == 0)
+    recordFrame();
+  m_transforms.clearDirtySlots();
+  if (m_restoreRequested.exchange(false))
+    restore();
+  btScalar timeStep = getTimeStep();
+  for (int step = 0; step < steps; ++step) {
+    if (m_regions)
+      m_regions->stepSimulation(timeStep);
+    else
+      m_engine.stepSimulation(timeStep);
+    // Every step, a short hit may begin and end within one batch.
+    if (m_contactEvents)
+      m_contactEvents->update(getDispatchers(), m_stepsNumber + step + 1);
+    if (m_profiler)
+      profileStep(m_stepsNumber + step + 1);
+    // The dirty slots gather the whole batch, the recorder skips the bodies
+    // that did not move since its last frame.
+    if (m_recorder && step + 1 < steps)
+      recordFrame();
+  }
+  m_stepsNumber += steps;
+  settleBodies();
+  if (m_recorder)
+    recordFrame();
+}
+
+// -----------------------------------------------------------------------------
+void World::profileStep(unsigned int step) {
+  if (m_regions)
+    m_profiler->recordStep(step, m_regions->getActiveRigidBodiesNumber(),
+                           m_regions->getManifoldsNumber(),
+                           m_regions->getAwakeIslandsNumber());
+  else
+    m_profiler->recordStep(step, m_engine.getActiveRigidBodiesNumber(),
+                           m_engine.getManifoldsNumber(),
+                           m_engine.getAwakeIslandsNumber());
+}
+
+// -----------------------------------------------------------------------------
+// The frames recorded so far stay playable.
+void World::recordFrame() {
+  if (m_recorder->recordFrame(m_transforms))
+    return;
+  std::cerr << "Objects added or removed while recording, the recording stops "
+               "after "
+            << m_recorder->getFramesNumber() << " frames\n";
+  m_recorder.reset();
+}
+
+// -----------------------------------------------------------------------------
+void World::playSteps(int steps) {
+  m_transforms.clearDirtySlots();
+  int skip = m_playbackSkip.exchange(0);
+  if (m_restoreRequested.exchange(false))
+    skip = -m_player->getFrame();
+  if (m_player->getFrame() == 0) {
+    if (m_player->getSlotsNumber() != m_transforms.getSize()) {
+      std::cerr << "The recording does not match the world: "
+                << m_player->getSlotsNumber() << " objects instead of "
+                << m_transforms.getSize() << "\n";
+      exit(1);
+    }
+    m_player->seek(skip, m_transforms);
+  } else if (skip != 0) {
+    // The last frame read is the one on screen.
+    m_player->seek(m_player->getFrame() - 1 + skip, m_transforms);
+  }
+
+  for (int step = 0; step < steps && !m_player->isOver(); ++step)
+    m_player->readFrame(m_transforms);
+  m_stepsNumber += steps;
+}
 
-  if (steps == 0)
+// -----------------------------------------------------------------------------
+// Freeze the bodies that slept for the settle time. Only the bodies not
+// frozen yet are visited, so the settled part of the world costs nothing.
+void World::settleBodies() {
+  thawTouchedBodies();
+  if (m_settleTime > 0) {
+    const unsigned int settleSteps =
+        static_cast<unsigned int>(m_settleTime * m_stepsPerSecond);
+    m_pendingSlots.clear();
+    for (auto slot : m_dynamicSlots) {
+      const btRigidBody *body = m_objects[slot]->getRigidBody();
+      if (body->getActivationState() != ISLAND_SLEEPING)
+        m_sleepingSince[slot] = m_stepsNumber;
+      else if (m_stepsNumber - m_sleepingSince[slot] >= settleSteps)
+        m_pendingSlots.push_back(slot);
+    }
+
+    for (auto slot : m_pendingSlots)
+      freezeObject(slot);
+  }
+  updateCollisionFilters();
+}
+
+// -----------------------------------------------------------------------------
+// A frozen body is static, Bullet would let it stop anything hitting it. Wake
+// it up on the first contact with an awake body instead.
+void World::thawTouchedBodies() {
+  if (m_frozenNumber == 0)
     return;
 
-  std::for_each(begin(m_objects), end(m_objects), [](Object *object) {
-    btTransform transform;
-    object->getRigidBody()->getMotionState()->getWorldTransform(transform);
-    object->setTransform(transform);
-  });
-
-  // Traverse over the light bulbs.
-  std::for_each(begin(m_bulbs), end(m_bulbs), [](LightBulb *bulb) {
-    btTransform transform;
-    bulb->getRigidBody()->getMotionState()->getWorldTransform(transform);
-    btVector3 position = transform.getOrigin();
+  m_pendingSlots.clear();
+  for (auto dispatcher : getDispatchers()) {
+    for (int index = 0; index < dispatcher->getNumManifolds(); ++index) {
+      const btPersistentManifold *manifold =
+          dispatcher->getManifoldByIndexInternal(index);
+      if (manifold->getNumContacts() == 0)
+        continue;
+
+      const btCollisionObject *bodies[] = {manifold->getBody0(),
+                                           manifold->getBody1()};
+      for (int side = 0; side < 2; ++side) {
+        const btCollisionObject *other = bodies[1 - side];
+        if (other->isStaticObject() || !other->isActive())
+          continue;
+        int slot = EngineMotionState::getBodySlot(
+            RegionGrid::getOwner(bodies[side]));
+        if (slot >= 0 && m_transforms.isFrozen(slot))
+          m_pendingSlots.push_back(slot);
+      }
+    }
+  }
+
+  // Thawing removes the manifolds of the body, hence the second pass.
+  for (auto slot : m_pendingSlots) {
+    if (m_transforms.isFrozen(slot))
+      thawObject(slot);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void World::freezeObject(int slot) {
+  m_engine.freezeRigidBody(m_objects[slot]->getRigidBody());
+  m_transforms.setFrozen(slot, true);
+  m_filterSlots.push_back(slot);
+  ++m_frozenNumber;
+  removeDynamicSlot(slot);
+  if (m_contactEvents)
+    m_contactEvents->revisitSlot(slot);
+}
+
+// -----------------------------------------------------------------------------
+// Swap and pop from the dynamic slots.
+void World::removeDynamicSlot(int slot) {
+  int index = m_dynamicIndices[slot];
+  int lastSlot = m_dynamicSlots.back();
+  m_dynamicSlots[index] = lastSlot;
+  m_dynamicIndices[lastSlot] = index;
+  m_dynamicSlots.pop_back();
+  m_dynamicIndices[slot] = -1;
+}
+
+// -----------------------------------------------------------------------------
+void World::thawObject(int slot) {
+  Object *object = m_objects[slot];
+  m_engine.thawRigidBody(object->getRigidBody(), object->getMass(),
+                         object->getInertia());
+  m_transforms.setFrozen(slot, false);
+  m_filterSlots.push_back(slot);
+  --m_frozenNumber;
+  if (m_contactEvents)
+    m_contactEvents->revisitSlot(slot);
+
+  m_dynamicIndices[slot] = m_dynamicSlots.size();
+  m_dynamicSlots.push_back(slot);
+  m_sleepingSince[slot] = m_stepsNumber;
+}
+
+// -----------------------------------------------------------------------------
+// Frozen bodies take the filter of static ones, so that the broadphase drops
+// their pairs with each other and with the ground. A thawed body gets them
+// back.
+void World::updateCollisionFilters() {
+  if (m_filterSlots.empty())
+    return;
+  std::vector<btRigidBody *> rigidBodies;
+  std::vector<CollisionFilter> filters;
+  rigidBodies.reserve(m_filterSlots.size());
+  filters.reserve(m_filterSlots.size());
+  for (auto slot : m_filterSlots) {
+    rigidBodies.push_back(m_objects[slot]->getRigidBody());
+    filters.push_back(getCollisionFilter(m_objects[slot]));
+  }
+  m_filterSlots.clear();
+
+  if (m_regions)
+    m_regions->setCollisionFilters(rigidBodies.data(), filters.data(),
+                                   rigidBodies.size());
+  else
+    m_engine.setCollisionFilters(rigidBodies.data(), filters.data(),
+                                 rigidBodies.size());
+}
+
+// -----------------------------------------------------------------------------
+void World::snapshot() {
+  // Every state is written below.
+  m_snapshot.resizeNoInitialize(m_objects.size());
+  for (size_t slot = 0; slot < m_objects.size(); ++slot)
+    saveBodyState(slot, m_snapshot[slot]);
+  m_snapshotSleepingSince = m_sleepingSince;
+  m_snapshotStepsNumber = m_stepsNumber;
+}
+
+// -----------------------------------------------------------------------------
+void World::saveBodyState(int slot, BodyState &state) const {
+  const btRigidBody *body = m_objects[slot]->getRigidBody();
+  state.transform = body->getWorldTransform();
+  state.linearVelocity = body->getLinearVelocity();
+  state.angularVelocity = body->getAngularVelocity();
+  state.deactivationTime = body->getDeactivationTime();
+  state.activationState = body->getActivationState();
+  state.frozen = m_transforms.isFrozen(slot);
+}
+
+// -----------------------------------------------------------------------------
+// Every slot ends up dirty, so that the next sync moves all the objects.
+void World::restore() {
+  if (!hasSnapshot())
+    return;
+  assert(static_cast<size_t>(m_snapshot.size()) == m_objects.size() &&
+         "The snapshot does not follow the objects");
+
+  btDiscreteDynamicsWorld *dynamicsWorld = m_engine.getDynamicsWorld();
+  for (size_t slot = 0; slot < m_objects.size(); ++slot) {
+    const BodyState &state = m_snapshot[slot];
+    if (m_transforms.isFrozen(slot) && !state.frozen)
+      thawObject(slot);
+    else if (!m_transforms.isFrozen(slot) && state.frozen)
+      freezeObject(slot);
+
+    btRigidBody *body = m_objects[slot]->getRigidBody();
+    body->setWorldTransform(state.transform);
+    body->setInterpolationWorldTransform(state.transform);
+    body->getMotionState()->setWorldTransform(state.transform);
+    body->setLinearVelocity(state.linearVelocity);
+    body->setAngularVelocity(state.angularVelocity);
+    body->setInterpolationLinearVelocity(state.linearVelocity);
+    body->setInterpolationAngularVelocity(state.angularVelocity);
+    body->clearForces();
+    body->forceActivationState(state.activationState);
+    body->setDeactivationTime(state.deactivationTime);
+    if (!m_regions)
+      dynamicsWorld->updateSingleAabb(body);
+  }
+
+  // The cached impulses belong to the contacts before the restore, and so do
+  // the touching pairs of the contact events.
+  if (m_regions)
+    m_regions->resetBodies();
+  else
+    m_engine.resetContacts();
+  updateCollisionFilters();
+  if (m_contactEvents)
+    m_contactEvents->reset();
+  m_sleepingSince = m_snapshotSleepingSince;
+  m_stepsNumber = m_snapshotStepsNumber;
+}
+
+// -----------------------------------------------------------------------------
+void World::syncObjects(const TransformBuffer &transforms, bool allSlots) {
+  interpolateObjects(m_objects, transforms, transforms, 1, allSlots);
+}
+
+// -----------------------------------------------------------------------------
+// The slot of a bulb belongs to the thread stepping the physics, all the
+// lights follow their bulb.
+void World::interpolateObjects(const std::vector<Object *> &objects,
+                               const TransformBuffer &previous,
+                               const TransformBuffer &current, btScalar alpha,
+                               bool allSlots) {
+  if (allSlots) {
+    for (size_t slot = 0; slot < objects.size(); ++slot)
+      syncObject(objects[slot], previous, current, slot, alpha);
+  } else {
+    // Only the bodies Bullet moved have been written to the buffer.
+    for (auto slot : current.getDirtySlots())
+      syncObject(objects[slot], previous, current, slot, alpha);
+  }
+
+  for (auto bulb : m_bulbs) {
+    const btVector3 &position = bulb->getPosition();
     bulb->getLight()->setPosition({position.x(), position.y(), position.z()});
-  });
+  }
 }
 
 // -----------------------------------------------------------------------------
-const btVector3 &World::getGravity() const { return m_engine.getGravity(); }
-void World::setGravity(const btVector3 &gravity) { m_engine.setGravity(gravity); }
+void World::syncObject(Object *object, const TransformBuffer &previous,
+                       const TransformBuffer &current, int slot,
+                       btScalar alpha) {
+  object->setTransform(interpolateTransform(previous, current, slot, alpha));
+  if (object->isFrozen() != current.isFrozen(slot)) {
+    object->setFrozen(current.isFrozen(slot));
+    m_frozenChanges.push_back(object);
+  }
+}
 
 // -----------------------------------------------------------------------------
-const glm::vec4 &World::getAmbientColor() const { return m_ambientColor; }
-void World::setAmbientColor(const glm::vec4 &color) { m_ambientColor = color; }
+void World::takeFrozenChanges(std::vector<const Object *> &objects) {
+  objects.swap(m_frozenChanges);
+  m_frozenChanges.clear();
+}
 
 // -----------------------------------------------------------------------------
-void traceDominoLine(const btVector3 &origin, const btVector3 &destination,
-                     World *world, int full, bool tilt = false) {
-  // Assume the y component of the positions is not relevant.
-  // Check for vertical lines.
-  btScalar zDiff = destination.z() - origin.z();
-  btScalar xDiff = destination.x() - origin.x();
-  btScalar slope = zDiff / xDiff;
-  if (slope < 0)
-    slope = -slope;
-  btScalar angle = atan2(zDiff, xDiff);
-  const int DOMINO_NUMBER = 7;
-
-  btScalar length = destination.distance(origin);
-  btScalar dominoDistance = length / (DOMINO_NUMBER - 1);
-
-  BoxBuilder boxBuilder;
-  if (xDiff == 0)
-    slope = 1;
-  btVector3 direction =
-      btVector3(signum(xDiff), 0.0, signum(zDiff) * slope).normalize();
-  int dominoNumber = DOMINO_NUMBER;
-  int index = 1;
-  if (full == 2)
-    dominoNumber = dominoNumber / 2 + 1;
-  if (full == 3) {
-    dominoNumber = dominoNumber / 2;
+void World::startRecording(const std::string &fileName) {
+  assert(!m_player && "Cannot record a playback");
+  m_recorder.reset(new Recorder(fileName, m_stepsPerSecond));
+}
+
+// -----------------------------------------------------------------------------
+void World::stopRecording() { m_recorder.reset(); }
+
+// -----------------------------------------------------------------------------
+void World::startPlayback(const std::string &fileName) {
+  assert(!m_recorder && "Cannot play back while recording");
+  m_player.reset(new Player(fileName));
+  setStepsPerSecond(m_player->getStepsPerSecond());
+}
+
+// -----------------------------------------------------------------------------
+void World::setStepsPerSecond(float stepsPerSecond) {
+  assert(stepsPerSecond > 0 && "The physics rate must be positive");
+  m_stepsPerSecond = stepsPerSecond;
+}
+
+// -----------------------------------------------------------------------------
+void World::setMaxSubsteps(int maxSubsteps) {
+  assert(maxSubsteps > 0 && "At least one substep per frame is needed");
+  m_maxSubsteps = maxSubsteps;
+}
+
+// -----------------------------------------------------------------------------
+void World::setSettleTime(float settleTime) {
+  assert(settleTime >= 0 && "The settle time cannot be negative");
+  m_settleTime = settleTime;
+}
+
+// -----------------------------------------------------------------------------
+void World::setContactEvents(bool enabled) {
+  if (!enabled)
+    m_contactEvents.reset();
+  else if (!m_contactEvents)
+    m_contactEvents.reset(new ContactEventStream());
+}
+
+// -----------------------------------------------------------------------------
+void World::setProfiling(bool enabled, const std::string &csvFile) {
+  if (enabled)
+    m_profiler.reset(new PhysicsProfiler(csvFile));
+  else
+    m_profiler.reset();
+}
+
+// -----------------------------------------------------------------------------
+void World::bindTransformSlot(Object *object) {
+  int slot = m_transforms.addSlot(object->getTransform());
+  assert(slot == static_cast<int>(m_objects.size()) - 1 &&
+         "Transform slots must follow the objects");
+  object->getMotionState()->bind(&m_transforms, slot);
+
+  m_sleepingSince.push_back(m_stepsNumber);
+  if (object->getRigidBody()->isStaticOrKinematicObject()) {
+    m_dynamicIndices.push_back(-1);
+  } else {
+    m_dynamicIndices.push_back(m_dynamicSlots.size());
+    m_dynamicSlots.push_back(slot);
+  }
+
+  // An object added after the snapshot is restored where it was added.
+  if (hasSnapshot()) {
+    m_snapshot.expandNonInitializing();
+    saveBodyState(slot, m_snapshot[slot]);
+    m_snapshotSleepingSince.push_back(m_snapshotStepsNumber);
   }
+}
+
+// -----------------------------------------------------------------------------
+// The last slot takes the place of slot, along with everything kept by slot.
+void World::removeSlot(int slot) {
+  if (m_dynamicIndices[slot] >= 0)
+    removeDynamicSlot(slot);
+  if (m_transforms.isFrozen(slot))
+    --m_frozenNumber;
 
-  for (; index < dominoNumber; ++index) {
-    btScalar zAngle = 0;
-    if(tilt && index == 1)
-       zAngle = -M_PI_2 / 5.0;
-    btQuaternion yRotation(-angle, 0.0, zAngle);
-
-    btVector3 currentPosition = origin + dominoDistance * index * direction;
-    currentPosition += btVector3(0.0, 1.0, 0.0);
-    world->addObject(
-        boxBuilder.setTransform(btTransform(yRotation, currentPosition))
-            .setMass(btScalar(20.0))
-            .setAmbientColor(glm::vec4(0.1745, 0.01175, 0.01175, 1.0))
-            .setDiffuseColor(glm::vec4(0.61424, 0.04136, 0.04136, 1.0))
-            .setSpecularColor(glm::vec4(0.727811, 0.626959, 0.626959, 0.6))
-            .setShininess(51.2f)
-            .setSides(btVector3(0.25, 2.0, 0.5))
-            .create());
+  const int lastSlot = m_objects.size() - 1;
+  if (slot < lastSlot) {
+    m_objects[slot] = m_objects[lastSlot];
+    m_objects[slot]->getMotionState()->bind(&m_transforms, slot);
+    m_sleepingSince[slot] = m_sleepingSince[lastSlot];
+    m_dynamicIndices[slot] = m_dynamicIndices[lastSlot];
+    if (m_dynamicIndices[slot] >= 0)
+      m_dynamicSlots[m_dynamicIndices[slot]] = slot;
+    if (hasSnapshot()) {
+      m_snapshot[slot] = m_snapshot[lastSlot];
+      m_snapshotSleepingSince[slot] = m_snapshotSleepingSince[lastSlot];
+    }
+  }
+  m_objects.pop_back();
+  m_sleepingSince.pop_back();
+  m_dynamicIndices.pop_back();
+  if (hasSnapshot()) {
+    m_snapshot.pop_back();
+    m_snapshotSleepingSince.pop_back();
   }
+  m_transforms.removeSlot(slot);
+}
+
+// -----------------------------------------------------------------------------
+// The recorder and the player hold every slot from their first frame on.
+bool World::isLayoutFixed() const {
+  return (m_recorder && m_recorder->getFramesNumber() > 0) ||
+         (m_player && m_player->getFrame() > 0);
+}
+
+// -----------------------------------------------------------------------------
+int World::getActiveObjectsNumber() const {
+  if (m_regions)
+    return m_regions->getActiveRigidBodiesNumber();
+  return m_engine.getActiveRigidBodiesNumber();
+}
+
+// -----------------------------------------------------------------------------
+void World::setRegions(int columns, int rows, btScalar overlap) {
+  assert(columns > 0 && rows > 0 && "A grid needs at least one region");
+  assert(overlap >= 0 && "The region overlap cannot be negative");
+  m_regionColumns = columns;
+  m_regionRows = rows;
+  m_regionOverlap = overlap;
+  buildRegions();
+}
+
+// -----------------------------------------------------------------------------
+void World::setCollisionLayer(const std::string &name,
+                              const std::vector<std::string> &collidingLayers) {
+  m_collisionLayers.setLayer(name, collidingLayers);
+}
+
+// -----------------------------------------------------------------------------
+// Objects without mass are the static ones, and frozen objects pair as
+// static ones.
+CollisionFilter World::getCollisionFilter(const Object *object) const {
+  const bool dynamic = object->getMass() > 0 &&
+                       !m_transforms.isFrozen(object->getTransformSlot());
+  return m_collisionLayers.getFilter(object->getCollisionLayer(), dynamic);
+}
+
+// -----------------------------------------------------------------------------
+void World::addRigidBody(const Object *object) {
+  const CollisionFilter filter = getCollisionFilter(object);
+  const bool dynamic = object->getMass() > 0;
+  if (m_regions)
+    m_regions->addRigidBody(object->getRigidBody(), filter, dynamic);
+  else
+    m_engine.addRigidBody(object->getRigidBody(), filter, dynamic);
+}
+
+// -----------------------------------------------------------------------------
+void World::addRigidBodies(const Object *const *objects, int objectsNumber) {
+  if (objectsNumber == 0)
+    return;
+  std::vector<btRigidBody *> rigidBodies;
+  std::vector<CollisionFilter> filters;
+  std::unique_ptr<bool[]> dynamic(new bool[objectsNumber]);
+  rigidBodies.reserve(objectsNumber);
+  filters.reserve(objectsNumber);
+  for (int index = 0; index < objectsNumber; ++index) {
+    rigidBodies.push_back(objects[index]->getRigidBody());
+    filters.push_back(getCollisionFilter(objects[index]));
+    dynamic[index] = objects[index]->getMass() > 0;
+  }
+  if (m_regions)
+    m_regions->addRigidBodies(rigidBodies.data(), filters.data(),
+                              dynamic.get(), objectsNumber);
+  else
+    m_engine.addRigidBodies(rigidBodies.data(), filters.data(), dynamic.get(),
+                            objectsNumber);
+}
+
+// -----------------------------------------------------------------------------
+void World::removeRigidBodies(const std::vector<btRigidBody *> &rigidBodies) {
+  if (m_regions)
+    m_regions->removeRigidBodies(rigidBodies.data(), rigidBodies.size());
+  else
+    m_engine.removeRigidBodies(rigidBodies.data(), rigidBodies.size());
+}
+
+// -----------------------------------------------------------------------------
+// Move all the bodies to a new grid, or back to the engine for a single
+// region.
+void World::buildRegions() {
+  if (m_regions)
+    m_regions.reset();
+  else
+    m_engine.removeAllRigidBodies();
+
+  if (m_regionColumns * m_regionRows > 1)
+    m_regions.reset(new RegionGrid(m_engine, m_regionColumns, m_regionRows,
+                                   m_regionOverlap,
+                                   m_engine.getThreadsNumber()));
+  addRigidBodies(m_objects.data(), m_objects.size());
+}
+
+// -----------------------------------------------------------------------------
+const std::vector<btDispatcher *> &World::getDispatchers() {
+  m_dispatchers.clear();
+  if (m_regions)
+    m_regions->getDispatchers(m_dispatchers);
+  else
+    m_dispatchers.push_back(m_engine.getDynamicsWorld()->getDispatcher());
+  return m_dispatchers;
+}
+
+// -----------------------------------------------------------------------------
+const btVector3 &World::getGravity() const { return m_engine.getGravity(); }
+void World::setGravity(const btVector3 &gravity) {
+  m_engine.setGravity(gravity);
+  if (m_regions)
+    m_regions->configure(m_engine);
+}
+
+// -----------------------------------------------------------------------------
+void World::setPhysicsThreadsNumber(int threadsNumber) {
+  m_engine.setThreadsNumber(threadsNumber);
+  if (m_regions && m_regions->getThreadsNumber() != getPhysicsThreadsNumber())
+    buildRegions();
+}
+void World::setPhysicsSolver(SolverType solverType) {
+  m_engine.setSolverType(solverType);
+  if (m_regions)
+    m_regions->configure(m_engine);
+}
+void World::setSolverIterations(int minIterations, int maxIterations,
+                                double stepBudget) {
+  m_engine.setSolverIterations(minIterations, maxIterations, stepBudget);
+  if (m_regions)
+    m_regions->configure(m_engine);
+}
+void World::setPhysicsBroadphase(BroadphaseType broadphaseType) {
+  m_engine.setBroadphaseType(broadphaseType);
+  if (m_regions)
+    m_regions->configure(m_engine);
+}
+void World::setWorldBounds(const btVector3 &worldMin,
+                           const btVector3 &worldMax) {
+  m_engine.setWorldBounds(worldMin, worldMax);
+  if (m_regions)
+    buildRegions();
+}
+
+// -----------------------------------------------------------------------------
+const glm::vec4 &World::getAmbientColor() const { return m_ambientColor; }
+void World::setAmbientColor(const glm::vec4 &color) { m_ambientColor = color; }
+
+// -----------------------------------------------------------------------------
+btTransform interpolateTransform(const TransformBuffer &previous,
+                                 const TransformBuffer &current, int slot,
+                                 btScalar alpha) {
+  btTransform transform = current.getTransform(slot);
+  if (alpha >= 1)
+    return transform;
+  btTransform previousTransform = previous.getTransform(slot);
+  return btTransform(
+      previousTransform.getRotation().slerp(transform.getRotation(), alpha),
+      previousTransform.getOrigin().lerp(transform.getOrigin(), alpha));
 }
 
 //-----------------------------------------------------------------------------